@@ -0,0 +1,51 @@
+#ifndef CAPTUREFORMAT_H
+#define CAPTUREFORMAT_H
+
+#include <QtGlobal>
+
+//*****************************************************************************
+//*****************************************************************************
+//
+//  Raw sample capture file
+//
+//    t_CaptureHeader   once, at offset 0
+//    t_CaptureRecord   one per conversion, oldest first, to the end of file
+//
+//  All fields are little endian (native on the Pi). The number of records
+//  comes from the file size, so a capture cut short by a crash or power
+//  loss still replays up to its last whole record. Records are fixed size
+//  so a mapped file can be indexed directly.
+//
+//*****************************************************************************
+
+const quint32 CAPTURE_MAGIC   = 0x50434650;     // "FPCP"
+const quint32 CAPTURE_VERSION = 1;
+
+const int CAPTURE_CHIP_LEN = 16;
+
+//*** file header ***
+typedef struct
+{
+    quint32 magic;          // CAPTURE_MAGIC
+    quint32 version;        // CAPTURE_VERSION
+    quint32 headerSize;     // sizeof( t_CaptureHeader ) - records start here
+    quint32 recordSize;     // sizeof( t_CaptureRecord )
+    quint32 sampleRate;     // conversions per second of the chip (all channels)
+    quint32 outputRate;     // decimated samples per second
+    quint32 weightSamples;  // decimated samples averaged into each weight
+    quint32 numChannels;    // channels interleaved in the capture
+    qint64  startNsec;      // monotonic clock when the capture started
+    qint64  startMsecs;     // wall clock (msecs since epoch) when the capture started
+    char    chip[ CAPTURE_CHIP_LEN ];  // driver name, nul padded
+} t_CaptureHeader;
+
+//*** one conversion, as fed to the sample pipeline ***
+typedef struct
+{
+    qint64  timestamp;      // monotonic time of the conversion (nsec)
+    qint32  value;          // sign extended 24 bit value
+    quint16 channel;        // 0 or 1
+    quint16 flags;          // reserved, 0
+} t_CaptureRecord;
+
+#endif // CAPTUREFORMAT_H
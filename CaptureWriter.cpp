@@ -0,0 +1,171 @@
+#include "CaptureWriter.h"
+#include "ScaleDriver.h"
+#include <QDateTime>
+#include <QDebug>
+#include <string.h>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** how often the ring is written out ***
+const int FLUSH_MSEC = 200;
+
+//*** records per write ***
+const int WRITE_BATCH = 512;
+
+
+//*****************************************************************************
+//*****************************************************************************
+CaptureWriter::CaptureWriter( QObject *parent )
+    : QThread( parent )
+{
+    next_    = 0;
+    written_ = 0;
+    dropped_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool CaptureWriter::open( const QString &path, const ScaleDriver *scale, qint64 startNsec )
+{
+t_CaptureHeader header;
+
+    file_.setFileName( path );
+    if ( !file_.open( QIODevice::WriteOnly ) )
+    {
+        qDebug() << "Can't create capture" << path << ":" << file_.errorString();
+        return false;
+    }
+
+    //*** everything needed to run the same processing on replay ***
+    memset( &header, 0, sizeof(header) );
+    header.magic         = CAPTURE_MAGIC;
+    header.version       = CAPTURE_VERSION;
+    header.headerSize    = sizeof( t_CaptureHeader );
+    header.recordSize    = sizeof( t_CaptureRecord );
+    header.sampleRate    = static_cast<quint32>( scale->sampleRate() );
+    header.outputRate    = static_cast<quint32>( scale->outputRate() );
+    header.weightSamples = static_cast<quint32>( scale->weightSamples() );
+    header.numChannels   = static_cast<quint32>( scale->numChannels() );
+    header.startNsec     = startNsec;
+    header.startMsecs    = QDateTime::currentMSecsSinceEpoch();
+    strncpy( header.chip, qPrintable( scale->name() ), CAPTURE_CHIP_LEN - 1 );
+
+    if ( file_.write( reinterpret_cast<const char*>( &header ), sizeof(header) ) != sizeof(header) )
+    {
+        qDebug() << "Can't write capture header" << path;
+        file_.close();
+        return false;
+    }
+
+    //*** only what arrives from now on ***
+    next_ = ring_.written();
+
+    start( QThread::LowPriority );
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void CaptureWriter::close()
+{
+    //*** stop the writer, then pick up what it didn't get to ***
+    requestInterruption();
+    wait();
+
+    if ( !file_.isOpen() ) return;
+
+    drain();
+    file_.close();
+
+    qDebug() << "Capture" << file_.fileName() << ":" << written() << "records," << dropped() << "dropped";
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void CaptureWriter::record( int channel, qint32 value, qint64 timestamp )
+{
+t_CaptureRecord rec;
+
+    rec.timestamp = timestamp;
+    rec.value     = value;
+    rec.channel   = static_cast<quint16>( channel );
+    rec.flags     = 0;
+
+    //*** ring drops the oldest record on its own if the writer is behind ***
+    ring_.push( rec );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void CaptureWriter::run()
+{
+    while ( !isInterruptionRequested() )
+    {
+        drain();
+        msleep( FLUSH_MSEC );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void CaptureWriter::drain()
+{
+t_CaptureRecord batch[ WRITE_BATCH ];
+int num = 0;
+quint64 end = ring_.written();
+
+    //*** lapped - skip what was overwritten ***
+    if ( end - next_ > static_cast<quint64>( CAPTURE_RING_SIZE ) )
+    {
+        quint64 oldest = end - CAPTURE_RING_SIZE;
+        dropped_ += oldest - next_;
+        next_ = oldest;
+    }
+
+    while ( next_ < end )
+    {
+        //*** overwritten while we were copying ***
+        if ( !ring_.at( next_, batch[num] ) )
+        {
+            dropped_++;
+        }
+        else
+        {
+            num++;
+        }
+        next_++;
+
+        //*** write a full batch, or what's left ***
+        if ( num == WRITE_BATCH || ( next_ == end && num > 0 ) )
+        {
+            qint64 bytes = static_cast<qint64>( num ) * sizeof( t_CaptureRecord );
+            if ( file_.write( reinterpret_cast<const char*>( batch ), bytes ) != bytes )
+            {
+                qDebug() << "Capture write failed:" << file_.errorString();
+            }
+            else
+            {
+                written_ += num;
+            }
+            num = 0;
+        }
+    }
+
+    file_.flush();
+}
@@ -0,0 +1,76 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <QThread>
+#include <QFile>
+#include <atomic>
+#include "CaptureFormat.h"
+#include "SampleRing.h"
+
+class ScaleDriver;
+
+//*** records held between writes - ~25 seconds of two channels at 320 SPS ***
+const int CAPTURE_RING_SIZE = 16384;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The CaptureWriter class - records raw conversions to a capture file.
+ *
+ *  The acquisition path hands each conversion to record(), which only pushes
+ *  it into a lock-free ring. This thread wakes up periodically and writes
+ *  whatever has arrived, so file I/O never holds up sampling. If the disk
+ *  falls so far behind that the ring laps it, the lost records are counted.
+ */
+//*****************************************************************************
+class CaptureWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor ***
+    explicit CaptureWriter( QObject *parent = nullptr );
+
+    //*** destructor - writes anything left and closes the file ***
+    ~CaptureWriter();
+
+    //*** create the file with a header describing the scale, start writing ***
+    bool open( const QString &path, const ScaleDriver *scale, qint64 startNsec );
+
+    //*** write anything left and close the file ***
+    void close();
+
+    //*** add one conversion - producer (acquisition thread) only, never blocks ***
+    void record( int channel, qint32 value, qint64 timestamp );
+
+    //*** records written to the file / lost because the writer fell behind ***
+    quint64 written() const { return written_.load(); }
+    quint64 dropped() const { return dropped_.load(); }
+
+protected:
+
+    //*** writer main loop ***
+    void run() override;
+
+private:
+
+    //*** write everything in the ring to the file ***
+    void drain();
+
+    //*** capture file ***
+    QFile file_;
+
+    //*** conversions waiting to be written ***
+    SampleRing<t_CaptureRecord, CAPTURE_RING_SIZE> ring_;
+
+    //*** next ring index to write - writer thread only ***
+    quint64 next_;
+
+    //*** counters ***
+    std::atomic<quint64> written_;
+    std::atomic<quint64> dropped_;
+};
+
+#endif // CAPTUREWRITER_H
@@ -0,0 +1,496 @@
+#include "ConnectionManager.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QDebug>
+#include <string.h>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** smallest change in a live weight sent (hundredths) - stability changes always go ***
+const qint32 LIVE_DEADBAND = 2;
+
+
+//*****************************************************************************
+//*****************************************************************************
+ConnectionManager::ConnectionManager( QObject *parent ) : QObject( parent )
+{
+    svr_    = nullptr;
+    nextId_ = 1;
+    servers_ = 0;
+    liveHz_ = 0;
+
+    liveClock_.start();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ConnectionManager::~ConnectionManager()
+{
+    //*** close quietly - nobody is listening for the signals any more ***
+    foreach( t_Connection *c, connections_ )
+    {
+        c->sock->disconnect( this );
+        c->sock->abort();
+        c->sock->deleteLater();
+        delete c;
+    }
+    connections_.clear();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ConnectionManager::listen( quint16 port )
+{
+    //*** don't set up twice ***
+    if ( svr_ ) return true;
+
+    //*** create the server ***
+    svr_ = new QTcpServer( this );
+
+    //*** start listening on the port ***
+    if ( !svr_->listen( QHostAddress::Any, port ) )
+    {
+        qDebug() << "Error listening on TCP port" << port;
+        delete svr_;
+        svr_ = nullptr;
+        return false;
+    }
+
+    //*** handle incoming connections ***
+    connect( svr_, &QTcpServer::newConnection, this, &ConnectionManager::handleNewConnection );
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint16 ConnectionManager::port() const
+{
+    return svr_ ? svr_->serverPort() : 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ConnectionManager::t_Connection *ConnectionManager::find( QTcpSocket *sock ) const
+{
+    foreach( t_Connection *c, connections_ )
+    {
+        if ( c->sock == sock ) return c;
+    }
+    return nullptr;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ConnectionManager::t_Connection *ConnectionManager::find( int id ) const
+{
+    foreach( t_Connection *c, connections_ )
+    {
+        if ( c->id == id ) return c;
+    }
+    return nullptr;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ConnectionManager::mode( int id ) const
+{
+t_Connection *c = find( id );
+
+    return c ? c->reader.mode() : PROTOCOL_UNKNOWN;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint32 ConnectionManager::subscriptions( int id ) const
+{
+t_Connection *c = find( id );
+
+    return c ? c->subscriptions : 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::handleNewConnection()
+{
+    //*** take everything waiting - several can arrive at once ***
+    while ( svr_->hasPendingConnections() )
+    {
+        t_Connection *c = new t_Connection;
+        c->id            = nextId_++;
+        c->sock          = svr_->nextPendingConnection();
+        c->subscriptions = DEFAULT_SUBSCRIPTIONS;
+        c->sentFrame     = false;
+        c->sentRoster    = false;
+        c->server        = false;
+        c->liveHz        = 0;
+        c->liveDueMsec   = 0;
+        connections_.append( c );
+
+        //*** set up to receive data (and errors) ***
+        connect( c->sock, &QAbstractSocket::readyRead, this, &ConnectionManager::handleReadyRead );
+        connect( c->sock, &QAbstractSocket::disconnected, this, &ConnectionManager::handleDisconnected );
+        connect( c->sock, SIGNAL(error(QAbstractSocket::SocketError)),
+                 this, SLOT(handleError( QAbstractSocket::SocketError )) );
+
+        qDebug() << "Connection" << c->id << "from" << c->sock->peerAddress().toString()
+                 << "-" << connections_.size() << "open";
+
+        //*** not connected until it shows it is fpSvr - see updateServer() ***
+        emit connectionOpened( c->id );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::handleReadyRead()
+{
+t_FrameInfo frame;      // frame received
+t_Subscribe sub;        // subscription received
+t_ReportAck ack;        // report ack received
+t_Connection *c = find( static_cast<QTcpSocket*>( sender() ) );
+
+    if ( !c ) return;
+
+    //*** everything that has arrived, into this connection's buffer ***
+    int id = c->id;
+    bool known = ( c->reader.mode() != PROTOCOL_UNKNOWN );
+    c->reader.read( c->sock );
+
+    while ( c->reader.nextFrame( frame ) )
+    {
+        c->sentFrame = true;
+        if ( frame.type == FRAME_CHECKINS || frame.type == FRAME_SNAPSHOT || frame.type == FRAME_DELTA )
+        {
+            c->sentRoster = true;
+        }
+
+        //*** subscriptions are handled here ***
+        if ( frame.type == FRAME_SUBSCRIBE )
+        {
+            while ( c->reader.nextSubscribe( sub ) )
+            {
+                c->subscriptions = sub.topics;
+                c->liveHz        = ( sub.topics & SUBSCRIBE_LIVE ) ?
+                                   ( sub.liveHz ? qMin( static_cast<int>( sub.liveHz ), LIVE_MAX_HZ ) : LIVE_DEFAULT_HZ ) : 0;
+
+                //*** (re)subscribing starts over with every station's weight ***
+                c->liveDueMsec = 0;
+                c->live.clear();
+            }
+            updateLiveRate();
+            continue;
+        }
+
+        //*** acks go to whoever keeps the reports ***
+        if ( frame.type == FRAME_REPORT_ACK )
+        {
+            quint32 reportId = 0;
+            while ( c->reader.nextReportAck( ack ) )
+            {
+                reportId = qMax( reportId, ack.reportId );
+            }
+            if ( reportId != 0 ) emit reportsAcked( id, reportId );
+        }
+        else
+        {
+            emit checkInFrame( id, frame, &c->reader );
+        }
+
+        //*** the slot may have dropped the connection ***
+        if ( !find( id ) ) return;
+    }
+
+    emit framesDone( id );
+
+    //*** stream can't be followed any further - the client will reconnect ***
+    c = find( id );
+    if ( c && c->reader.failed() )
+    {
+        qDebug() << "Dropping connection" << id << "- bad frame";
+        remove( c );
+        return;
+    }
+
+    if ( !c ) return;
+
+    //*** it may have just shown it is fpSvr (or stopped wanting reports) ***
+    updateServer( c );
+
+    //*** first frames seen - it can be sent to in its own framing now ***
+    if ( !known && c->reader.mode() != PROTOCOL_UNKNOWN )
+    {
+        emit identified( id );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::handleDisconnected()
+{
+t_Connection *c = find( static_cast<QTcpSocket*>( sender() ) );
+
+    if ( c ) remove( c );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::handleError( QAbstractSocket::SocketError socketError )
+{
+Q_UNUSED( socketError )
+
+    //*** get socket that received error - a disconnect follows if it was fatal ***
+    QTcpSocket *sock = static_cast<QTcpSocket*>( sender() );
+    t_Connection *c = find( sock );
+
+    qDebug() << "Socket Error on connection" << ( c ? c->id : 0 ) << ":" << sock->errorString();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::remove( t_Connection *c )
+{
+int id = c->id;
+bool server = c->server;
+
+    //*** forget it before the socket can call back ***
+    connections_.removeAll( c );
+    c->sock->disconnect( this );
+    c->sock->abort();
+    c->sock->deleteLater();
+    delete c;
+
+    qDebug() << "Connection" << id << "closed -" << connections_.size() << "open";
+
+    emit connectionClosed( id );
+    if ( server && --servers_ == 0 ) emit connectedChanged( false );
+
+    updateLiveRate();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ConnectionManager::isServer( const t_Connection *c )
+{
+    //*** fixed size structs only ever come from fpSvr ***
+    if ( c->reader.mode() == PROTOCOL_LEGACY || c->sentRoster ) return true;
+
+    //*** framed - once it has said what it wants ***
+    return c->sentFrame && ( c->subscriptions & SUBSCRIBE_REPORTS );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::updateServer( t_Connection *c )
+{
+bool server = isServer( c );
+
+    if ( server == c->server ) return;
+
+    c->server = server;
+    servers_ += server ? 1 : -1;
+
+    if ( server && servers_ == 1 ) emit connectedChanged( true );
+    if ( !server && servers_ == 0 ) emit connectedChanged( false );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::updateLiveRate()
+{
+int hz = 0;
+
+    foreach( t_Connection *c, connections_ )
+    {
+        hz = qMax( hz, c->liveHz );
+    }
+
+    if ( hz == liveHz_ ) return;
+
+    liveHz_ = hz;
+    emit liveRateChanged( hz );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ConnectionManager::write( t_Connection *c, const QByteArray &data )
+{
+    //*** not reading what we send - don't let its backlog grow without bound ***
+    if ( c->sock->bytesToWrite() + data.size() > MAX_PENDING_BYTES )
+    {
+        qDebug() << "Dropping connection" << c->id << "-" << c->sock->bytesToWrite() << "bytes not sent";
+        remove( c );
+        return false;
+    }
+
+    c->sock->write( data );
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ConnectionManager::send( int id, const QByteArray &data )
+{
+t_Connection *c = find( id );
+
+    if ( c ) write( c, data );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ConnectionManager::sendReports( const QVector<t_WeightRecord> &reports, bool stationIds, int *legacy )
+{
+QByteArray framed;              // one frame with every report
+QByteArray fixed;               // the same as fixed size reports
+bool fixedBuilt = false;
+t_WeightReport wr;              // message struct
+t_StationWeightReport swr;      // message struct - several stations
+int sent = 0;
+
+    if ( legacy ) *legacy = 0;
+    if ( reports.isEmpty() ) return 0;
+
+    //*** built once, on first use, for everyone using that framing ***
+    foreach( t_Connection *c, QList<t_Connection*>( connections_ ) )
+    {
+        if ( !( c->subscriptions & SUBSCRIBE_REPORTS ) ) continue;
+
+        //*** hasn't said anything yet - it could be a monitor, or not there at all ***
+        //*** it is sent the backlog once identified() ***
+        if ( c->reader.mode() == PROTOCOL_UNKNOWN ) continue;
+
+        if ( c->reader.mode() == PROTOCOL_FRAMED )
+        {
+            if ( framed.isEmpty() )
+            {
+                FrameWriter frame( FRAME_WEIGHTS );
+                foreach( const t_WeightRecord &r, reports ) frame.addWeight( r );
+                framed = frame.frame();
+            }
+
+            if ( write( c, framed ) ) sent++;
+        }
+
+        //*** legacy - one report per station, or per person ***
+        else
+        {
+            for ( int i=0; !fixedBuilt && i<reports.size(); i++ )
+            {
+                const t_WeightRecord &r = reports[i];
+                if ( stationIds )
+                {
+                    memset( &swr, 0, STATION_REPORT_SIZE );
+                    swr.magic = MAGIC_VAL;
+                    swr.size = STATION_SIZE_FIELD;
+                    swr.type = STATION_REPORT_TYPE;
+
+                    swr.key = r.key;
+                    swr.weight = r.weight;
+                    swr.day = r.day;
+                    swr.station = r.station;
+
+                    fixed.append( (const char*)&swr, STATION_REPORT_SIZE );
+                }
+                else
+                {
+                    memset( &wr, 0, WEIGHT_REPORT_SIZE );
+                    wr.magic = MAGIC_VAL;
+                    wr.size = WEIGHT_SIZE_FIELD;
+                    wr.type = WEIGHT_REPORT_TYPE;
+
+                    wr.key = r.key;
+                    wr.weight = r.weight;
+                    wr.day = r.day;
+
+                    fixed.append( (const char*)&wr, WEIGHT_REPORT_SIZE );
+                }
+            }
+            fixedBuilt = true;
+
+            if ( write( c, fixed ) )
+            {
+                sent++;
+                if ( legacy ) (*legacy)++;
+            }
+        }
+    }
+
+    return sent;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ConnectionManager::sendLive( const QVector<t_LiveWeight> &weights )
+{
+qint64 now = liveClock_.elapsed();
+int sent = 0;
+
+    foreach( t_Connection *c, QList<t_Connection*>( connections_ ) )
+    {
+        if ( c->liveHz == 0 || now < c->liveDueMsec ) continue;
+
+        //*** still sending the last ones - what changed goes in the next frame instead ***
+        if ( c->sock->bytesToWrite() > LIVE_PENDING_BYTES ) continue;
+
+        //*** keep to the rate on average - one that fell behind starts over from now ***
+        c->liveDueMsec = qMax( c->liveDueMsec + 1000 / c->liveHz, now );
+
+        //*** stations it hasn't been sent yet get a keyframe ***
+        int known = c->live.size();
+        if ( known < weights.size() ) c->live.resize( weights.size() );
+
+        FrameWriter frame( FRAME_LIVE );
+        for ( int i=0; i<weights.size(); i++ )
+        {
+            const t_LiveWeight &w = weights[i];
+            t_LiveSent &last = c->live[i];
+
+            qint32 value = w.valid ? qRound( w.weight * 100.0f ) : 0;
+            quint8 flags = w.valid ? ( w.stable ? LIVE_STABLE : 0 ) : LIVE_NO_WEIGHT;
+
+            if ( i >= known )
+            {
+                frame.addLive( w.station, flags | LIVE_KEYFRAME, value );
+            }
+            else if ( flags != last.flags || qAbs( value - last.value ) >= LIVE_DEADBAND )
+            {
+                frame.addLive( w.station, flags, value - last.value );
+            }
+            else
+            {
+                continue;
+            }
+
+            last.value = value;
+            last.flags = flags;
+        }
+
+        //*** nothing moved - nothing sent ***
+        if ( frame.count() == 0 ) continue;
+
+        if ( write( c, frame.frame() ) ) sent++;
+    }
+
+    return sent;
+}
@@ -0,0 +1,194 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QAbstractSocket>
+#include <QElapsedTimer>
+#include "Protocol.h"
+
+class QTcpServer;
+class QTcpSocket;
+
+//*** a client that falls this far behind is dropped rather than buffered for ***
+const qint64 MAX_PENDING_BYTES = 256 * 1024;
+
+//*** live weights wait for the next frame while a client has this much unsent ***
+const qint64 LIVE_PENDING_BYTES = 4096;
+
+//*** one station's weight for sendLive() ***
+typedef struct
+{
+    int station;            // station id, 0 with a single scale
+    float weight;
+    bool stable;
+    bool valid;             // false until the station has a weight
+} t_LiveWeight;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ConnectionManager class - the scale's TCP server and everyone
+ *          connected to it.
+ *
+ *  Any number of clients can be connected - fpSvr, plus monitoring and
+ *  reporting clients. Each connection keeps its own receive buffer, framing
+ *  and subscriptions, and is known by an id that is never reused.
+ *
+ *  Only connections playing fpSvr's part count as connected: a legacy one,
+ *  one that has sent roster frames, or a framed one subscribed to reports.
+ *  Monitors, and sockets that haven't said anything, come and go unseen.
+ *
+ *  Check-in frames are handed out as they are parsed through checkInFrame(),
+ *  which must be connected directly - the records are only good until the
+ *  slot returns. framesDone() follows the last frame of each read.
+ *
+ *  Weight reports go to every connection subscribed to them, each in the
+ *  framing that connection uses, and each frame is built once per framing.
+ *  A connection whose framing isn't known yet gets nothing until it is -
+ *  see identified(). Acks for them are passed on through reportsAcked().
+ *
+ *  Live weights go at the rate each connection subscribed at, delta encoded
+ *  against what that connection was last sent. A connection with a backlog
+ *  is passed over, so its next frame carries the latest weights instead of
+ *  it being buffered for.
+ */
+//*****************************************************************************
+class ConnectionManager : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor ***
+    explicit ConnectionManager( QObject *parent = nullptr );
+
+    //*** destructor - closes every connection ***
+    ~ConnectionManager();
+
+    //*** start listening (port 0 picks a free one) - false if the port can't be used ***
+    bool listen( quint16 port );
+
+    //*** port listened on, 0 if not listening ***
+    quint16 port() const;
+
+    //*** connections open ***
+    int count() const { return connections_.size(); }
+
+    //*** connections playing fpSvr's part ***
+    int servers() const { return servers_; }
+
+    //*** framing a connection uses (PROTOCOL_xx) ***
+    int mode( int id ) const;
+
+    //*** topics a connection is subscribed to (SUBSCRIBE_xx) ***
+    quint32 subscriptions( int id ) const;
+
+    //*** send bytes to one connection ***
+    void send( int id, const QByteArray &data );
+
+    //*** weight reports to every connection subscribed to them - one frame, or a legacy report each ***
+    //*** stationIds tags legacy reports with the station ***
+    //*** connections that haven't identified() are passed over ***
+    //*** returns the number of connections sent to, legacy (if given) those sent legacy reports ***
+    int sendReports( const QVector<t_WeightRecord> &reports, bool stationIds, int *legacy = nullptr );
+
+    //*** fastest live rate anyone is subscribed at, 0 if nobody ***
+    int liveHz() const { return liveHz_; }
+
+    //*** live weights, one per station in station order, to every live subscriber that is due ***
+    //*** returns the number of connections sent to ***
+    int sendLive( const QVector<t_LiveWeight> &weights );
+
+signals:
+
+    //*** first connection playing fpSvr's part is up / last one is gone ***
+    void connectedChanged( bool connected );
+
+    //*** a connection opened / closed ***
+    void connectionOpened( int id );
+    void connectionClosed( int id );
+
+    //*** the framing a new connection uses is known - it can be sent to ***
+    void identified( int id );
+
+    //*** the fastest live rate subscribed at changed - 0 if nobody wants live weights ***
+    void liveRateChanged( int hz );
+
+    //*** a client has stored every report up to and including reportId ***
+    void reportsAcked( int id, quint32 reportId );
+
+    //*** a frame with check-ins arrived - walk it with reader->nextCheckIn() before returning ***
+    void checkInFrame( int id, const t_FrameInfo &frame, ProtocolReader *reader );
+
+    //*** all frames of one read have been handed out ***
+    void framesDone( int id );
+
+private slots:
+
+    void handleNewConnection();
+    void handleReadyRead();
+    void handleDisconnected();
+    void handleError( QAbstractSocket::SocketError socketError );
+
+private:
+
+    //*** a station's live weight as a connection was last sent it ***
+    typedef struct
+    {
+        qint32 value;       // hundredths
+        quint8 flags;       // LIVE_xx
+    } t_LiveSent;
+
+    //*** one client ***
+    typedef struct
+    {
+        int id;
+        QTcpSocket *sock;
+        ProtocolReader reader;
+        quint32 subscriptions;
+        bool sentFrame;             // a whole frame has arrived
+        bool sentRoster;            // check-in or roster frames have arrived
+        bool server;                // counted in servers_
+        int liveHz;                 // live rate subscribed at
+        qint64 liveDueMsec;         // when the next live frame is due
+        QVector<t_LiveSent> live;   // per station - empty until the first live frame
+    } t_Connection;
+
+    //*** connection of a socket / id - nullptr if it's gone ***
+    t_Connection *find( QTcpSocket *sock ) const;
+    t_Connection *find( int id ) const;
+
+    //*** write to a connection, dropping it if it has fallen too far behind - false if dropped ***
+    bool write( t_Connection *c, const QByteArray &data );
+
+    //*** forget a connection - the socket deletes itself ***
+    void remove( t_Connection *c );
+
+    //*** work out the fastest live rate, telling everyone if it changed ***
+    void updateLiveRate();
+
+    //*** does a connection play fpSvr's part ***
+    static bool isServer( const t_Connection *c );
+
+    //*** recount a connection after what it sent - connectedChanged() on the first / last ***
+    void updateServer( t_Connection *c );
+
+    //*** listening socket ***
+    QTcpServer *svr_;
+
+    //*** open connections, oldest first ***
+    QList<t_Connection*> connections_;
+    int nextId_;
+
+    //*** connections playing fpSvr's part ***
+    int servers_;
+
+    //*** fastest live rate subscribed at, and the clock live frames are due by ***
+    int liveHz_;
+    QElapsedTimer liveClock_;
+};
+
+#endif // CONNECTIONMANAGER_H
@@ -0,0 +1,116 @@
+#include "Decimator.h"
+
+
+//*****************************************************************************
+//*****************************************************************************
+Decimator::Decimator( int factor )
+{
+    setFactor( factor );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void Decimator::setFactor( int factor )
+{
+    factor_ = qMax( 1, factor );
+    reset();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void Decimator::reset()
+{
+    acc_   = 0;
+    count_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool Decimator::add( qint32 sample, qint32 &out )
+{
+    acc_ += sample;
+
+    //*** block not done yet ***
+    if ( ++count_ < factor_ ) return false;
+
+    //*** output the block average (rounded) ***
+    out = static_cast<qint32>( ( acc_ >= 0 ? acc_ + factor_ / 2 : acc_ - factor_ / 2 ) / factor_ );
+
+    reset();
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int Decimator::process( const qint32 *in, int num, qint32 *out )
+{
+int numOut = 0;
+int idx = 0;
+
+    //*** finish any partial block one sample at a time ***
+    while ( count_ > 0 && idx < num )
+    {
+        if ( add( in[idx++], out[numOut] ) ) numOut++;
+    }
+
+    //*** whole blocks ***
+    while ( num - idx >= factor_ )
+    {
+        qint64 total = sum( &in[idx], factor_ );
+        out[numOut++] = static_cast<qint32>( ( total >= 0 ? total + factor_ / 2 : total - factor_ / 2 ) / factor_ );
+        idx += factor_;
+    }
+
+    //*** keep the leftovers for next time ***
+    while ( idx < num )
+    {
+        if ( add( in[idx++], out[numOut] ) ) numOut++;
+    }
+
+    return numOut;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint64 Decimator::sum( const qint32 *values, int num )
+{
+qint64 total = 0;
+
+    for ( int i=0; i<num; i++ )
+    {
+        total += values[i];
+    }
+
+    return total;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void Decimator::toWeight( const qint32 *raw, int num, int tare, double scale, float *weights )
+{
+    //*** independent per element - vectorizes ***
+    for ( int i=0; i<num; i++ )
+    {
+        weights[i] = static_cast<float>( static_cast<double>( raw[i] - tare ) * scale );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+float Decimator::meanWeight( const qint32 *raw, int num, int tare, double scale )
+{
+    if ( num <= 0 ) return 0.0f;
+
+    //*** conversion is linear - average the raw values, convert once ***
+    double mean = static_cast<double>( sum( raw, num ) ) / static_cast<double>( num );
+
+    return static_cast<float>( ( mean - static_cast<double>( tare ) ) * scale );
+}
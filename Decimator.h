@@ -0,0 +1,57 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <QtGlobal>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The Decimator class - boxcar (first order CIC) decimating filter.
+ *
+ *  Averages each block of 'factor' raw samples into one output sample, so a
+ *  high conversion rate is turned into a lower rate stream with the noise
+ *  reduced by roughly sqrt(factor).
+ *  The block functions work on plain arrays with no loop carried state other
+ *  than the running sum, so the compiler can vectorize them.
+ */
+//*****************************************************************************
+class Decimator
+{
+public:
+
+    //*** constructor ***
+    explicit Decimator( int factor = 1 );
+
+    //*** change the decimation factor - drops any partial block ***
+    void setFactor( int factor );
+    int factor() const { return factor_; }
+
+    //*** add one raw sample - returns true and sets 'out' when a block completes ***
+    bool add( qint32 sample, qint32 &out );
+
+    //*** decimate a block of raw samples - returns the number of outputs ***
+    int process( const qint32 *in, int num, qint32 *out );
+
+    //*** discard any partial block ***
+    void reset();
+
+    //*** sum of a block of samples ***
+    static qint64 sum( const qint32 *values, int num );
+
+    //*** convert a block of raw values to weights ***
+    static void toWeight( const qint32 *raw, int num, int tare, double scale, float *weights );
+
+    //*** average weight of a block of raw values ***
+    static float meanWeight( const qint32 *raw, int num, int tare, double scale );
+
+private:
+
+    //*** raw samples per output ***
+    int factor_;
+
+    //*** partial block ***
+    qint64 acc_;
+    int count_;
+};
+
+#endif // DECIMATOR_H
@@ -14,18 +14,59 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         MainWindow.cpp \
+        ScaleDriver.cpp \
         HX711.cpp \
+        HX711Port.cpp \
+        HX711Reader.cpp \
+        SimHX711.cpp \
+        CaptureWriter.cpp \
+        ReplayDriver.cpp \
         ClickLabel.cpp \
         KeyPad.cpp \
         NameListDlg.cpp \
-        NAU7802.cpp
+        NAU7802.cpp \
+        NAU7802Reader.cpp \
+        I2CBus.cpp \
+        GpioLine.cpp \
+        ScaleClock.cpp \
+        SimNAU7802.cpp \
+        Decimator.cpp \
+        SlidingMedian.cpp \
+        HampelFilter.cpp \
+        StabilityDetector.cpp \
+        ScaleRegistry.cpp \
+        Protocol.cpp \
+        ConnectionManager.cpp \
+        ReportJournal.cpp
 
 HEADERS  += MainWindow.h \
+            ScaleDriver.h \
             HX711.h \
+            HX711Port.h \
+            HX711Reader.h \
+            SimHX711.h \
+            CaptureFormat.h \
+            CaptureWriter.h \
+            ReplayDriver.h \
             ClickLabel.h \
             KeyPad.h \
             NameListDlg.h \
-            NAU7802.h
+            NAU7802.h \
+            NAU7802Reader.h \
+            SampleRing.h \
+            SampleStore.h \
+            I2CBus.h \
+            GpioLine.h \
+            ScaleClock.h \
+            SimNAU7802.h \
+            Decimator.h \
+            SlidingMedian.h \
+            HampelFilter.h \
+            StabilityDetector.h \
+            ScaleRegistry.h \
+            Protocol.h \
+            ConnectionManager.h \
+            ReportJournal.h
 
 FORMS    += MainWindow.ui \
             KeyPad.ui \
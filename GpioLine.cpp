@@ -0,0 +1,106 @@
+#include "GpioLine.h"
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <QDebug>
+
+
+//*****************************************************************************
+//*****************************************************************************
+GpioChipLine::GpioChipLine( QString chipPath, int line )
+{
+    chipPath_ = chipPath;
+    line_     = line;
+    fd_       = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+GpioChipLine::~GpioChipLine()
+{
+    if ( fd_ >= 0 ) ::close( fd_ );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool GpioChipLine::open( Edge edge )
+{
+struct gpioevent_request req;
+
+    //*** open the chip ***
+    int chipFd = ::open( qPrintable(chipPath_), O_RDONLY | O_CLOEXEC );
+    if ( chipFd < 0 )
+    {
+        qDebug() << "Error opening" << chipPath_;
+        return false;
+    }
+
+    //*** request the line as an input with edge events ***
+    memset( &req, 0, sizeof(req) );
+    req.lineoffset  = static_cast<__u32>( line_ );
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags  = ( edge == RISING_EDGE ) ? GPIOEVENT_REQUEST_RISING_EDGE
+                                              : GPIOEVENT_REQUEST_FALLING_EDGE;
+    strncpy( req.consumer_label, "FoodPantry", sizeof(req.consumer_label) - 1 );
+
+    int rc = ioctl( chipFd, GPIO_GET_LINEEVENT_IOCTL, &req );
+
+    //*** line fd stays valid after the chip is closed ***
+    ::close( chipFd );
+
+    if ( rc < 0 )
+    {
+        qDebug() << "Error requesting GPIO line" << line_ << ":" << strerror( errno );
+        return false;
+    }
+
+    fd_ = req.fd;
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioChipLine::waitForEdge( int timeoutMsec )
+{
+struct pollfd pfd;
+struct gpioevent_data event;
+
+    if ( fd_ < 0 ) return -1;
+
+    //*** wait for the kernel to report an edge ***
+    pfd.fd      = fd_;
+    pfd.events  = POLLIN | POLLPRI;
+    pfd.revents = 0;
+
+    int rc = poll( &pfd, 1, timeoutMsec );
+    if ( rc == 0 ) return 0;
+    if ( rc < 0 ) return ( errno == EINTR ) ? 0 : -1;
+
+    //*** consume the event ***
+    if ( ::read( fd_, &event, sizeof(event) ) != sizeof(event) ) return -1;
+
+    return 1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioChipLine::level()
+{
+struct gpiohandle_data data;
+
+    if ( fd_ < 0 ) return -1;
+
+    memset( &data, 0, sizeof(data) );
+    if ( ioctl( fd_, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data ) < 0 ) return -1;
+
+    return data.values[0];
+}
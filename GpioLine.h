@@ -0,0 +1,67 @@
+#ifndef GPIOLINE_H
+#define GPIOLINE_H
+
+#include <QString>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The GpioLine class - a single GPIO input that reports edges.
+ *
+ *  Used for data ready style signals so the acquisition thread can sleep
+ *  until the hardware has something for it.
+ */
+//*****************************************************************************
+class GpioLine
+{
+public:
+
+    typedef enum { RISING_EDGE, FALLING_EDGE } Edge;
+
+    virtual ~GpioLine() {}
+
+    //*** open the line as an input reporting the given edge ***
+    virtual bool open( Edge edge ) = 0;
+
+    //*** wait for an edge - returns 1 on edge, 0 on timeout, -1 on error ***
+    virtual int waitForEdge( int timeoutMsec ) = 0;
+
+    //*** current level of the line (0/1), -1 on error ***
+    virtual int level() = 0;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The GpioChipLine class - GPIO line through the Linux gpio character
+ *              device ( /dev/gpiochipN ), edges are delivered by the kernel.
+ */
+//*****************************************************************************
+class GpioChipLine : public GpioLine
+{
+public:
+
+    //*** constructor ***
+    GpioChipLine( QString chipPath, int line );
+
+    //*** destructor ***
+    ~GpioChipLine() override;
+
+    bool open( Edge edge ) override;
+    int waitForEdge( int timeoutMsec ) override;
+    int level() override;
+
+private:
+
+    //*** e.g. /dev/gpiochip0 ***
+    QString chipPath_;
+
+    //*** line offset on the chip (BCM GPIO number on the Pi) ***
+    int line_;
+
+    //*** line event fd returned by the kernel ***
+    int fd_;
+};
+
+#endif // GPIOLINE_H
@@ -1,7 +1,7 @@
 #include "HX711.h"
-#include <wiringPi.h>
-#include <stdio.h>
-#include <QElapsedTimer>
+#include "HX711Port.h"
+#include "HX711Reader.h"
+#include "ScaleClock.h"
 #include <QDebug>
 
 //*****************
@@ -10,298 +10,225 @@
 
 const int SAMPLES_PER_WEIGHT = 4;
 
+//*** RATE pin low - no decimation ***
 const int SAMPLES_PER_SECOND = 10;
-const int SECONDS_QUEUED     = 2;
-const int QUEUE_SIZE         = SAMPLES_PER_SECOND * SECONDS_QUEUED;
 
+//*** an input or gain change takes 4 conversions to settle ***
+const int GAIN_SETTLE = 4;
 
-//*** Delay for one pulse length ***
-#define PulseDelay delayMicroseconds( 5 );
-
-
-//***********************************
-//*** ISR routine and static vars ***
-//***********************************
-static void H_fallingEdgeISR();
-
-//static HX711 *hx711_ = nullptr;
-
-//*** GPIO pins ***
-static int DT_Pin_  = 0;
-static int SCK_Pin_ = 0;
-
-//*** num samples left to collect ***
-//static volatile int samplesToCollect_ = 0;
-
-//*** array of sample values ***
-static QQueue<int> collectedData_;
-
-//*** flag to indicate that we are reading in data ***
-static volatile bool readingData_ = false;
-
-//*** sign extend the 24 bit value ***
-int extendSign( int rawVal )
-{
-    //*** if negative ***
-    if ( (rawVal & (0x00800000)) > 0 )
-    {
-        //*** sign extend top byte ***
-        rawVal |= 0xFF000000;
-    }
-
-    return rawVal;
-}
+//*** 24 bit A/D converter ***
+const int NUM_BITS = 24;
 
+//*** SCK high for 60 usec powers the chip down - leave some margin ***
+const qint64 MAX_PULSE_NSEC = 50000;
 
+//*** SCHED_FIFO priority of the acquisition thread ***
+const int RT_PRIORITY = 50;
 
 
 //*****************************************************************************
 //*****************************************************************************
-HX711::HX711( int DT_GPIO, int SCK_GPIO, int rawTare, double scale )
+HX711::HX711( HX711Port *port, int rawTare, double scale, int gain,
+              const t_StabilityConfig &stability, ScaleClock *clock )
+    : ScaleDriver( rawTare, scale, clock )
 {
     //*** save initialization values ***
-    DT_Pin_  = DT_GPIO;
-    SCK_Pin_ = SCK_GPIO;
-    tare_    = rawTare;
-    scale_   = scale;
+    port_ = port;
 
-    //*** ensure wiring pi library is set up for GPIO numbering ***
-    wiringPiSetupGpio() ;
+    //*** chip powers up at gain 128 - the first read moves it to the gain asked for ***
+    gain_       = isValidGain( gain ) ? gain : HX711_GAIN_A128;
+    pulses_     = HX711_GAIN_A128;
+    settleLeft_ = 0;
+    ready_      = false;
 
-    //*** set up serial shift pins ***
-    pinMode( DT_GPIO, INPUT );
-    pinMode( SCK_GPIO, OUTPUT );
-
-    //*** Set up interrupt Service Routine on falling edge of DT pin ***
-    wiringPiISR( DT_GPIO, INT_EDGE_FALLING, H_fallingEdgeISR );
-}
+    reads_    = 0;
+    corrupt_  = 0;
+    overlong_ = 0;
+    timeouts_ = 0;
 
+    //*** one channel at the chip rate ***
+    setupPipeline( SAMPLES_PER_SECOND, SAMPLES_PER_SECOND, SAMPLES_PER_WEIGHT, 1, stability );
 
-//*****************************************************************************
-//*****************************************************************************
-HX711::~HX711()
-{
-
+    reader_ = new HX711Reader( this, RT_PRIORITY );
 }
 
 
-
 //*****************************************************************************
 //*****************************************************************************
-float HX711::getWeight()
+HX711::~HX711()
 {
-t_DataSet data;
-float totalWeight = 0.0;
+t_HX711Errors errors;
 
-    //*** get samples for weight ***
-    collectProcessedData( SAMPLES_PER_WEIGHT, data );
+    //*** stop and clean up acquisition thread (may never have started) ***
+    reader_->stop();
+    delete reader_;
 
-    //*** no data ***
-    if ( data.isEmpty() ) return -1.0;
-
-    //*** calculate average weight ***
-    foreach( int sample, data )
+    //*** report how clean the reads were ***
+    getErrors( errors );
+    if ( errors.reads > 0 )
     {
-        totalWeight += ( ((double)sample - (double)tare_) * scale_ );
+        qDebug() << "HX711:" << errors.reads << "reads," << errors.corrupt << "corrupt,"
+                 << errors.overlong << "over-length," << errors.timeouts << "timeouts,"
+                 << errors.errorRate * 100.0 << "% errors";
     }
 
-    //*** compute the average weight ***
-    float weightVal = (float)( totalWeight / (float)data.size() );
-
-    return weightVal;
+    delete port_;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-int HX711::getRawAvg( int numSamples )
+void HX711::start()
 {
-t_DataSet data;
-long long totalVal = 0;
-
-    //*** get samples for weight ***
-    collectProcessedData( numSamples, data );
+    //*** from here on only the acquisition thread touches the pins ***
+    reader_->start();
+}
 
-    //*** no data ***
-    if ( data.isEmpty() ) return 0;
 
-    //*** calculate average value ***
-    foreach( int sample, data )
+//*****************************************************************************
+//*****************************************************************************
+bool HX711::bringUp()
+{
+    if ( !port_->open() )
     {
-        totalVal += sample;
+        emit failed( QString( "Can't open HX711 pins (%1)" ).arg( port_->name() ) );
+        return false;
     }
 
-    //*** compute the average weight ***
-    int avgVal = (int)( totalVal / data.size() );
+    ready_ = true;
+    emit ready();
 
-    return avgVal;
+    return true;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-void HX711::setCalibrationData( int tareVal, int weightVal, float actualWeight )
+void HX711::setGain( int gain )
 {
-    //*** save new raw tare value ***
-    tare_ = tareVal;
+    if ( !isValidGain( gain ) ) return;
 
-    //*** calculate scale factor ***
-    double weight = static_cast<double>(actualWeight);
-    scale_ = (double)( weight / ((double)weightVal - (double)tareVal) );
+    gain_ = gain;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-void HX711::getCalibrationData( int &rawTareValue, double &scaleValue )
+bool HX711::isValidGain( int gain )
 {
-    rawTareValue = tare_;
-    scaleValue = scale_;
+    return ( gain == HX711_GAIN_A128 || gain == HX711_GAIN_B32 || gain == HX711_GAIN_A64 );
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-void HX711::setTare( int tareVal )
+void HX711::getErrors( t_HX711Errors &errors )
 {
-    tare_ = tareVal;
+    errors.reads    = reads_.load();
+    errors.corrupt  = corrupt_.load();
+    errors.overlong = overlong_.load();
+    errors.timeouts = timeouts_.load();
+
+    errors.errorRate = ( errors.reads > 0 ) ?
+                static_cast<double>( errors.corrupt + errors.overlong ) / errors.reads : 0.0;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-int HX711::collectRawData( int numSamples, t_DataSet &data )
+qint32 HX711::extendSign( qint32 rawVal )
 {
-QQueue<int> samples;    // place to hold copy of collected data
-
-    //*** clear output data ***
-    data.clear();
-
-    //*** get current queue size ***
-    int qSize = collectedData_.size();
-
-    // must have samples ***
-    if ( qSize == 0 ) return 0;
-
-    //*** copy data to minimize chance of it changing in the middle of processing ***
-    samples = collectedData_;
-
-    //*** use as many samples as we can get, up to requested amount ***
-    numSamples = qMin( qSize, numSamples );
-
-    //*** grab requested samples from end of queue and add to list ***
-    int lastIdx = qSize - 1;
-    int firstIdx = lastIdx  - numSamples + 1;
-    for ( int idx = firstIdx; idx <= lastIdx; idx++ )
+    //*** if negative ***
+    if ( (rawVal & (0x00800000)) > 0 )
     {
-        data.append( samples[idx] );
+        //*** sign extend top byte ***
+        rawVal |= 0xFF000000;
     }
 
-    return data.size();
-
+    return rawVal;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-int HX711::collectProcessedData(int numSamples, t_DataSet &data)
+bool HX711::readNext( int timeoutMsec )
 {
-    //*** get raw samples ***
-    int actualNumSamples = collectRawData( numSamples, data );
-
-    //*** must have samples to do processing ***
-    if ( actualNumSamples < 2 ) return 0;
-
-    //*** determine median value ***
-    qSort( data );
-
-    int median = 0;
-    int variant = 0;
-    int mid = numSamples / 2;
-    if ( (numSamples%2 == 0) )
-    {
-        //*** even # samples ***
-        median = ( data[mid] + data[mid-1] ) / 2;
-    }
-    else
-    {
-        //*** odd # samples ***
-        median = data[mid];
-    }
+    int rc = port_->waitForReady( timeoutMsec );
 
-    //*** determine variant threshold ***
-    variant = median / 10;
+    if ( rc < 0 ) return false;
 
-    //*** remove outliers ***
-    for ( int i=0; i<numSamples; i++ )
+    if ( rc == 0 )
     {
-        int diff = abs( data[i] - median );
-        if ( diff > abs(variant) )
-        {
-            //*** replace outlier with median value ***
-            data[i] = median;
-        }
+        timeouts_++;
+        return true;
     }
 
-    return data.size();
+    takeReading();
+    return true;
 }
 
 
 //*****************************************************************************
-//********************************** ISR **************************************
 //*****************************************************************************
-static void H_fallingEdgeISR()
+void HX711::takeReading()
 {
 int i = 0;
-int sample = 0;
-const int NUM_BITS = 24;    // 24 bit A/D converter
-
-    //*** make sure we are valid to read ***
-    //*** reading flag should be reset and DT oin should be low ***
-    if ( readingData_ || digitalRead( DT_Pin_ ) == 1 ) return;
+int bit;
+qint32 sample = 0;
+int pulses = gain_.load();
+qint64 pulseStart;
+qint64 longest = 0;
+qint64 timestamp;
 
-    //*** set reading flag ***
-    readingData_ = true;
+    reads_++;
 
-    //*** need delay before reading data ***
-    PulseDelay
-
-    //*** get all bits ***
-    for ( i=0; i<NUM_BITS; i++ )
+    //*** 24 data bits, MSB first, then 1-3 more pulses to pick the next gain ***
+    for ( i=0; i<pulses; i++ )
     {
-        //*** bring clock high ***
-        digitalWrite( SCK_Pin_, HIGH );
-
-        //*** shift current value to make room for bit ***
-        sample <<= 1;
+        pulseStart = clock_->nsecs();
+        bit = port_->clockBit();
+        longest = qMax( longest, clock_->nsecs() - pulseStart );
 
-        //*** Delay for typical pulse width on clock ***
-        PulseDelay
+        if ( bit < 0 ) break;
 
-        //*** bring clock low ***
-        digitalWrite( SCK_Pin_, LOW );
-
-        //*** if HIGH, add the bit to the value ***
-        if ( digitalRead( DT_Pin_ ) )
-        {
-            sample |= 0x0001;
-        }
+        if ( i < NUM_BITS ) sample = ( sample << 1 ) | bit;
     }
+    timestamp = clock_->nsecs();
 
-    //*** need one more pulse to indicate a gain of 128 ***
-    //*** 2 pulses = gain of 32, 3 pulses = gain of 64  ***
-    PulseDelay
-    digitalWrite( SCK_Pin_, HIGH );
-    PulseDelay
-    digitalWrite( SCK_Pin_, LOW );
+    //*** preempted with SCK high - the chip reset itself back to gain 128 ***
+    if ( longest > MAX_PULSE_NSEC )
+    {
+        overlong_++;
+        pulses_ = HX711_GAIN_A128;
+        settleLeft_ = GAIN_SETTLE;
+        restartChannel( SCALE_CHANNEL_1 );
+        return;
+    }
 
-    //*** save data ***
-    collectedData_.enqueue( -extendSign(sample) );
+    //*** DT goes high after the last pulse until the next conversion - if not, we're out of step ***
+    if ( i < pulses || port_->level() != 1 )
+    {
+        corrupt_++;
+    }
 
-    //*** limit queue size - get rid of oldest data ***
-    while ( collectedData_.size() > QUEUE_SIZE ) collectedData_.dequeue();
+    //*** save data unless the input is still settling ***
+    else if ( settleLeft_ > 0 )
+    {
+        settleLeft_--;
+        discarded_[SCALE_CHANNEL_1]++;
+    }
+    else if ( addConversion( SCALE_CHANNEL_1, -extendSign( sample ), timestamp ) )
+    {
+        sampleAdded( timestamp );
+    }
 
-    //*** reset flag ***
-    readingData_ = false;
+    //*** gain changed - the next conversion is the first on the new input ***
+    //*** a read cut short never sent the gain pulses, so the chip kept its gain ***
+    if ( i == pulses && pulses != pulses_ )
+    {
+        pulses_ = pulses;
+        settleLeft_ = GAIN_SETTLE;
+        restartChannel( SCALE_CHANNEL_1 );
+        switches_[SCALE_CHANNEL_1]++;
+    }
 }
-
@@ -1,55 +1,121 @@
 #ifndef HX711_H
 #define HX711_H
 
-#include <QList>
-#include <QQueue>
+#include <atomic>
+#include "ScaleDriver.h"
 
-typedef QList<int> t_DataSet;
+class HX711Port;
+class HX711Reader;
 
-class HX711
+//*** clock pulses per read - the pulses after the 24 data bits pick ***
+//*** the input and gain of the NEXT conversion ***
+typedef enum
 {
+    HX711_GAIN_A128 = 25,   // channel A, gain 128
+    HX711_GAIN_B32  = 26,   // channel B, gain 32
+    HX711_GAIN_A64  = 27,   // channel A, gain 64
+} HX711_Gain;
+
+//*** read error counters ***
+typedef struct
+{
+    quint64 reads;          // conversions clocked out
+    quint64 corrupt;        // DT still low after the trailing pulses - out of step
+    quint64 overlong;       // an SCK pulse long enough to power the chip down
+    quint64 timeouts;       // no conversion within the timeout
+    double errorRate;       // (corrupt + overlong) / reads
+} t_HX711Errors;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The HX711 class - bit banged HX711 load cell ADC.
+ *
+ *  The pins are driven through an HX711Port. Conversions are clocked out by
+ *  a real-time priority acquisition thread, which is the single producer for
+ *  this instance's sample rings.
+ *
+ *  Every read is checked: a pulse held high long enough to power the chip
+ *  down, or DT not returning high after the trailing pulses, means the bits
+ *  can't be trusted. Those samples are dropped and counted.
+ *
+ *  The gain can be changed at any time. The conversions made while the new
+ *  input settles are thrown away. Calibration is for whichever gain is in use.
+ */
+//*****************************************************************************
+class HX711 : public ScaleDriver
+{
+    Q_OBJECT
+
 public:
 
-    //*** constructor ***
-    HX711( int DT_GPIO, int SCK_GPIO, int rawTare, double scale );
+    //*** constructor - takes ownership of the port ***
+    HX711( HX711Port *port, int rawTare, double scale, int gain = HX711_GAIN_A128,
+           const t_StabilityConfig &stability = StabilityDetector::defaultConfig(),
+           ScaleClock *clock = nullptr );
 
     //*** destructor ***
     ~HX711();
 
-    //*** request the current scale weight ***
-    float getWeight();
+    //*** chip name ***
+    QString name() const override { return QString( "HX711" ); }
+
+    //*** open the pins and start sampling in the acquisition thread ***
+    //*** connect to ready()/failed() first ***
+    void start() override;
 
-    //*** collect n samples  ***
-    int collectRawData( int numSamples, t_DataSet &data );
+    //*** pins are open and samples are being taken ***
+    bool isReady() const override { return ready_.load(); }
 
-    //*** collect n samples - reject outliers ***
-    int collectProcessedData( int numSamples, t_DataSet &data );
+    //*** gain / input for the following conversions - any thread ***
+    void setGain( int gain );
+    int gain() const { return gain_.load(); }
 
-    //*** get the raw average of n samples - reject outliers ***
-    int getRawAvg( int numSamples );
+    //*** read error counters ***
+    void getErrors( t_HX711Errors &errors );
 
-    //*** set the data used for calibration ***
-    void setCalibrationData( int tareVal, int weightVal, float actualWeight );
+    //*** true for one of the HX711_GAIN_xx values ***
+    static bool isValidGain( int gain );
 
-    //*** get the data derived from the calibration ***
-    void getCalibrationData( int &rawTareValue, double &scaleValue );
+    //*** sign extend the 24 bit value ***
+    static qint32 extendSign( qint32 rawVal );
 
-    //*** start using a new tare value ***
-    void setTare( int tareVal );
+    //*** open the pins - called from the acquisition thread ***
+    bool bringUp();
 
+    //*** wait for the next conversion and read it - called from the acquisition thread ***
+    //*** returns false if the pins failed ***
+    bool readNext( int timeoutMsec );
 
 private:
 
-    //*** gets the number of requested samples from the collected queue ***
-    //*** returns the number of samples actually retrieved ***
-    int getSamples( int numSamples, t_DataSet &data );
+    //*** clock out one conversion - acquisition thread only ***
+    void takeReading();
+
+    //*** DT and SCK ***
+    HX711Port *port_;
+
+    //*** requested gain - picked up by the next read ***
+    std::atomic<int> gain_;
+
+    //*** gain the conversion being made was started with - acquisition thread only ***
+    int pulses_;
+
+    //*** conversions left to throw away after a gain change - acquisition thread only ***
+    int settleLeft_;
+
+    //*** pins open ***
+    std::atomic<bool> ready_;
 
-    //*** raw tare value (zero weight) ***
-    int tare_;
+    //*** read error counters - written by the acquisition thread ***
+    std::atomic<quint64> reads_;
+    std::atomic<quint64> corrupt_;
+    std::atomic<quint64> overlong_;
+    std::atomic<quint64> timeouts_;
 
-    //*** scale factor to produce desired weight units ***
-    //*** produced as part of calibration
-    double scale_;
+    //*** sample acquisition thread ***
+    HX711Reader *reader_;
 
 };
 
@@ -0,0 +1,343 @@
+#include "HX711Port.h"
+#include "GpioLine.h"
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <QThread>
+#include <QDebug>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** BCM283x GPIO register block (32 bit word offsets) ***
+const int GPIO_MAP_SIZE = 4096;
+const int GPFSEL0       = 0x00 / 4;
+const int GPSET0        = 0x1C / 4;
+const int GPCLR0        = 0x28 / 4;
+const int GPLEV0        = 0x34 / 4;
+
+const quint32 FSEL_INPUT  = 0;
+const quint32 FSEL_OUTPUT = 1;
+
+//*** SCK high and low time - the HX711 needs 0.2 usec, well under the 60 usec power down ***
+const qint64 PULSE_NSEC = 1000;
+
+//*** DT poll interval when there is no edge line - a tenth of an 80 SPS period ***
+const int POLL_USEC = 1000;
+
+
+//*****************************************************************************
+//*****************************************************************************
+static qint64 monotonicNsec()
+{
+struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return static_cast<qint64>( ts.tv_sec ) * 1000000000LL + ts.tv_nsec;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+static void spinNsec( qint64 nsec )
+{
+    //*** far too short to sleep - busy wait ***
+    qint64 end = monotonicNsec() + nsec;
+    while ( monotonicNsec() < end ) {}
+}
+
+
+//*****************************************************************************
+//***************************** GpioChipHX711Port *****************************
+//*****************************************************************************
+GpioChipHX711Port::GpioChipHX711Port( QString chipPath, int dtLine, int sckLine )
+{
+    chipPath_ = chipPath;
+    dtLine_   = dtLine;
+    sckLine_  = sckLine;
+    dtFd_     = -1;
+    sckFd_    = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+GpioChipHX711Port::~GpioChipHX711Port()
+{
+    if ( dtFd_ >= 0 ) ::close( dtFd_ );
+    if ( sckFd_ >= 0 ) ::close( sckFd_ );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool GpioChipHX711Port::open()
+{
+struct gpiohandle_request sckReq;
+struct gpioevent_request dtReq;
+
+    //*** open the chip ***
+    int chipFd = ::open( qPrintable(chipPath_), O_RDONLY | O_CLOEXEC );
+    if ( chipFd < 0 )
+    {
+        qDebug() << "Error opening" << chipPath_;
+        return false;
+    }
+
+    //*** SCK - output, starting low ***
+    memset( &sckReq, 0, sizeof(sckReq) );
+    sckReq.lineoffsets[0]    = static_cast<__u32>( sckLine_ );
+    sckReq.lines             = 1;
+    sckReq.flags             = GPIOHANDLE_REQUEST_OUTPUT;
+    sckReq.default_values[0] = 0;
+    strncpy( sckReq.consumer_label, "FoodPantry", sizeof(sckReq.consumer_label) - 1 );
+
+    //*** DT - input with falling edge events ***
+    memset( &dtReq, 0, sizeof(dtReq) );
+    dtReq.lineoffset  = static_cast<__u32>( dtLine_ );
+    dtReq.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    dtReq.eventflags  = GPIOEVENT_REQUEST_FALLING_EDGE;
+    strncpy( dtReq.consumer_label, "FoodPantry", sizeof(dtReq.consumer_label) - 1 );
+
+    int sckRc = ioctl( chipFd, GPIO_GET_LINEHANDLE_IOCTL, &sckReq );
+    int sckErr = errno;
+    int dtRc  = ioctl( chipFd, GPIO_GET_LINEEVENT_IOCTL, &dtReq );
+    int dtErr = errno;
+
+    //*** line fds stay valid after the chip is closed ***
+    ::close( chipFd );
+
+    if ( sckRc < 0 )
+    {
+        qDebug() << "Error requesting GPIO line" << sckLine_ << ":" << strerror( sckErr );
+        if ( dtRc >= 0 ) ::close( dtReq.fd );
+        return false;
+    }
+    if ( dtRc < 0 )
+    {
+        qDebug() << "Error requesting GPIO line" << dtLine_ << ":" << strerror( dtErr );
+        ::close( sckReq.fd );
+        return false;
+    }
+
+    sckFd_ = sckReq.fd;
+    dtFd_  = dtReq.fd;
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioChipHX711Port::waitForReady( int timeoutMsec )
+{
+struct pollfd pfd;
+struct gpioevent_data event;
+qint64 deadline = monotonicNsec() + static_cast<qint64>( timeoutMsec ) * 1000000;
+
+    if ( dtFd_ < 0 ) return -1;
+
+    pfd.fd     = dtFd_;
+    pfd.events = POLLIN | POLLPRI;
+
+    while ( true )
+    {
+        //*** the data bits of the last read queued edges of their own - drop them ***
+        pfd.revents = 0;
+        while ( poll( &pfd, 1, 0 ) > 0 )
+        {
+            if ( ::read( dtFd_, &event, sizeof(event) ) != sizeof(event) ) return -1;
+        }
+
+        //*** may already be waiting for us ***
+        int dt = level();
+        if ( dt < 0 ) return -1;
+        if ( dt == 0 ) return 1;
+
+        //*** sleep until DT falls ***
+        int waitMsec = static_cast<int>( ( deadline - monotonicNsec() ) / 1000000 );
+        if ( waitMsec <= 0 ) return 0;
+
+        int rc = poll( &pfd, 1, waitMsec );
+        if ( rc == 0 ) return 0;
+        if ( rc < 0 && errno != EINTR ) return -1;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool GpioChipHX711Port::setClock( int level )
+{
+struct gpiohandle_data data;
+
+    memset( &data, 0, sizeof(data) );
+    data.values[0] = static_cast<__u8>( level );
+
+    return ( ioctl( sckFd_, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data ) >= 0 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioChipHX711Port::clockBit()
+{
+    if ( sckFd_ < 0 ) return -1;
+
+    //*** the ioctls alone take longer than the minimum pulse width ***
+    if ( !setClock( 1 ) ) return -1;
+    int bit = level();
+    if ( !setClock( 0 ) ) return -1;
+
+    return bit;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioChipHX711Port::level()
+{
+struct gpiohandle_data data;
+
+    if ( dtFd_ < 0 ) return -1;
+
+    memset( &data, 0, sizeof(data) );
+    if ( ioctl( dtFd_, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data ) < 0 ) return -1;
+
+    return data.values[0];
+}
+
+
+//*****************************************************************************
+//***************************** GpioMemHX711Port ******************************
+//*****************************************************************************
+GpioMemHX711Port::GpioMemHX711Port( int dtPin, int sckPin, GpioLine *dtEdges )
+{
+    dtPin_   = dtPin;
+    sckPin_  = sckPin;
+    dtEdges_ = dtEdges;
+    regs_    = nullptr;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+GpioMemHX711Port::~GpioMemHX711Port()
+{
+    if ( regs_ ) munmap( const_cast<quint32*>( regs_ ), GPIO_MAP_SIZE );
+    delete dtEdges_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool GpioMemHX711Port::open()
+{
+    //*** only bank 0 is handled ***
+    if ( dtPin_ < 0 || dtPin_ > 31 || sckPin_ < 0 || sckPin_ > 31 )
+    {
+        qDebug() << "gpiomem needs GPIO 0-31, not" << dtPin_ << "/" << sckPin_;
+        return false;
+    }
+
+    //*** map the GPIO registers - /dev/gpiomem needs no root ***
+    int fd = ::open( "/dev/gpiomem", O_RDWR | O_SYNC | O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        qDebug() << "Error opening /dev/gpiomem :" << strerror( errno );
+        return false;
+    }
+
+    void *map = mmap( nullptr, GPIO_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+
+    if ( map == MAP_FAILED )
+    {
+        qDebug() << "Error mapping /dev/gpiomem :" << strerror( errno );
+        return false;
+    }
+    regs_ = static_cast<volatile quint32*>( map );
+
+    //*** DT input, SCK output starting low ***
+    int dtReg = GPFSEL0 + dtPin_ / 10;
+    int dtShift = ( dtPin_ % 10 ) * 3;
+    regs_[dtReg] = ( regs_[dtReg] & ~( 7u << dtShift ) ) | ( FSEL_INPUT << dtShift );
+
+    regs_[GPCLR0] = 1u << sckPin_;
+    int sckReg = GPFSEL0 + sckPin_ / 10;
+    int sckShift = ( sckPin_ % 10 ) * 3;
+    regs_[sckReg] = ( regs_[sckReg] & ~( 7u << sckShift ) ) | ( FSEL_OUTPUT << sckShift );
+
+    //*** without edges DT is polled ***
+    if ( dtEdges_ && !dtEdges_->open( GpioLine::FALLING_EDGE ) )
+    {
+        qDebug() << "No DT edges, polling GPIO" << dtPin_;
+        delete dtEdges_;
+        dtEdges_ = nullptr;
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioMemHX711Port::waitForReady( int timeoutMsec )
+{
+qint64 deadline = monotonicNsec() + static_cast<qint64>( timeoutMsec ) * 1000000;
+
+    if ( !regs_ ) return -1;
+
+    while ( true )
+    {
+        if ( level() == 0 ) return 1;
+
+        qint64 left = deadline - monotonicNsec();
+        if ( left <= 0 ) return 0;
+
+        //*** edges left over from the last read's data bits wake us early - just look again ***
+        if ( dtEdges_ )
+        {
+            if ( dtEdges_->waitForEdge( static_cast<int>( left / 1000000 ) + 1 ) < 0 ) return -1;
+        }
+        else
+        {
+            QThread::usleep( POLL_USEC );
+        }
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioMemHX711Port::clockBit()
+{
+    if ( !regs_ ) return -1;
+
+    //*** data is valid 0.1 usec after SCK rises ***
+    regs_[GPSET0] = 1u << sckPin_;
+    spinNsec( PULSE_NSEC );
+    int bit = ( regs_[GPLEV0] >> dtPin_ ) & 1;
+
+    regs_[GPCLR0] = 1u << sckPin_;
+    spinNsec( PULSE_NSEC );
+
+    return bit;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int GpioMemHX711Port::level()
+{
+    if ( !regs_ ) return -1;
+
+    return ( regs_[GPLEV0] >> dtPin_ ) & 1;
+}
@@ -0,0 +1,134 @@
+#ifndef HX711PORT_H
+#define HX711PORT_H
+
+#include <QtGlobal>
+#include <QString>
+
+class GpioLine;
+
+//*** how the HX711 pins are driven ***
+typedef enum
+{
+    HX711_PORT_GPIOCHIP = 0,    // gpio character device
+    HX711_PORT_GPIOMEM  = 1,    // memory mapped GPIO registers
+} HX711_Port_Type;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The HX711Port class - the two pins of an HX711.
+ *
+ *  DT (DOUT) is an input that goes low when a conversion is ready, SCK an
+ *  output that shifts the bits out. The driver only talks to the chip
+ *  through this interface so the pin access can be swapped (kernel
+ *  character device, memory mapped registers, simulated chip).
+ */
+//*****************************************************************************
+class HX711Port
+{
+public:
+
+    virtual ~HX711Port() {}
+
+    //*** claim the pins, SCK low - returns true if successful ***
+    virtual bool open() = 0;
+
+    //*** wait for DT to go low - returns 1 when ready, 0 on timeout, -1 on error ***
+    virtual int waitForReady( int timeoutMsec ) = 0;
+
+    //*** one SCK pulse - returns DT after the rising edge (0/1), -1 on error ***
+    virtual int clockBit() = 0;
+
+    //*** current level of DT (0/1), -1 on error ***
+    virtual int level() = 0;
+
+    //*** short name for logs ***
+    virtual QString name() const = 0;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The GpioChipHX711Port class - HX711 pins through the Linux gpio
+ *              character device ( /dev/gpiochipN ). DT edges come from the
+ *              kernel, each SCK change is one ioctl.
+ */
+//*****************************************************************************
+class GpioChipHX711Port : public HX711Port
+{
+public:
+
+    //*** constructor ***
+    GpioChipHX711Port( QString chipPath, int dtLine, int sckLine );
+
+    //*** destructor ***
+    ~GpioChipHX711Port() override;
+
+    bool open() override;
+    int waitForReady( int timeoutMsec ) override;
+    int clockBit() override;
+    int level() override;
+    QString name() const override { return QString( "gpiochip" ); }
+
+private:
+
+    //*** drive SCK - returns false on error ***
+    bool setClock( int level );
+
+    //*** e.g. /dev/gpiochip0 ***
+    QString chipPath_;
+
+    //*** line offsets on the chip (BCM GPIO numbers on the Pi) ***
+    int dtLine_;
+    int sckLine_;
+
+    //*** DT event fd and SCK handle fd returned by the kernel ***
+    int dtFd_;
+    int sckFd_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The GpioMemHX711Port class - HX711 pins through the BCM283x GPIO
+ *              registers mapped from /dev/gpiomem.
+ *
+ *  A pulse is a couple of register writes instead of two system calls, so a
+ *  whole read takes a few microseconds. The registers can't wait for an edge,
+ *  so DT is watched through an optional GpioLine, otherwise polled.
+ *  Both pins must be in bank 0 (GPIO 0-31).
+ */
+//*****************************************************************************
+class GpioMemHX711Port : public HX711Port
+{
+public:
+
+    //*** constructor - takes ownership of the DT edge line ***
+    GpioMemHX711Port( int dtPin, int sckPin, GpioLine *dtEdges = nullptr );
+
+    //*** destructor ***
+    ~GpioMemHX711Port() override;
+
+    bool open() override;
+    int waitForReady( int timeoutMsec ) override;
+    int clockBit() override;
+    int level() override;
+    QString name() const override { return QString( "gpiomem" ); }
+
+private:
+
+    //*** GPIO pins ***
+    int dtPin_;
+    int sckPin_;
+
+    //*** falling edges on DT, nullptr to poll ***
+    GpioLine *dtEdges_;
+
+    //*** mapped register block ***
+    volatile quint32 *regs_;
+};
+
+#endif // HX711PORT_H
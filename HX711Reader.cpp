@@ -0,0 +1,74 @@
+#include "HX711Reader.h"
+#include "HX711.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <QDebug>
+
+//*** longest expected time between conversions (10 SPS) - counted as a timeout if exceeded ***
+const int READY_TIMEOUT_MSEC = 250;
+
+
+//*****************************************************************************
+//*****************************************************************************
+HX711Reader::HX711Reader( HX711 *scale, int rtPriority, QObject *parent )
+    : QThread( parent )
+{
+    scale_      = scale;
+    rtPriority_ = rtPriority;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void HX711Reader::stop()
+{
+    //*** ask the loop to exit and wait for it ***
+    requestInterruption();
+    wait();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool HX711Reader::setRealTime()
+{
+struct sched_param param;
+
+    if ( rtPriority_ <= 0 ) return false;
+
+    memset( &param, 0, sizeof(param) );
+    param.sched_priority = qBound( sched_get_priority_min( SCHED_FIFO ), rtPriority_,
+                                   sched_get_priority_max( SCHED_FIFO ) );
+
+    //*** needs CAP_SYS_NICE or an rtprio limit - carry on without it ***
+    int rc = pthread_setschedparam( pthread_self(), SCHED_FIFO, &param );
+    if ( rc != 0 )
+    {
+        qDebug() << "HX711 reader staying at normal priority:" << strerror( rc );
+        return false;
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void HX711Reader::run()
+{
+    setRealTime();
+
+    //*** nothing to read if the pins couldn't be opened ***
+    if ( !scale_->bringUp() ) return;
+
+    //*** keep reading until told to stop ***
+    while ( !isInterruptionRequested() )
+    {
+        if ( !scale_->readNext( READY_TIMEOUT_MSEC ) )
+        {
+            qDebug() << "HX711 pins failed, reader stopping";
+            break;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef HX711READER_H
+#define HX711READER_H
+
+#include <QThread>
+
+class HX711;
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The HX711Reader class - acquisition thread for the HX711.
+ *
+ *  A read is 25-27 SCK pulses, and holding SCK high for 60 usec powers the
+ *  chip down, so the thread asks for real-time (SCHED_FIFO) priority before
+ *  opening the pins. It then sleeps until DT falls and clocks each
+ *  conversion out. Reads that are still disturbed are counted by the scale.
+ */
+//*****************************************************************************
+class HX711Reader : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor ***
+    HX711Reader( HX711 *scale, int rtPriority, QObject *parent = nullptr );
+
+    //*** stop the thread and wait for it to finish ***
+    void stop();
+
+protected:
+
+    //*** thread main loop ***
+    void run() override;
+
+private:
+
+    //*** raise this thread to SCHED_FIFO - returns true if successful ***
+    bool setRealTime();
+
+    //*** scale being read ***
+    HX711 *scale_;
+
+    //*** SCHED_FIFO priority, 0 to stay at normal priority ***
+    int rtPriority_;
+};
+
+#endif // HX711READER_H
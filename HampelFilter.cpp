@@ -0,0 +1,110 @@
+#include "HampelFilter.h"
+#include <algorithm>
+#include <cmath>
+
+//*** scales a MAD to a standard deviation for normally distributed noise ***
+const double MAD_TO_SIGMA = 1.4826;
+
+//*** fewest samples before anything is called an outlier ***
+const int MIN_HISTORY = 3;
+
+
+//*****************************************************************************
+//*****************************************************************************
+HampelFilter::HampelFilter( int window, double k, qint32 minDeviation )
+    : median_( window )
+{
+    k_ = k;
+    minDeviation_ = minDeviation;
+    outliers_ = 0;
+
+    samples_.resize( median_.window() );
+    deviations_.resize( median_.window() );
+    next_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void HampelFilter::setWindow( int window )
+{
+    median_.setWindow( window );
+
+    samples_.resize( median_.window() );
+    deviations_.resize( median_.window() );
+    next_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void HampelFilter::setThreshold( double k, qint32 minDeviation )
+{
+    k_ = k;
+    minDeviation_ = minDeviation;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void HampelFilter::reset()
+{
+    median_.clear();
+    next_ = 0;
+    outliers_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint32 HampelFilter::filter( qint32 sample )
+{
+double median;
+double dev;
+double mad;
+double threshold;
+
+    median_.add( sample );
+    median = median_.median();
+
+    //*** slots fill from 0, so the first count() of them are the window ***
+    samples_[ next_ ] = sample;
+    next_ = ( next_ + 1 ) % samples_.size();
+
+    //*** not enough history to judge yet ***
+    int count = median_.count();
+    if ( count < MIN_HISTORY ) return sample;
+
+    //*** MAD - median of every sample's distance from the current median ***
+    double *devs = deviations_.data();
+    for ( int i=0; i<count; i++ )
+    {
+        devs[i] = std::fabs( static_cast<double>( samples_[i] ) - median );
+    }
+
+    int mid = count / 2;
+    std::nth_element( devs, devs + mid, devs + count );
+    mad = devs[mid];
+    if ( count % 2 == 0 ) mad = ( mad + *std::max_element( devs, devs + mid ) ) / 2.0;
+
+    //*** allowed deviation ***
+    dev = std::fabs( static_cast<double>(sample) - median );
+    threshold = qMax( k_ * MAD_TO_SIGMA * mad, static_cast<double>(minDeviation_) );
+
+    if ( dev <= threshold ) return sample;
+
+    //*** outlier - replace with the median ***
+    outliers_++;
+    return static_cast<qint32>( std::floor( median + 0.5 ) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int HampelFilter::windowForRate( int samplesPerSecond )
+{
+    //*** about 1/8 second of samples, odd so the median is a real sample ***
+    int window = qMax( 5, samplesPerSecond / 8 );
+
+    return window | 1;
+}
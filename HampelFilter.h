@@ -0,0 +1,72 @@
+#ifndef HAMPELFILTER_H
+#define HAMPELFILTER_H
+
+#include "SlidingMedian.h"
+#include <QVector>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The HampelFilter class - streaming outlier rejection.
+ *
+ *  Each new sample is compared with the median of the last N samples. The
+ *  spread is estimated from the median absolute deviation (MAD) of those
+ *  samples from that same median, worked out again for every sample so it
+ *  follows a step as soon as the median does. A sample further than
+ *  k * 1.4826 * MAD from the median is replaced by the median.
+ *
+ *  The median is kept in O(log N); the MAD is an O(N) selection over the
+ *  window, in storage allocated by setWindow().
+ *
+ *  On a perfectly quiet signal the MAD drops to zero and every bit of noise
+ *  would look like an outlier, so the threshold never goes below a minimum
+ *  deviation given in raw counts.
+ *
+ *  A step change in load is passed through once half the window has seen it.
+ */
+//*****************************************************************************
+class HampelFilter
+{
+public:
+
+    //*** constructor ***
+    HampelFilter( int window = 5, double k = 3.0, qint32 minDeviation = 0 );
+
+    //*** change the window size - clears the history ***
+    void setWindow( int window );
+    int window() const { return median_.window(); }
+
+    //*** threshold in MADs and lowest threshold in raw counts ***
+    void setThreshold( double k, qint32 minDeviation );
+
+    //*** filter one sample - returns it, or the median if it is an outlier ***
+    qint32 filter( qint32 sample );
+
+    //*** number of samples replaced since the last reset ***
+    quint64 outliers() const { return outliers_; }
+
+    //*** forget the history ***
+    void reset();
+
+    //*** window size to use for a given sample rate ***
+    static int windowForRate( int samplesPerSecond );
+
+private:
+
+    //*** median of recent samples ***
+    SlidingMedian median_;
+
+    //*** the same samples, oldest overwritten first, and room to work out their MAD ***
+    QVector<qint32> samples_;
+    QVector<double> deviations_;
+    int next_;
+
+    //*** threshold ***
+    double k_;
+    qint32 minDeviation_;
+
+    //*** count of rejected samples ***
+    quint64 outliers_;
+};
+
+#endif // HAMPELFILTER_H
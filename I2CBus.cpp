@@ -0,0 +1,168 @@
+#include "I2CBus.h"
+#include <wiringPiI2C.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <QDebug>
+
+//*** most register blocks in one combined transaction ***
+const int MAX_BLOCKS = 8;
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool I2CBus::readBlocks( t_RegRead *reads, int numReads )
+{
+    //*** one register read per byte ***
+    for ( int i=0; i<numReads; i++ )
+    {
+        for ( int j=0; j<reads[i].len; j++ )
+        {
+            int value = readReg8( static_cast<quint8>( reads[i].reg + j ) );
+            if ( value < 0 ) return false;
+
+            reads[i].data[j] = static_cast<quint8>( value );
+        }
+    }
+
+    return true;
+}
+
+
+
+//*****************************************************************************
+//*****************************************************************************
+WiringPiI2CBus::WiringPiI2CBus( int address )
+{
+    address_ = address;
+    fd_      = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool WiringPiI2CBus::open()
+{
+    //*** open i2c device ***
+    fd_ = wiringPiI2CSetup( address_ );
+
+    return ( fd_ >= 0 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int WiringPiI2CBus::readReg8( quint8 reg )
+{
+    return wiringPiI2CReadReg8( fd_, reg );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool WiringPiI2CBus::writeReg8( quint8 reg, quint8 value )
+{
+    return ( wiringPiI2CWriteReg8( fd_, reg, value ) == 0 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+I2CDevBus::I2CDevBus( int busNum, int address )
+{
+    devPath_ = QString( "/dev/i2c-%1" ).arg( busNum );
+    address_ = address;
+    fd_      = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+I2CDevBus::~I2CDevBus()
+{
+    if ( fd_ >= 0 ) ::close( fd_ );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool I2CDevBus::open()
+{
+    fd_ = ::open( qPrintable(devPath_), O_RDWR | O_CLOEXEC );
+    if ( fd_ < 0 )
+    {
+        qDebug() << "Error opening" << devPath_;
+        return false;
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int I2CDevBus::readReg8( quint8 reg )
+{
+quint8 value = 0;
+t_RegRead read = { reg, &value, 1 };
+
+    if ( !readBlocks( &read, 1 ) ) return -1;
+
+    return value;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool I2CDevBus::writeReg8( quint8 reg, quint8 value )
+{
+quint8 buf[2] = { reg, value };
+struct i2c_msg msg;
+struct i2c_rdwr_ioctl_data xfer;
+
+    //*** register address followed by value ***
+    msg.addr  = static_cast<__u16>( address_ );
+    msg.flags = 0;
+    msg.len   = sizeof(buf);
+    msg.buf   = buf;
+
+    xfer.msgs  = &msg;
+    xfer.nmsgs = 1;
+
+    return ( ioctl( fd_, I2C_RDWR, &xfer ) == 1 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool I2CDevBus::readBlocks( t_RegRead *reads, int numReads )
+{
+struct i2c_msg msgs[ MAX_BLOCKS * 2 ];
+quint8 regs[ MAX_BLOCKS ];
+struct i2c_rdwr_ioctl_data xfer;
+
+    if ( numReads > MAX_BLOCKS ) return I2CBus::readBlocks( reads, numReads );
+
+    //*** each block is a register address write followed by a repeated start read ***
+    for ( int i=0; i<numReads; i++ )
+    {
+        regs[i] = reads[i].reg;
+
+        msgs[2*i].addr  = static_cast<__u16>( address_ );
+        msgs[2*i].flags = 0;
+        msgs[2*i].len   = 1;
+        msgs[2*i].buf   = &regs[i];
+
+        msgs[2*i+1].addr  = static_cast<__u16>( address_ );
+        msgs[2*i+1].flags = I2C_M_RD;
+        msgs[2*i+1].len   = static_cast<__u16>( reads[i].len );
+        msgs[2*i+1].buf   = reads[i].data;
+    }
+
+    xfer.msgs  = msgs;
+    xfer.nmsgs = static_cast<__u32>( numReads * 2 );
+
+    return ( ioctl( fd_, I2C_RDWR, &xfer ) == numReads * 2 );
+}
@@ -0,0 +1,113 @@
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include <QtGlobal>
+#include <QString>
+
+//*** one block of consecutive registers to read ***
+typedef struct
+{
+    quint8  reg;    // first register
+    quint8 *data;   // where to put the values
+    int     len;    // number of registers
+} t_RegRead;
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The I2CBus class - register level access to a single I2C device.
+ *
+ *  The scale drivers talk to their chip only through this interface so the
+ *  transport can be swapped (wiringPi, stand-in for testing, ...).
+ */
+//*****************************************************************************
+class I2CBus
+{
+public:
+
+    virtual ~I2CBus() {}
+
+    //*** open the device - returns true if successful ***
+    virtual bool open() = 0;
+
+    //*** read an 8 bit register - returns -1 on error ***
+    virtual int readReg8( quint8 reg ) = 0;
+
+    //*** write an 8 bit register - returns true if successful ***
+    virtual bool writeReg8( quint8 reg, quint8 value ) = 0;
+
+    //*** read several register blocks - returns true if successful ***
+    //*** default is one register at a time ***
+    virtual bool readBlocks( t_RegRead *reads, int numReads );
+
+    //*** true if readBlocks() is a single bus transaction ***
+    virtual bool combinedTransfers() const { return false; }
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The WiringPiI2CBus class - I2C access through the wiringPi library
+ */
+//*****************************************************************************
+class WiringPiI2CBus : public I2CBus
+{
+public:
+
+    //*** constructor ***
+    explicit WiringPiI2CBus( int address );
+
+    bool open() override;
+    int readReg8( quint8 reg ) override;
+    bool writeReg8( quint8 reg, quint8 value ) override;
+
+private:
+
+    //*** 7 bit device address ***
+    int address_;
+
+    //*** wiringPi fd ***
+    int fd_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The I2CDevBus class - I2C access directly through Linux i2c-dev.
+ *
+ *  readBlocks() issues all the register reads as one I2C_RDWR combined
+ *  transaction (repeated starts), so a multi byte result is read atomically
+ *  and costs a single bus round trip.
+ */
+//*****************************************************************************
+class I2CDevBus : public I2CBus
+{
+public:
+
+    //*** constructor ***
+    I2CDevBus( int busNum, int address );
+
+    //*** destructor ***
+    ~I2CDevBus() override;
+
+    bool open() override;
+    int readReg8( quint8 reg ) override;
+    bool writeReg8( quint8 reg, quint8 value ) override;
+    bool readBlocks( t_RegRead *reads, int numReads ) override;
+    bool combinedTransfers() const override { return true; }
+
+private:
+
+    //*** /dev/i2c-N ***
+    QString devPath_;
+
+    //*** 7 bit device address ***
+    int address_;
+
+    //*** device fd ***
+    int fd_;
+};
+
+#endif // I2CBUS_H
@@ -3,15 +3,20 @@
 
 #include "KeyPad.h"
 #include "NameListDlg.h"
+#include "ScaleRegistry.h"
 
 #include <stdlib.h>
 #include <QDate>
-#include <QTcpSocket>
 #include <QSettings>
 #include <QGuiApplication>
 #include <QScreen>
 #include <QThread>
 #include <QScrollBar>
+#include <QMap>
+#include <QSet>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
 
 //*** page constants ***
 const int CONNECT_PAGE   = 0;
@@ -22,21 +27,30 @@ const int SHUTDOWN_PAGE  = 4;
 
 const quint16 SCALE_PORT = 29456;
 
-const int WEIGHT_TIMER_MSEC = 250;
-
 const QString ORG_NAME = "FoodPantry";
 const QString APP_NAME = "FoodPantry";
 
-const QString TARE_STR  = "TARE";
-const QString SCALE_STR = "SCALE";
 const QString CALWT_STR = "CALWT";
+const QString AUTO_STR  = "AUTO_CAPTURE";
+const QString SIM_STATIONS_STR = "SIM_STATIONS";
+const QString STABLE_SD_STR    = "STABLE_STDDEV";
+const QString STABLE_SLOPE_STR = "STABLE_SLOPE";
+const QString STABLE_DWELL_STR = "STABLE_DWELL_MSEC";
+const QString CAPTURE_DIR_STR  = "CAPTURE_DIR";
+const QString JOURNAL_STR      = "REPORT_JOURNAL";
 
-const int    DEFAULT_TARE  = -214054;
-const double DEFAULT_SCALE = 0.0000913017;
 const float  DEFAULT_CALWT = 10.0;
 
 const float  MIN_VALID_WEIGHT = 0.5;
 
+//*** journaled weight reports - per frame, resent if not acked in time, metrics logged this often ***
+const int REPORT_BATCH       = 64;
+const int REPORT_RETRY_MSEC  = 15000;
+const int REPORT_CHECK_MSEC  = 5000;
+
+//*** a settled load must differ by this much to be auto captured ***
+const float  MIN_CAPTURE_CHANGE = 0.2f;
+
 const QString CAL_STR_1 = "Empty Scale\nClick Continue";
 const QString CAL_STR_2 = "Add %.1f lbs to scale\nClick Continue";
 
@@ -62,9 +76,22 @@ MainWindow::MainWindow( QWidget *parent ) :
 
     //*** initialize vars ***
     connected_  = false;
-    svr_        = nullptr;
-    client_     = nullptr;
+    connections_ = nullptr;
+    liveTimer_   = nullptr;
+    journal_     = nullptr;
+    reportTimer_ = nullptr;
+    rosterSeq_  = 0;
+    rosterChanged_  = false;
+    rosterAck_      = false;
+    rosterAckFlags_ = 0;
     curCalMode_ = NOCAL_MODE;
+    scales_     = nullptr;
+    curStation_ = 0;
+    curWeight_  = 0.0;
+    haveWeight_ = false;
+    calRequest_  = 0;
+    tareRequest_ = 0;
+    tareStation_ = 0;
 
     //*** button colors ***
     setStyleSheet(  "QPushButton { background-color: blue; color: white; border: off; } "
@@ -102,6 +129,9 @@ MainWindow::MainWindow( QWidget *parent ) :
     connect( ui->changeCalBtn, SIGNAL(clicked() ), SLOT(handleChangeCalWeight()) );
     connect( ui->restoreNameBtn, SIGNAL(clicked()), SLOT(handleRestoreNameBtn()) );
 
+    //*** only the visible page's weight is kept up to date - catch up when it changes ***
+    connect( ui->widgetStack, SIGNAL(currentChanged(int)), SLOT(displayWeight()) );
+
     //*** first page displayed ***
     ui->widgetStack->setCurrentIndex( CONNECT_PAGE );
 
@@ -111,20 +141,16 @@ MainWindow::MainWindow( QWidget *parent ) :
 
     //*** load the settings ***
     loadSettings();
+    ui->autoCaptureBtn->setChecked( autoCapture_ );
 
-    //*** set up the scale ***
+    //*** set up the scale - comes up in the background ***
     setupScale();
 
-    //*** weight timer ***
-    weightTimer_ = new QTimer( this );
-    weightTimer_->setInterval( WEIGHT_TIMER_MSEC );
-    connect( weightTimer_, SIGNAL(timeout()), SLOT(requestWeight()) );
-    QTimer::singleShot( 2000, weightTimer_, SLOT(start()) );
-
     //*** TODO - Remove after testing phase ***
     initFakeData();
 
-    //*** set up the TCP server ***
+    //*** reports still to send from last time, then the TCP server ***
+    setupJournal();
     setupServer();
 
     //*** clear all weight displays ***
@@ -167,14 +193,14 @@ MainWindow::~MainWindow()
 
     delete ui;
 
-    //*** scale object ***
-    if ( nau7802_ ) delete nau7802_;
+    //*** scale stations ***
+    if ( scales_ ) delete scales_;
 
-    //*** TCP server ***
-    if ( svr_ ) delete svr_;
+    //*** TCP server and its connections ***
+    if ( connections_ ) delete connections_;
 
-    //*** weight timer ***
-    if ( weightTimer_ ) delete weightTimer_;
+    //*** report journal - synced as it closes ***
+    if ( journal_ ) delete journal_;
 }
 
 
@@ -250,12 +276,10 @@ void MainWindow::handleCalibrate()
 
     //*** display the first user prompt (empty scale) ***
     ui->calibrateLbl->setText( CAL_STR_1 );
+    ui->calibrateProgress->hide();
 
     //*** enter the TARE state ***
     curCalMode_ = CAL_TARE_MODE;
-
-    //*** no weight updates while we are doing this ***
-    weightTimer_->stop();
 }
 
 
@@ -263,22 +287,93 @@ void MainWindow::handleCalibrate()
 //*****************************************************************************
 /**
  * @brief MainWindow::handleCalibrateContinue - called when the 'continue' button
- *              is clicked during the calibration process. Handles the current
- *              phase.
+ *              is clicked during the calibration process. Starts collecting
+ *              the samples for the current phase.
  */
 //*****************************************************************************
 void MainWindow::handleCalibrateContinue()
 {
-QList<int> data;
+    //*** ignore if not in calibration mode or already collecting ***
+    if ( curCalMode_ == NOCAL_MODE || calRequest_ != 0 ) return;
+
+    //*** only samples taken from now on - the scale has just been cleared / loaded ***
+    calRequest_ = curScale()->requestFreshSamples( NUM_CAL_SAMPLES );
+
+    //*** show the samples coming in ***
+    ui->continueBtn->setEnabled( false );
+    ui->calibrateProgress->setRange( 0, NUM_CAL_SAMPLES );
+    ui->calibrateProgress->setValue( 0 );
+    ui->calibrateProgress->show();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleFreshSamplesProgress - called as requested samples
+ *              arrive
+ * @param index - the station
+ * @param id - the request
+ * @param collected - samples so far
+ * @param needed - samples requested
+ */
+//*****************************************************************************
+void MainWindow::handleFreshSamplesProgress( int index, int id, int collected, int needed )
+{
+    //*** only calibration shows progress ***
+    if ( index != curStation_ || id != calRequest_ ) return;
+
+    ui->calibrateProgress->setRange( 0, needed );
+    ui->calibrateProgress->setValue( collected );
+}
 
-    //*** ignore if not in calibration mode ***
-    if ( curCalMode_ == NOCAL_MODE ) return;
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleFreshSamplesReady - called when requested samples
+ *              have all arrived. Finishes the tare or calibration phase.
+ * @param index - the station
+ * @param samples - averages of the samples
+ */
+//*****************************************************************************
+void MainWindow::handleFreshSamplesReady( int index, t_FreshSamples samples )
+{
+ScaleDriver *scale = scales_->scale( index );
+
+    //*** tare ***
+    if ( index == tareStation_ && samples.id == tareRequest_ )
+    {
+        tareRequest_ = 0;
+
+        //*** set the new tare value in the scale object ***
+        scale->setTare( static_cast<int>( samples.mean[SCALE_CHANNEL_1] ) );
+
+        //*** second load cell ***
+        if ( scale->isDualChannel() )
+        {
+            scale->setTare( static_cast<int>( samples.mean[SCALE_CHANNEL_2] ), SCALE_CHANNEL_2 );
+        }
+
+        //*** save current value ***
+        scales_->updateCalibration( index );
+        saveSettings();
+        return;
+    }
+
+    //*** calibration phase ***
+    if ( index != curStation_ || samples.id != calRequest_ ) return;
+
+    calRequest_ = 0;
+    ui->calibrateProgress->hide();
+    ui->continueBtn->setEnabled( true );
 
     //*** handle TARE mode ***
     if ( curCalMode_ == CAL_TARE_MODE )
     {
-        //*** get tare raw value ***
-        calTareVal_ = nau7802_->getRawAvg( NUM_CAL_SAMPLES );
+        //*** tare raw values ***
+        calTareVal_  = static_cast<int>( samples.mean[SCALE_CHANNEL_1] );
+        calTareVal2_ = static_cast<int>( samples.mean[SCALE_CHANNEL_2] );
 
         //*** create and display next user prompt (add weight to scale) ***
         QString buf;
@@ -292,22 +387,33 @@ QList<int> data;
     //*** handle CAL WEIGHT mode ***
     else if ( curCalMode_ == CAL_WEIGHT_MODE )
     {
-        //*** get average raw value for the weight ***
-        calWeightVal_ = nau7802_->getRawAvg( NUM_CAL_SAMPLES );
+        //*** average raw value for the weight ***
+        calWeightVal_ = static_cast<int>( samples.mean[SCALE_CHANNEL_1] );
+
+        //*** two matched load cells - one scale factor for the sum of both ***
+        if ( scale->isDualChannel() )
+        {
+            int calWeightVal2 = static_cast<int>( samples.mean[SCALE_CHANNEL_2] );
+            double counts = static_cast<double>( calWeightVal_ - calTareVal_ ) + ( calWeightVal2 - calTareVal2_ );
+            double factor = static_cast<double>( calWeight_ ) / counts;
+
+            scale->setCalibration( SCALE_CHANNEL_1, calTareVal_, factor );
+            scale->setCalibration( SCALE_CHANNEL_2, calTareVal2_, factor );
+        }
 
         //*** set new calibration data ***
-        nau7802_->setCalibrationData( calTareVal_, calWeightVal_, calWeight_ );
+        else
+        {
+            scale->setCalibrationData( calTareVal_, calWeightVal_, calWeight_ );
+        }
 
-        //*** get and save new calculated values ***
-        nau7802_->getCalibrationData( tare_, scale_ );
+        //*** save new calculated values in the station's profile ***
+        scales_->updateCalibration( index );
         saveSettings();
 
         //*** exit calibration mode ***
         curCalMode_ = NOCAL_MODE;
 
-        //*** resume weight readings ***
-        weightTimer_->start();
-
         //*** exit appropriately ***
         handleCancelCalibrate();
     }
@@ -326,6 +432,12 @@ void MainWindow::handleCancelCalibrate()
     //*** ensure we are out of calibration mode ***
     curCalMode_ = NOCAL_MODE;
 
+    //*** stop collecting samples ***
+    if ( calRequest_ != 0 ) curScale()->cancelFreshSamples( calRequest_ );
+    calRequest_ = 0;
+    ui->calibrateProgress->hide();
+    ui->continueBtn->setEnabled( true );
+
     //*** if we are connected to checkin client ***
     if ( connected_ )
     {
@@ -375,12 +487,12 @@ void MainWindow::handleNameSelected( QListWidgetItem *item )
     curName_ = name;
 
     //*** display name at top of page along with # items ***
-    QString txt = QString( "%1 ( %2 )" ).arg(name).arg(clients_[name].numItems);
-    ui->nameLbl->setText( txt );
+    displayName();
 
     //*** clear the weights ***
     ui->weightList->clear();
     weights_.clear();
+    weightStations_.clear();
 
     //*** default to BASKET tare ***
     ui->basketBtn->setChecked( true );
@@ -400,8 +512,68 @@ void MainWindow::handleNameSelected( QListWidgetItem *item )
 void MainWindow::handleWeigh()
 {
     //*** read the scale ***
-    float weight = nau7802_->getWeight();
+    addWeight( curScale()->getWeight() );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleStableWeight - called when a load on one of the
+ *              scales has settled. In auto capture mode a new load is added
+ *              to the list without waiting for the 'weigh' button.
+ * @param index - station the load is on
+ * @param weight - settled weight
+ * @param settleMsec - time from the load starting to move until it settled
+ */
+//*****************************************************************************
+void MainWindow::handleStableWeight( int index, float weight, int settleMsec )
+{
+float lastStable = lastStable_[index];
+
+    qDebug() << "Station" << scales_->stationId( index ) << "stable weight" << weight
+             << "after" << settleMsec << "msec";
+
+    //*** remember what is on the scale now, captured or not ***
+    lastStable_[index] = weight;
+
+    //*** only when weighing with auto capture on ***
+    if ( ui->widgetStack->currentIndex() != WEIGH_PAGE || !ui->autoCaptureBtn->isChecked() ) return;
+
+    //*** same load settling again ***
+    if ( qAbs( weight - lastStable ) < MIN_CAPTURE_CHANGE ) return;
 
+    //*** nothing (or just the basket) on the scale ***
+    float net = ui->basketBtn->isChecked() ? weight - BASKET_TARE : weight;
+    if ( net < MIN_VALID_WEIGHT ) return;
+
+    //*** the station being used becomes the current one ***
+    if ( index != curStation_ )
+    {
+        cancelTare();
+        curStation_ = index;
+        displayName();
+
+        //*** its weight, until it next changes ***
+        curWeight_  = curScale()->getWeight();
+        haveWeight_ = true;
+        displayWeight();
+    }
+
+    addWeight( weight );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::addWeight - adds a weight to the list for the current
+ *              person, less the basket if one is used
+ * @param weight - weight read from the scale
+ */
+//*****************************************************************************
+void MainWindow::addWeight( float weight )
+{
     //*** factor in basket? ***
     if ( ui->basketBtn->isChecked() )
     {
@@ -416,15 +588,12 @@ void MainWindow::handleWeigh()
     }
 
     //*** format weight ***
-    QString wLine;
-    wLine.sprintf( "%.1f", weight );
-
-    //*** no negative 0 weights ***
-    if ( wLine == "-0.0" ) wLine = "0.0";
+    QString wLine = ScaleDriver::formatWeight( weight );
 
     //*** add to the list of weights ***
     ui->weightList->addItem( wLine );
     weights_.append( weight );
+    weightStations_.append( curStation_ );
 }
 
 
@@ -443,6 +612,7 @@ void MainWindow::handleClearLast()
         //*** delete the last row fro both the control and the list ***
         delete ui->weightList->takeItem( ui->weightList->count()-1 );
         weights_.takeLast();
+        weightStations_.takeLast();
     }
 }
 
@@ -457,8 +627,9 @@ void MainWindow::handleClearLast()
 //*****************************************************************************
 void MainWindow::handleDone()
 {
-float totalWeight = 0.0;    // accumulator
-t_WeightReport wr;          // message struct
+float totalWeight = 0.0;        // accumulator
+QMap<int,float> stationWeight;  // total for each station used
+QMap<int,float> reportWeight;   // the same by station id - one report each
 
     //*** return to the name list display ***
     ui->widgetStack->setCurrentIndex( NAME_PAGE );
@@ -474,26 +645,29 @@ t_WeightReport wr;          // message struct
     }
 
     //*** total the weight values ***
-    foreach( float w, weights_ )
+    for ( int i=0; i<weights_.size(); i++ )
     {
-        totalWeight += w;
+        totalWeight += weights_[i];
+        stationWeight[ weightStations_[i] ] += weights_[i];
     }
 
-    //*** can we send message back to client? ( must have a valid weight ) ***
-    if ( connected_ && client_ && (totalWeight > MIN_VALID_WEIGHT) )
+    //*** report it to the clients ( must have a valid weight ) ***
+    if ( totalWeight > MIN_VALID_WEIGHT )
     {
-        //*** send weight report ***
-        memset( &wr, 0, WEIGHT_REPORT_SIZE );
-        wr.magic = MAGIC_VAL;
-        wr.size = WEIGHT_SIZE_FIELD;
-        wr.type = WEIGHT_REPORT_TYPE;
+        //*** weight of each station used, by station id ***
+        foreach( int index, stationWeight.keys() )
+        {
+            int station = ( scales_->count() > 1 ) ? scales_->stationId( index ) : 0;
+            reportWeight[station] += stationWeight[index];
+        }
 
-        wr.key = clients_[curName_].key;
-        wr.weight = totalWeight;
-        wr.day = clients_[curName_].day;
+        //*** journaled first - kept until fpSvr acks it, even if nobody is connected ***
+        foreach( int station, reportWeight.keys() )
+        {
+            journal_->add( clients_[curName_].key, reportWeight[station], clients_[curName_].day, station );
+        }
 
-        //*** write it to client socket ***
-        client_->write( (char*)&wr, WEIGHT_REPORT_SIZE );
+        sendReports();
     }
 }
 
@@ -501,91 +675,240 @@ t_WeightReport wr;          // message struct
 //*****************************************************************************
 //*****************************************************************************
 /**
- * @brief MainWindow::handleNewConnection - called when a new client connection
- *              is made to the TCP server.
+ * @brief MainWindow::handleConnectedChanged - called when the first client
+ *              playing fpSvr's part is up or the last one is gone. Monitors,
+ *              and other fpSvrs coming and going in between, don't change the
+ *              display.
+ * @param connected - fpSvr is connected
  */
 //*****************************************************************************
-void MainWindow::handleNewConnection()
+void MainWindow::handleConnectedChanged( bool connected )
 {
-    //*** get pending connection ***
-    client_ = svr_->nextPendingConnection();
+    //*** handle connection in UI ***
+    if ( connected )
+    {
+        handleConnect();
+    }
+    else
+    {
+        handleDisconnect();
+    }
+}
 
-    //*** delete on disconnect ***
-    connect( client_, &QAbstractSocket::disconnected, this, &MainWindow::handleDisconnect);
-    connect( client_, &QAbstractSocket::disconnected, client_, &QObject::deleteLater);
 
-    //*** set up to receive data (and errors) ***
-    connect( client_, &QAbstractSocket::readyRead, this, &MainWindow::clientDataReady );
-    connect( client_, SIGNAL(error(QAbstractSocket::SocketError)),
-                      SLOT(displayError( QAbstractSocket::SocketError )) );
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleCheckInFrame - called for each frame of check-ins
+ *              a client sends. Called directly, the records are only good
+ *              until this returns.
+ * @param id - connection it came from
+ * @param frame - the frame
+ * @param reader - hands out the frame's check-ins
+ */
+//*****************************************************************************
+void MainWindow::handleCheckInFrame( int id, const t_FrameInfo &frame, ProtocolReader *reader )
+{
+Q_UNUSED( id )
+t_CheckInView view;     // check-in, still in the receive buffer
 
-    //*** handle connection in UI ***
-    handleConnect();
+    //*** the whole roster - replaces what we had ***
+    if ( frame.type == FRAME_SNAPSHOT )
+    {
+        applyRosterSnapshot( reader, frame.count );
+        rosterSeq_ = frame.seq;
+        rosterAckFlags_ = 0;
+        rosterAck_ = true;
+    }
+
+    //*** changes - only if they follow on from what we have ***
+    else if ( frame.type == FRAME_DELTA )
+    {
+        rosterAck_ = true;
+        if ( frame.baseSeq != rosterSeq_ )
+        {
+            rosterAckFlags_ |= ROSTER_ACK_RESYNC;
+            return;
+        }
+
+        while ( reader->nextCheckIn( view ) )
+        {
+            applyCheckIn( view );
+        }
+        rosterSeq_ = frame.seq;
+    }
+
+    //*** plain check-ins, not part of the roster sequence ***
+    else
+    {
+        while ( reader->nextCheckIn( view ) )
+        {
+            applyCheckIn( view );
+        }
+    }
+
+    rosterChanged_ = true;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
 /**
- * @brief MainWindow::clientDataReady - called when data is available on the
- *              client socket.
+ * @brief MainWindow::handleFramesDone - called once all the frames of a read
+ *              have been handled. The name list is redisplayed and the roster
+ *              acked once, however many frames there were.
+ * @param id - connection they came from
  */
 //*****************************************************************************
-void MainWindow::clientDataReady()
+void MainWindow::handleFramesDone( int id )
+{
+    //*** one redisplay for everything received ***
+    if ( rosterChanged_ )
+    {
+        refreshNameList();
+    }
+
+    //*** one ack for everything received ***
+    if ( rosterAck_ )
+    {
+        sendRosterAck( id, rosterAckFlags_ );
+    }
+
+    rosterChanged_  = false;
+    rosterAck_      = false;
+    rosterAckFlags_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::applyCheckIn - adds or removes a person from the roster.
+ *              The name list display is left for the caller to refresh.
+ * @param view - check-in received from fpSvr
+ */
+//*****************************************************************************
+void MainWindow::applyCheckIn( const t_CheckInView &view )
 {
 t_CheckIn ci;   // checkin data struct
 
-    //*** get socket that received data ***
-    QTcpSocket *sock = (QTcpSocket*)sender();
+    //*** grab name ***
+    QString name = ProtocolReader::toCheckIn( view, ci );
 
-    //*** get data ***
-    while ( sock->bytesAvailable() >= CHECKIN_SIZE )
+    //*** if # items > 0, then add to list ***
+    if ( ci.numItems != 0 )
+    {
+        //*** add to map and name list ***
+        addClient( ci, false );
+    }
+
+    //*** if numItems == 0, then remove from list ***
+    else
     {
-        //*** read structs worth of data ***
-        if ( sock->read( (char*)&ci, CHECKIN_SIZE ) == CHECKIN_SIZE )
+        //*** remove all traces ***
+        allNames_.removeAll( name );
+        clients_.remove( name );
+
+        //*** remove from display ***
+        removeFromNameList( name, false );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::applyRosterSnapshot - replaces the roster with the
+ *              check-ins of the current frame. People already known keep
+ *              their place (and stay off the list if they have been weighed),
+ *              new people are added and people not in the snapshot are
+ *              dropped. The name list display is left for the caller.
+ * @param reader - hands out the frame's check-ins
+ * @param count - check-ins in the frame
+ */
+//*****************************************************************************
+void MainWindow::applyRosterSnapshot( ProtocolReader *reader, int count )
+{
+t_CheckInView view;                 // check-in, still in the receive buffer
+t_CheckIn ci;                       // checkin data struct
+QHash<QString,t_CheckIn> roster;    // the new roster
+QStringList arrived;                // names in snapshot order
+QStringList names;                  // new 'all' names list
+QStringList waiting;                // new person list
+QSet<QString> known;                // names kept from the old roster
+
+    //*** collect the snapshot ***
+    roster.reserve( count );
+    while ( reader->nextCheckIn( view ) )
+    {
+        QString name = ProtocolReader::toCheckIn( view, ci );
+        if ( ci.numItems == 0 || name.isEmpty() ) continue;
+
+        if ( !roster.contains( name ) )
+        {
+            arrived.append( name );
+        }
+        roster[name] = ci;
+    }
+
+    //*** the person on the scale stays until done ***
+    if ( !curName_.isEmpty() && !roster.contains( curName_ ) && clients_.contains( curName_ ) )
+    {
+        roster[curName_] = clients_[curName_];
+    }
+
+    //*** keep the people still checked in, in their current order ***
+    foreach( QString n, allNames_ )
+    {
+        if ( roster.contains( n ) )
+        {
+            names.append( n );
+            known.insert( n );
+        }
+    }
+    foreach( QString n, nameList_ )
+    {
+        if ( roster.contains( n ) )
         {
-            //*** grab name ***
-            QString name = ci.name;
-
-            //*** if # items > 0, then add to list ***
-            if ( ci.numItems != 0 )
-            {
-                //*** add to map and name list ***
-                addClient( ci );
-            }
-
-            //*** if numItems == 0, then remove from list ***
-            else
-            {
-                //*** remove all traces ***
-                allNames_.removeAll( name );
-                clients_.remove( name );
-
-                //*** remove from display ***
-                removeFromNameList( name );
-            }
+            waiting.append( n );
         }
     }
+
+    //*** then everyone new ***
+    foreach( QString n, arrived )
+    {
+        if ( !known.contains( n ) )
+        {
+            names.append( n );
+            waiting.append( n );
+        }
+    }
+
+    clients_  = roster;
+    allNames_ = names;
+    nameList_ = waiting;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
 /**
- * @brief MainWindow::displayError - called when a TCP error is detected
- * @param socketError - the error that was detected
+ * @brief MainWindow::sendRosterAck - tells a client which roster sequence we
+ *              hold, so a reconnect only needs the changes since then.
+ * @param id - connection to tell
+ * @param flags - ROSTER_ACK_xx
  */
 //*****************************************************************************
-void MainWindow::displayError( QAbstractSocket::SocketError socketError )
+void MainWindow::sendRosterAck( int id, quint32 flags )
 {
-Q_UNUSED( socketError )
+    //*** only framed clients know about the roster ***
+    if ( connections_->mode( id ) != PROTOCOL_FRAMED ) return;
 
-    //*** get socket that received error ***
-    QTcpSocket *sock = static_cast<QTcpSocket*>(sender());
+    FrameWriter frame( FRAME_ROSTER_ACK );
+    frame.addAck( rosterSeq_, flags );
 
-    //*** TODO - report error somehow ***
-
-    qDebug() << "Socket Error: " << sock->errorString();
+    //*** write it to client socket ***
+    connections_->send( id, frame.frame() );
 }
 
 
@@ -597,40 +920,99 @@ Q_UNUSED( socketError )
 //*****************************************************************************
 void MainWindow::handleTare()
 {
-    //*** get the new tare value ***
-    tare_ = nau7802_->getRawAvg( NUM_TARE_SAMPLES );
+    //*** one still waiting may never finish (station stopped) - start over ***
+    cancelTare();
 
-    //*** set it in the scale object ***
-    nau7802_->setTare( tare_ );
+    //*** tare from samples taken after the click - see handleFreshSamplesReady() ***
+    tareStation_ = curStation_;
+    tareRequest_ = curScale()->requestFreshSamples( NUM_TARE_SAMPLES );
+}
 
-    //*** save current value ***
-    saveSettings();
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleWeightChanged - called when a station's weight moves
+ *              by more than the display hysteresis
+ * @param index - the station
+ * @param weight - its new weight
+ */
+//*****************************************************************************
+void MainWindow::handleWeightChanged( int index, float weight )
+{
+    //*** only the current station is on display ***
+    if ( index != curStation_ ) return;
+
+    curWeight_  = weight;
+    haveWeight_ = true;
+
+    displayWeight();
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
 /**
- * @brief MainWindow::requestWeight - called by the weight timer to update the
- *              weight displays
+ * @brief MainWindow::displayWeight - shows the current weight on the visible
+ *              page, if it has a weight display and the text has changed
  */
 //*****************************************************************************
-void MainWindow::requestWeight()
+void MainWindow::displayWeight()
 {
-    //*** read the scale ***
-    float weight = nau7802_->getWeight();
+ClickLabel *label;
 
-    //*** format the weight ***
-    QString wLine;
-    wLine.sprintf( "%.1f", weight );
+    if ( !haveWeight_ ) return;
 
-    //*** no negative 0s ***
-    if ( wLine == "-0.0" ) wLine = "0.0";
+    //*** each page has its own weight display ***
+    switch ( ui->widgetStack->currentIndex() )
+    {
+        case CONNECT_PAGE:  label = ui->weighLbl_1; break;
+        case NAME_PAGE:     label = ui->weighLbl_2; break;
+        case WEIGH_PAGE:    label = ui->weighLbl_3; break;
+        default:            return;
+    }
 
-    //*** update all the weight displays ***
-    ui->weighLbl_1->setText( wLine );
-    ui->weighLbl_2->setText( wLine );
-    ui->weighLbl_3->setText( wLine );
+    //*** repaint only if what it shows changes ***
+    QString wLine = ScaleDriver::formatWeight( curWeight_ );
+    if ( label->text() != wLine ) label->setText( wLine );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleScaleReady - called when a station has finished
+ *              bring-up and samples are arriving
+ * @param index - the station
+ */
+//*****************************************************************************
+void MainWindow::handleScaleReady( int index )
+{
+    //*** weights follow on their own - see handleWeightChanged() ***
+    qDebug() << "Station" << scales_->stationId( index ) << "ready:" << scales_->scale( index )->name();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleScaleFailed - called when a station could not be
+ *              brought up
+ * @param index - the station
+ * @param reason - what went wrong
+ */
+//*****************************************************************************
+void MainWindow::handleScaleFailed( int index, QString reason )
+{
+    qDebug() << "Scale Error: station" << scales_->stationId( index ) << reason;
+
+    //*** only the current station is on display ***
+    if ( index != curStation_ ) return;
+
+    //*** show it where the weight would be ***
+    ui->weighLbl_1->setText( "ERR" );
+    ui->weighLbl_2->setText( "ERR" );
+    ui->weighLbl_3->setText( "ERR" );
 }
 
 
@@ -728,22 +1110,205 @@ void MainWindow::shutdownNow()
 void MainWindow::setupServer()
 {
     //*** don't set up twice ***
-    if ( svr_ ) return;
+    if ( connections_ ) return;
 
     //*** create the server ***
-    svr_ = new QTcpServer( this );
+    connections_ = new ConnectionManager( this );
+
+    //*** check-in records are only good during the call - must be direct ***
+    connect( connections_, &ConnectionManager::connectedChanged, this, &MainWindow::handleConnectedChanged );
+    connect( connections_, &ConnectionManager::checkInFrame, this, &MainWindow::handleCheckInFrame, Qt::DirectConnection );
+    connect( connections_, &ConnectionManager::framesDone, this, &MainWindow::handleFramesDone, Qt::DirectConnection );
+    connect( connections_, &ConnectionManager::identified, this, &MainWindow::handleIdentified );
+    connect( connections_, &ConnectionManager::reportsAcked, this, &MainWindow::handleReportsAcked );
+
+    //*** live weights, at the rate the fastest subscriber wants ***
+    liveTimer_ = new QTimer( this );
+    connect( liveTimer_, &QTimer::timeout, this, &MainWindow::handleLiveTimer );
+    connect( connections_, &ConnectionManager::liveRateChanged, this, &MainWindow::handleLiveRateChanged );
 
     //*** start listening on our port ***
-    if ( !svr_->listen( QHostAddress::Any, SCALE_PORT ) )
+    if ( !connections_->listen( SCALE_PORT ) )
     {
         qDebug() << "Error listening on TCP port!!!";
         ui->connectLbl->setText( "Server Error" );
     }
-    else
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::setupJournal - opens the journal of weight reports that
+ *              fpSvr hasn't acked. Reports left in it from the last run are
+ *              sent once a client connects.
+ */
+//*****************************************************************************
+void MainWindow::setupJournal()
+{
+    //*** don't set up twice ***
+    if ( journal_ ) return;
+
+    journal_ = new ReportJournal( this );
+
+    //*** the directory may not be there on first run ***
+    QDir().mkpath( QFileInfo( journalPath_ ).absolutePath() );
+    if ( !journal_->open( journalPath_ ) )
+    {
+        qDebug() << "Weight reports won't survive a restart!!!";
+    }
+
+    //*** retry unacked reports, and log how far behind we are ***
+    reportTimer_ = new QTimer( this );
+    connect( reportTimer_, &QTimer::timeout, this, &MainWindow::handleReportTimer );
+    reportTimer_->start( REPORT_CHECK_MSEC );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::sendReports - sends journaled reports that haven't been
+ *              sent yet, a frame of up to REPORT_BATCH at a time. Legacy
+ *              clients can't ack, so a report written to one counts as
+ *              delivered, as it always has. Clients that haven't sent
+ *              anything yet aren't sent reports - they get the backlog
+ *              once identified, so a silent socket can't swallow it.
+ */
+//*****************************************************************************
+void MainWindow::sendReports()
+{
+QVector<t_WeightRecord> batch;  // reports in one frame
+int legacy;                     // clients sent fixed size reports
+
+    if ( !journal_ || !connections_ ) return;
+
+    while ( journal_->takeUnsent( batch, REPORT_BATCH ) > 0 )
+    {
+        //*** nobody to send to - they go when someone connects ***
+        if ( connections_->sendReports( batch, scales_->count() > 1, &legacy ) == 0 )
+        {
+            journal_->resend();
+            return;
+        }
+
+        if ( legacy > 0 ) journal_->acked( batch.last().reportId );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleIdentified - called once a new client has sent
+ *              enough to know its framing. Everything not acked is sent
+ *              again - fpSvr may have missed it while away.
+ * @param id - connection
+ */
+//*****************************************************************************
+void MainWindow::handleIdentified( int id )
+{
+Q_UNUSED( id )
+
+    journal_->resend();
+    sendReports();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleReportsAcked - called when a client has stored
+ *              reports. The next batch of the backlog follows.
+ * @param id - connection
+ * @param reportId - every report up to this one is stored
+ */
+//*****************************************************************************
+void MainWindow::handleReportsAcked( int id, quint32 reportId )
+{
+Q_UNUSED( id )
+
+    journal_->acked( reportId );
+    sendReports();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleReportTimer - resends reports that have gone
+ *              unacked too long and logs the journal's depth.
+ */
+//*****************************************************************************
+void MainWindow::handleReportTimer()
+{
+t_JournalStats stats;   // journal metrics
+
+    if ( !journal_ ) return;
+
+    //*** sent but never acked - the socket may have died with them in it ***
+    if ( journal_->unackedSentMsec() > REPORT_RETRY_MSEC )
+    {
+        journal_->resend();
+    }
+    sendReports();
+
+    journal_->getStats( stats );
+    if ( stats.depth > 0 )
+    {
+        qDebug() << "Report journal:" << stats.depth << "not acked, oldest" << stats.oldestAgeMsec / 1000
+                 << "sec," << stats.resent << "resends," << stats.fileBytes << "bytes";
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleLiveRateChanged - called when the fastest live
+ *              weight rate subscribed at changes. Nothing is sampled while
+ *              nobody is subscribed.
+ * @param hz - live weights per second, 0 for none
+ */
+//*****************************************************************************
+void MainWindow::handleLiveRateChanged( int hz )
+{
+    if ( hz <= 0 )
     {
-        //*** handle incoming connections ***
-        connect (svr_, &QTcpServer::newConnection, this, &MainWindow::handleNewConnection );
+        liveTimer_->stop();
+        return;
     }
+
+    liveTimer_->start( 1000 / hz );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::handleLiveTimer - sends every station's latest weight to
+ *              the live subscribers that are due. Reads the same snapshot as
+ *              getWeight(), so the samples are never waited on.
+ */
+//*****************************************************************************
+void MainWindow::handleLiveTimer()
+{
+QVector<t_LiveWeight> weights;  // one per station
+t_WeightSnapshot snap;          // a station's latest weight
+
+    if ( !scales_ || !connections_ ) return;
+
+    weights.resize( scales_->count() );
+    for ( int i=0; i<scales_->count(); i++ )
+    {
+        t_LiveWeight &w = weights[i];
+        w.station = ( scales_->count() > 1 ) ? scales_->stationId( i ) : 0;
+        w.valid   = scales_->scale( i )->weightSnapshot( snap );
+        w.weight  = w.valid ? snap.weight : 0.0f;
+        w.stable  = w.valid && snap.stable;
+    }
+
+    connections_->sendLive( weights );
 }
 
 
@@ -755,8 +1320,81 @@ void MainWindow::setupServer()
 //*****************************************************************************
 void MainWindow::setupScale()
 {
-    //*** class that reads i2c data from the nau7802 board ***
-    nau7802_ = new NAU7802( tare_, scale_ );
+    //*** one scale per station, each on its own acquisition thread ***
+    scales_ = new ScaleRegistry();
+    scales_->setCaptureDir( captureDir_ );
+    foreach( const t_StationConfig &config, stations_ )
+    {
+        scales_->addStation( config, stability_ );
+        lastStable_.append( 0.0 );
+    }
+
+    //*** weight displays follow the scale ***
+    connect( scales_, &ScaleRegistry::weightChanged, this, &MainWindow::handleWeightChanged );
+
+    //*** settled loads - used for auto capture ***
+    connect( scales_, &ScaleRegistry::stableWeight, this, &MainWindow::handleStableWeight );
+
+    //*** samples for tare and calibration ***
+    connect( scales_, &ScaleRegistry::freshSamplesProgress, this, &MainWindow::handleFreshSamplesProgress );
+    connect( scales_, &ScaleRegistry::freshSamplesReady, this, &MainWindow::handleFreshSamplesReady );
+
+    //*** bring-up result ***
+    connect( scales_, &ScaleRegistry::stationReady, this, &MainWindow::handleScaleReady );
+    connect( scales_, &ScaleRegistry::stationFailed, this, &MainWindow::handleScaleFailed );
+
+    //*** bring the chips up and start sampling in the background ***
+    scales_->start();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::curScale - the scale of the station being used
+ * @return the scale
+ */
+//*****************************************************************************
+ScaleDriver *MainWindow::curScale()
+{
+    return scales_->scale( curStation_ );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::cancelTare - stops the samples of a tare that hasn't
+ *              finished, so the next TARE click starts a new one
+ */
+//*****************************************************************************
+void MainWindow::cancelTare()
+{
+    if ( tareRequest_ != 0 ) scales_->scale( tareStation_ )->cancelFreshSamples( tareRequest_ );
+    tareRequest_ = 0;
+    tareStation_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief MainWindow::displayName - shows the current person (and station if
+ *              there is more than one) at the top of the weigh page
+ */
+//*****************************************************************************
+void MainWindow::displayName()
+{
+    //*** name along with # items ***
+    QString txt = QString( "%1 ( %2 )" ).arg(curName_).arg(clients_[curName_].numItems);
+
+    //*** which scale ***
+    if ( scales_->count() > 1 )
+    {
+        txt += QString( "   Scale %1" ).arg( scales_->stationId( curStation_ ) );
+    }
+
+    ui->nameLbl->setText( txt );
 }
 
 
@@ -765,9 +1403,10 @@ void MainWindow::setupScale()
 /**
  * @brief MainWindow::addClient - adds a new incoming client to the map and ui
  * @param ci - structure containing client info
+ * @param refresh - redisplay the name list
  */
 //*****************************************************************************
-void MainWindow::addClient( t_CheckIn &ci )
+void MainWindow::addClient( t_CheckIn &ci, bool refresh )
 {
     //*** grab name ***
     QString name = ci.name;
@@ -779,7 +1418,7 @@ void MainWindow::addClient( t_CheckIn &ci )
     }
 
     //*** add to ui and 'all' names list ***
-    addToNameList( name );
+    addToNameList( name, refresh );
 }
 
 
@@ -793,14 +1432,31 @@ void MainWindow::loadSettings()
 {
 QSettings s;    // settings object - uses app names set in constructor
 
-    //*** tare value ***
-    tare_ = s.value( TARE_STR, DEFAULT_TARE ).toInt();
-
-    //*** scale value ***
-    scale_ = s.value( SCALE_STR, DEFAULT_SCALE ).toDouble();
-
     //*** cal weight setting ***
     calWeight_ = s.value( CALWT_STR, DEFAULT_CALWT ).toFloat();
+
+    //*** scale stations - hardware and calibration of each ***
+    stations_ = ScaleRegistry::loadStations( s );
+
+    //*** N simulated stations instead, for load testing ***
+    simStations_ = s.value( SIM_STATIONS_STR, 0 ).toInt();
+    if ( simStations_ > 0 ) stations_ = ScaleRegistry::simStations( simStations_ );
+
+    //*** when a load is considered settled ***
+    stability_ = StabilityDetector::defaultConfig();
+    stability_.maxStdDev = s.value( STABLE_SD_STR, stability_.maxStdDev ).toDouble();
+    stability_.maxSlope  = s.value( STABLE_SLOPE_STR, stability_.maxSlope ).toDouble();
+    stability_.dwellMsec = s.value( STABLE_DWELL_STR, stability_.dwellMsec ).toInt();
+
+    //*** capture settled loads without the 'weigh' button ***
+    autoCapture_ = s.value( AUTO_STR, false ).toBool();
+
+    //*** record raw conversions here for offline tuning - empty for none ***
+    captureDir_ = s.value( CAPTURE_DIR_STR, QString() ).toString();
+
+    //*** weight reports not yet acked by fpSvr ***
+    QString dataDir = QStandardPaths::writableLocation( QStandardPaths::AppDataLocation );
+    journalPath_ = s.value( JOURNAL_STR, QDir( dataDir ).filePath( "reports.journal" ) ).toString();
 }
 
 
@@ -815,9 +1471,12 @@ void MainWindow::saveSettings()
 QSettings s;    // settings object - uses app names set in constructor
 
     //*** save values ***
-    s.setValue( TARE_STR, tare_ );
-    s.setValue( SCALE_STR, scale_ );
     s.setValue( CALWT_STR, calWeight_ );
+
+    //*** station profiles - simulated load test stations are not kept ***
+    if ( scales_ ) stations_ = scales_->configs();
+    if ( simStations_ == 0 ) ScaleRegistry::saveStations( s, stations_ );
+    s.setValue( AUTO_STR, ui->autoCaptureBtn->isChecked() );
 }
 
 
@@ -842,9 +1501,10 @@ QString buf;
 /**
  * @brief MainWindow::addToNameList - adds a name to the person list
  * @param name - name to add
+ * @param refresh - redisplay the name list
  */
 //*****************************************************************************
-void MainWindow::addToNameList( QString name )
+void MainWindow::addToNameList( QString name, bool refresh )
 {
     //*** add if not already there ***
     if ( !nameList_.contains( name ) )
@@ -859,7 +1519,7 @@ void MainWindow::addToNameList( QString name )
     }
 
     //*** redisplay ***
-    refreshNameList();
+    if ( refresh ) refreshNameList();
 }
 
 
@@ -868,15 +1528,16 @@ void MainWindow::addToNameList( QString name )
 /**
  * @brief MainWindow::removeFromNameList - removes a name from the person list
  * @param name - name to remove
+ * @param refresh - redisplay the name list
  */
 //*****************************************************************************
-void MainWindow::removeFromNameList( QString name )
+void MainWindow::removeFromNameList( QString name, bool refresh )
 {
     //*** remove from the list ***
     nameList_.removeAll( name );
 
     //*** redisplay ***
-    refreshNameList();
+    if ( refresh ) refreshNameList();
 }
 
 
@@ -889,12 +1550,17 @@ void MainWindow::removeFromNameList( QString name )
 //*****************************************************************************
 void MainWindow::refreshNameList()
 {
+    //*** one repaint for the whole list ***
+    ui->nameList->setUpdatesEnabled( false );
+
     //*** clear the list control ***
     ui->nameList->clear();
 
     //*** set the current list of names in the control ***
     ui->nameList->addItems( nameList_ );
 
+    ui->nameList->setUpdatesEnabled( true );
+
     //*** set 'restore' button state ***
     ui->restoreNameBtn->setEnabled( nameList_.size() < allNames_.size() );
 }
@@ -4,44 +4,16 @@
 #include <QMainWindow>
 #include <QListWidgetItem>
 #include <QHash>
-#include <QTcpServer>
 #include <QTimer>
-//#include "HX711.h"
-#include "NAU7802.h"
+#include "ScaleDriver.h"
+#include "ScaleRegistry.h"
+#include "ConnectionManager.h"
+#include "ReportJournal.h"
 
 namespace Ui {
 class MainWindow;
 }
 
-const int FP_NAME_MAX = 127;
-
-typedef struct
-{
-    int key;
-    char name[FP_NAME_MAX+1];
-    int  numItems;
-    qint64 day;
-} t_CheckIn;
-
-typedef struct
-{
-    quint32 magic;
-    quint32 size;
-    quint32 type;
-    int     key;
-    float   weight;
-    qint64  day;
-} t_WeightReport;
-
-const int MAGIC_VAL = 0x3e3e3e3e;
-
-const int CHECKIN_SIZE = sizeof( t_CheckIn );
-
-const int WEIGHT_REPORT_SIZE = sizeof( t_WeightReport );
-const int WEIGHT_SIZE_FIELD = WEIGHT_REPORT_SIZE - ( 2 * sizeof(quint32) );
-const int WEIGHT_REPORT_TYPE = 0x0001;
-
-
 typedef enum { NOCAL_MODE, CAL_TARE_MODE, CAL_WEIGHT_MODE, TARE_MODE } CalMode;
 
 //*****************************************************************************
@@ -68,20 +40,32 @@ private slots:
     void handleShutdown();
     void handleCancelCalibrate();
     void handleCalibrateContinue();
+    void handleFreshSamplesProgress( int index, int id, int collected, int needed );
+    void handleFreshSamplesReady( int index, t_FreshSamples samples );
 
     void handleNameSelected( QListWidgetItem* item );
 
     void handleWeigh();
+    void handleStableWeight( int index, float weight, int settleMsec );
     void handleClearLast();
     void handleDone();
 
-    void handleNewConnection();
-    void clientDataReady();
-    void displayError( QAbstractSocket::SocketError socketError );
+    void handleConnectedChanged( bool connected );
+    void handleCheckInFrame( int id, const t_FrameInfo &frame, ProtocolReader *reader );
+    void handleFramesDone( int id );
+    void handleIdentified( int id );
+    void handleReportsAcked( int id, quint32 reportId );
+    void handleReportTimer();
+    void handleLiveRateChanged( int hz );
+    void handleLiveTimer();
 
     void handleTare();
 
-    void requestWeight();
+    void handleWeightChanged( int index, float weight );
+    void displayWeight();
+
+    void handleScaleReady( int index );
+    void handleScaleFailed( int index, QString reason );
 
     void handleChangeCalWeight();
 
@@ -95,11 +79,38 @@ private:
     //*** set up the TCP server ***
     void setupServer();
 
+    //*** open the journal of weight reports not yet acked ***
+    void setupJournal();
+
+    //*** send journaled reports not sent yet, in batches ***
+    void sendReports();
+
     //*** set up scale ***
     void setupScale();
 
-    //*** add a new client to the list ***
-    void addClient( t_CheckIn &ci );
+    //*** scale of the station being used ***
+    ScaleDriver *curScale();
+
+    //*** drop a tare still waiting on samples ***
+    void cancelTare();
+
+    //*** show the person (and station) on the weigh page ***
+    void displayName();
+
+    //*** add a weight to the list for the current person ***
+    void addWeight( float weight );
+
+    //*** add a new client to the list - refresh false leaves the display to the caller ***
+    void addClient( t_CheckIn &ci, bool refresh = true );
+
+    //*** apply one check-in (or check-out) from fpSvr - display not refreshed ***
+    void applyCheckIn( const t_CheckInView &view );
+
+    //*** replace the roster with the check-ins of the reader's frame - display not refreshed ***
+    void applyRosterSnapshot( ProtocolReader *reader, int count );
+
+    //*** tell a connection which roster sequence we hold ***
+    void sendRosterAck( int id, quint32 flags );
 
     //*** settings ***
     void loadSettings();
@@ -109,8 +120,8 @@ private:
     void displayCalWeight();
 
     //*** name list manipulation ***
-    void addToNameList( QString name );
-    void removeFromNameList( QString name );
+    void addToNameList( QString name, bool refresh = true );
+    void removeFromNameList( QString name, bool refresh = true );
     void refreshNameList();
 
     //*** initialize the fake data for testing ***
@@ -119,9 +130,11 @@ private:
     //*** UI ***
     Ui::MainWindow *ui;
 
-    //*** scale reader object ***
-//    HX711 *hx711_;
-    NAU7802 *nau7802_;
+    //*** scale stations and the one being used ***
+    ScaleRegistry *scales_;
+    QList<t_StationConfig> stations_;
+    int simStations_;
+    int curStation_;
 
     //*** map client name to client data ***
     QHash<QString,t_CheckIn> clients_;
@@ -129,20 +142,35 @@ private:
     //*** current name being processed ***
     QString curName_;
 
-    //*** flag that shows if the fpSvr is connected ***
+    //*** flag that shows if any client (fpSvr or a monitor) is connected ***
     bool connected_;
 
-    //*** TCP server ***
-    QTcpServer *svr_;
+    //*** TCP server and everyone connected to it ***
+    ConnectionManager *connections_;
 
-    //*** connected client ***
-    QTcpSocket *client_;
+    //*** samples the weights for live subscribers - only runs while there are some ***
+    QTimer *liveTimer_;
 
-    //*** timer to display weight ***
-    QTimer *weightTimer_;
+    //*** roster sequence last applied from fpSvr (0 for none) - kept across reconnects ***
+    quint64 rosterSeq_;
 
-    //*** list of weight values ***
+    //*** weight reports kept until fpSvr acks them, and the retry / metrics timer ***
+    ReportJournal *journal_;
+    QString journalPath_;
+    QTimer *reportTimer_;
+
+    //*** what the frames of one read did - see handleFramesDone() ***
+    bool rosterChanged_;
+    bool rosterAck_;
+    quint32 rosterAckFlags_;
+
+    //*** weight of the current station, as last reported ***
+    float curWeight_;
+    bool haveWeight_;
+
+    //*** list of weight values and the station each came from ***
     QList<float> weights_;
+    QList<int> weightStations_;
 
     //*** list of previously used names ***
     QStringList allNames_;
@@ -151,13 +179,25 @@ private:
     QStringList nameList_;
 
     //*** scale vars ***
-    int tare_;
-    double scale_;
     float calWeight_;
 
+    //*** settled load detection and auto capture ***
+    t_StabilityConfig stability_;
+    bool autoCapture_;
+    QList<float> lastStable_;
+
+    //*** where raw conversions are recorded, empty if not recording ***
+    QString captureDir_;
+
     CalMode curCalMode_;
     int calTareVal_;
     int calWeightVal_;
+    int calTareVal2_;
+
+    //*** outstanding fresh sample requests (0 for none) ***
+    int calRequest_;
+    int tareRequest_;
+    int tareStation_;
 
     //*** list of fake data for testing ***
     QList<t_CheckIn> fake_;
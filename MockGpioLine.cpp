@@ -0,0 +1,85 @@
+#include "MockGpioLine.h"
+#include <QMutexLocker>
+
+
+//*****************************************************************************
+//*****************************************************************************
+MockGpioLine::MockGpioLine()
+{
+    edge_      = RISING_EDGE;
+    level_     = 0;
+    pending_   = 0;
+    delivered_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool MockGpioLine::open( Edge edge )
+{
+QMutexLocker lock( &mutex_ );
+
+    edge_ = edge;
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int MockGpioLine::waitForEdge( int timeoutMsec )
+{
+QMutexLocker lock( &mutex_ );
+
+    //*** wait for someone to drive an edge ***
+    if ( pending_ == 0 )
+    {
+        edgeCond_.wait( &mutex_, static_cast<unsigned long>( timeoutMsec ) );
+    }
+
+    if ( pending_ == 0 ) return 0;
+
+    pending_--;
+    delivered_++;
+
+    return 1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int MockGpioLine::level()
+{
+QMutexLocker lock( &mutex_ );
+
+    return level_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void MockGpioLine::setLevel( int level )
+{
+QMutexLocker lock( &mutex_ );
+
+    level = level ? 1 : 0;
+    if ( level == level_ ) return;
+
+    //*** is this the edge being watched? ***
+    if ( ( edge_ == RISING_EDGE && level == 1 ) || ( edge_ == FALLING_EDGE && level == 0 ) )
+    {
+        pending_++;
+        edgeCond_.wakeAll();
+    }
+
+    level_ = level;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int MockGpioLine::edgeCount()
+{
+QMutexLocker lock( &mutex_ );
+
+    return delivered_;
+}
@@ -0,0 +1,50 @@
+#ifndef MOCKGPIOLINE_H
+#define MOCKGPIOLINE_H
+
+#include "GpioLine.h"
+#include <QMutex>
+#include <QWaitCondition>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The MockGpioLine class - stand-in GPIO line for running without
+ *              hardware. The level is driven by setLevel() from any thread.
+ */
+//*****************************************************************************
+class MockGpioLine : public GpioLine
+{
+public:
+
+    //*** constructor ***
+    MockGpioLine();
+
+    bool open( Edge edge ) override;
+    int waitForEdge( int timeoutMsec ) override;
+    int level() override;
+
+    //*** drive the line - generates an edge if it matches the requested one ***
+    void setLevel( int level );
+
+    //*** number of edges delivered so far ***
+    int edgeCount();
+
+private:
+
+    QMutex mutex_;
+    QWaitCondition edgeCond_;
+
+    //*** edge we report ***
+    Edge edge_;
+
+    //*** current level ***
+    int level_;
+
+    //*** edges not yet consumed by waitForEdge() ***
+    int pending_;
+
+    //*** edges consumed ***
+    int delivered_;
+};
+
+#endif // MOCKGPIOLINE_H
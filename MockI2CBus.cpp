@@ -0,0 +1,190 @@
+#include "MockI2CBus.h"
+#include "MockGpioLine.h"
+#include "NAU7802.h"
+#include <QMutexLocker>
+#include <string.h>
+
+
+//*****************************************************************************
+//*****************************************************************************
+MockI2CBus::MockI2CBus( MockGpioLine *drdyLine )
+{
+    drdyLine_     = drdyLine;
+    combined_     = true;
+    transactions_ = 0;
+
+    resetRegisters();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool MockI2CBus::open()
+{
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int MockI2CBus::readReg8( quint8 reg )
+{
+QMutexLocker lock( &mutex_ );
+
+    transactions_++;
+
+    return readLocked( reg );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool MockI2CBus::readBlocks( t_RegRead *reads, int numReads )
+{
+    //*** emulate a one register at a time backend ***
+    if ( !combined_ ) return I2CBus::readBlocks( reads, numReads );
+
+    QMutexLocker lock( &mutex_ );
+
+    //*** whole request is one transaction ***
+    transactions_++;
+
+    for ( int i=0; i<numReads; i++ )
+    {
+        for ( int j=0; j<reads[i].len; j++ )
+        {
+            reads[i].data[j] = readLocked( static_cast<quint8>( reads[i].reg + j ) );
+        }
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint8 MockI2CBus::readLocked( quint8 reg )
+{
+    quint8 value = regs_[ reg ];
+
+    //*** reading the result clears conversion ready ***
+    if ( reg == NAU7802_ADCO_B0 )
+    {
+        regs_[ NAU7802_PU_CTRL ] &= ~( 1 << NAU7802_PU_CTRL_CR );
+        updateDrdy();
+    }
+
+    return value;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool MockI2CBus::writeReg8( quint8 reg, quint8 value )
+{
+QMutexLocker lock( &mutex_ );
+
+    transactions_++;
+
+    if ( reg == NAU7802_PU_CTRL )
+    {
+        //*** register reset ***
+        if ( value & ( 1 << NAU7802_PU_CTRL_RR ) )
+        {
+            resetRegisters();
+            regs_[ NAU7802_PU_CTRL ] = value;
+            return true;
+        }
+
+        //*** keep read only bits, power up ready follows PUD ***
+        quint8 readOnly = ( 1 << NAU7802_PU_CTRL_CR );
+        value = ( value & ~readOnly & ~( 1 << NAU7802_PU_CTRL_PUR ) ) | ( regs_[reg] & readOnly );
+        if ( value & ( 1 << NAU7802_PU_CTRL_PUD ) )
+        {
+            value |= ( 1 << NAU7802_PU_CTRL_PUR );
+        }
+    }
+    else if ( reg == NAU7802_CTRL2 )
+    {
+        //*** AFE calibration completes instantly and without error ***
+        value &= ~( 1 << NAU7802_CTRL2_CALS );
+        value &= ~( 1 << NAU7802_CTRL2_CAL_ERROR );
+    }
+
+    regs_[ reg ] = value;
+
+    updateDrdy();
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void MockI2CBus::loadConversion( qint32 value )
+{
+QMutexLocker lock( &mutex_ );
+
+    //*** 24 bit result ***
+    regs_[ NAU7802_ADCO_B2 ] = static_cast<quint8>( value >> 16 );
+    regs_[ NAU7802_ADCO_B1 ] = static_cast<quint8>( value >> 8 );
+    regs_[ NAU7802_ADCO_B0 ] = static_cast<quint8>( value );
+
+    //*** conversion ready ***
+    regs_[ NAU7802_PU_CTRL ] |= ( 1 << NAU7802_PU_CTRL_CR );
+
+    updateDrdy();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint8 MockI2CBus::reg( quint8 reg )
+{
+QMutexLocker lock( &mutex_ );
+
+    return regs_[ reg ];
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 MockI2CBus::transactions()
+{
+QMutexLocker lock( &mutex_ );
+
+    return transactions_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void MockI2CBus::resetTransactions()
+{
+QMutexLocker lock( &mutex_ );
+
+    transactions_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void MockI2CBus::resetRegisters()
+{
+    memset( regs_, 0, sizeof(regs_) );
+
+    regs_[ NAU7802_DEVICE_REV ] = 0x0F;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void MockI2CBus::updateDrdy()
+{
+    if ( !drdyLine_ ) return;
+
+    bool ready   = ( regs_[ NAU7802_PU_CTRL ] & ( 1 << NAU7802_PU_CTRL_CR ) ) != 0;
+    bool lowTrue = ( regs_[ NAU7802_CTRL1 ] & ( 1 << NAU7802_CTRL1_CRP ) ) != 0;
+
+    drdyLine_->setLevel( ready != lowTrue ? 1 : 0 );
+}
@@ -0,0 +1,77 @@
+#ifndef MOCKI2CBUS_H
+#define MOCKI2CBUS_H
+
+#include "I2CBus.h"
+#include <QMutex>
+
+class MockGpioLine;
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The MockI2CBus class - stand-in NAU7802 register file for running
+ *              the driver without hardware.
+ *
+ *  Just enough behavior for bring-up to succeed: power up ready, instant AFE
+ *  calibration, and a conversion ready bit that is set by loadConversion()
+ *  and cleared when the result is read. If a data ready line is attached it
+ *  follows the CR bit (honoring the CRP polarity bit).
+ *
+ *  Every bus transaction is counted so tests can check the cost per sample.
+ *  It can behave like a combined transfer backend (i2c-dev) or a one
+ *  register at a time backend (wiringPi).
+ */
+//*****************************************************************************
+class MockI2CBus : public I2CBus
+{
+public:
+
+    //*** constructor ***
+    explicit MockI2CBus( MockGpioLine *drdyLine = nullptr );
+
+    bool open() override;
+    int readReg8( quint8 reg ) override;
+    bool writeReg8( quint8 reg, quint8 value ) override;
+    bool readBlocks( t_RegRead *reads, int numReads ) override;
+    bool combinedTransfers() const override { return combined_; }
+
+    //*** choose combined (one transaction) or per register block reads ***
+    void setCombinedTransfers( bool combined ) { combined_ = combined; }
+
+    //*** number of bus transactions since the last reset ***
+    quint64 transactions();
+    void resetTransactions();
+
+    //*** make a new conversion result available ***
+    void loadConversion( qint32 value );
+
+    //*** direct register access for checking driver behavior ***
+    quint8 reg( quint8 reg );
+
+private:
+
+    //*** set power on defaults ***
+    void resetRegisters();
+
+    //*** register read with side effects - mutex must be held ***
+    quint8 readLocked( quint8 reg );
+
+    //*** drive the data ready line from the CR bit ***
+    void updateDrdy();
+
+    QMutex mutex_;
+
+    //*** register file ***
+    quint8 regs_[ 256 ];
+
+    //*** optional data ready line ***
+    MockGpioLine *drdyLine_;
+
+    //*** behave like a combined transfer backend ***
+    bool combined_;
+
+    //*** bus transaction count ***
+    quint64 transactions_;
+};
+
+#endif // MOCKI2CBUS_H
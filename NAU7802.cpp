@@ -1,256 +1,328 @@
 #include "NAU7802.h"
+#include "NAU7802Reader.h"
+#include "I2CBus.h"
+#include "GpioLine.h"
+#include "ScaleClock.h"
 #include <QtCore>
-#include <wiringPi.h>
-#include <wiringPiI2C.h>
+#include <cmath>
 #include <stdio.h>
-#include <QElapsedTimer>
+#include <string.h>
 #include <QDebug>
 
 //*****************
 //*** CONSTANTS ***
 //*****************
 
-const int SAMPLES_PER_WEIGHT = 5;
+//*** output rate of the weight stream ***
+const int OUTPUT_RATE        = 20;
 
-const int SAMPLES_PER_SECOND = 10;
-const int SECONDS_QUEUED     = 2;
-const int QUEUE_SIZE         = SAMPLES_PER_SECOND * SECONDS_QUEUED;
+//*** average over 1/2 second at the normal rate ***
+const int SAMPLES_PER_WEIGHT = 10;
 
-const int I2C_ADDR           = 0x2A;
+//*** high rate mode has less noise per output - average over 1/4 second ***
+const int SAMPLES_PER_WEIGHT_HR = 5;
+
+//*** dual channel mode gives each channel under half the output rate ***
+const int SAMPLES_PER_WEIGHT_DUAL = 4;
+
+//*** the conversion in progress when the channel changes is a mix of both ***
+const int SWITCH_SETTLE = 1;
+
+//*** bring-up timing ***
+const int RESET_MSEC            = 1;      // hold RR this long
+const int POWER_UP_POLL_MSEC    = 1;      // PUR takes about 200 usec
+const int POWER_UP_TIMEOUT_MSEC = 100;
+const int CAL_POLL_MSEC         = 10;     // calibration takes about 344 msec
+const int CAL_TIMEOUT_MSEC      = 1000;
 
 
 //*****************************************************************************
 //*****************************************************************************
-NAU7802::NAU7802( int rawTare, double scale )
-    : QObject()
+NAU7802::NAU7802( int rawTare, double scale, GpioLine *drdyLine, I2CBus *bus, ScaleClock *clock,
+                  const t_NAU7802Config &config )
+    : ScaleDriver( rawTare, scale, clock )
 {
     //*** save initialization values ***
-    tare_    = rawTare;
-    scale_   = scale;
-    nau7802_ = 0;
+    drdyLine_ = drdyLine;
+    bus_      = bus;
+    config_   = config;
 
-    //*** now set up the nau7802 chip ***
-    setup();
+    //*** raw conversions are decimated to the output rate, then averaged into weights ***
+    int sps = samplesPerSecond( config_.sampleRate );
+    int numChannels = config_.dualChannel ? NAU7802_NUM_CHANNELS : 1;
+    config_.switchSettle = qMax( 0, config_.switchSettle );
+    setupPipeline( sps, config_.outputRate, config_.weightSamples, numChannels, config_.stability );
 
-    //*** setup sample timer ***
-    sampleTimer_ = new QTimer(this);
-    sampleTimer_->setInterval( 100 );
-    connect( sampleTimer_, SIGNAL(timeout()), SLOT(takeReading()));
-    sampleTimer_->start();
-}
+    //*** always start on channel 1 ***
+    channel_    = NAU7802_CHANNEL_1;
+    settleLeft_ = 0;
 
+    //*** register cache starts out empty ***
+    useShadow_         = true;
+    regTransactions_   = 0;
+    setupTransactions_ = 0;
+    setupMsec_         = 0;
+    memset( shadowValid_, 0, sizeof(shadowValid_) );
 
-//*****************************************************************************
-//*****************************************************************************
-NAU7802::~NAU7802()
-{
-    //*** stop and clean up timer ***
-    sampleTimer_->stop();
-    delete sampleTimer_;
+    //*** nothing done yet - bring-up happens in the acquisition thread ***
+    bringUpState_ = NAU7802_BRING_UP_OPEN;
+
+    //*** default to the wiringPi i2c backend ***
+    if ( !bus_ ) bus_ = new WiringPiI2CBus( NAU7802_I2C_ADDR );
+
+    //*** when polling, poll twice per conversion so none are missed ***
+    reader_ = new NAU7802Reader( this, clock_, 1000000 / ( sps * 2 ) );
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-bool NAU7802::setup()
+NAU7802::~NAU7802()
 {
-bool result = true;
-
-    //*** open i2c device ***
-    nau7802_ = wiringPiI2CSetup( I2C_ADDR );
+    //*** stop and clean up acquisition thread (may never have started) ***
+    reader_->stop();
+    delete reader_;
 
-    if ( nau7802_ < 0 )
-    {
-        qDebug() << "Error accessing NAU7802 device over I2C";
-        return false;
-    }
-    else
+    //*** report what interleaving cost ***
+    if ( config_.dualChannel )
     {
-        qDebug() << "Connected to NAU7802 I2C device";
-    }
-
-    result &= reset(); //Reset all registers
-
-    result &= powerUp(); //Power on analog and digital sections of the scale
-
-    result &= setLDO(NAU7802_LDO_3V3); //Set LDO to 3.3V
-
-    result &= setGain(NAU7802_GAIN_64); //Set gain to 64
-
-    result &= setSampleRate(NAU7802_SPS_20); //Set samples per second to 20
-
-    result &= setRegister(NAU7802_ADC, 0x30); //Turn off CLK_CHP. From 9.1 power on sequencing.
-
-    result &= setBit(NAU7802_PGA_PWR_PGA_CAP_EN, NAU7802_PGA_PWR); //Enable 330pF decoupling cap on chan 2. From 9.14 application circuit note.
-
-    result &= calibrateAFE(); //Re-cal analog front end when we change gain, sample rate, or channel
+        for ( int ch=0; ch<NAU7802_NUM_CHANNELS; ch++ )
+        {
+            t_ChannelStats stats;
+            getChannelStats( ch, stats );
 
-    qDebug() << "Setup result:" << result;
+            qDebug() << "Channel" << ch + 1 << ":" << stats.conversions << "conversions,"
+                     << stats.discarded << "discarded," << stats.switches << "switches,"
+                     << stats.switchUsec << "usec per switch," << stats.outputRate << "samples/sec";
+        }
+    }
 
-    return  result;
+    //*** hardware backends ***
+    delete drdyLine_;
+    delete bus_;
 }
 
 
-
 //*****************************************************************************
 //*****************************************************************************
-float NAU7802::getWeight()
+t_NAU7802Config NAU7802::defaultConfig()
 {
-t_DataSet data;
-float totalWeight = 0.0;
-
-    //*** get samples for weight ***
-    collectProcessedData( SAMPLES_PER_WEIGHT, data );
-
-    //*** no data ***
-    if ( data.isEmpty() ) return -1.0;
+t_NAU7802Config config;
 
-    //*** calculate average weight ***
-    foreach( int sample, data )
-    {
-        totalWeight += ( ((double)sample - (double)tare_) * scale_ );
-    }
-
-    //*** compute the average weight ***
-    float weightVal = (float)( totalWeight / (float)data.size() );
+    config.sampleRate    = NAU7802_SPS_20;
+    config.outputRate    = OUTPUT_RATE;
+    config.weightSamples = SAMPLES_PER_WEIGHT;
+    config.stability     = StabilityDetector::defaultConfig();
+    config.dualChannel   = false;
+    config.switchSettle  = SWITCH_SETTLE;
 
-    return weightVal;
+    return config;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-int NAU7802::getRawAvg( int numSamples )
+t_NAU7802Config NAU7802::highRateConfig( quint8 sampleRate )
 {
-t_DataSet data;
-long long totalVal = 0;
-
-    //*** get samples for weight ***
-    collectProcessedData( numSamples, data );
-
-    //*** no data ***
-    if ( data.isEmpty() ) return 0;
+t_NAU7802Config config;
 
-    //*** calculate average value ***
-    foreach( int sample, data )
-    {
-        totalVal += sample;
-    }
-
-    //*** compute the average weight ***
-    int avgVal = static_cast<int>( totalVal / data.size() );
+    config.sampleRate    = sampleRate;
+    config.outputRate    = OUTPUT_RATE;
+    config.weightSamples = SAMPLES_PER_WEIGHT_HR;
+    config.stability     = StabilityDetector::defaultConfig();
+    config.dualChannel   = false;
+    config.switchSettle  = SWITCH_SETTLE;
 
-    return avgVal;
+    return config;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-void NAU7802::setCalibrationData( int tareVal, int weightVal, float actualWeight )
+t_NAU7802Config NAU7802::dualChannelConfig( quint8 sampleRate )
 {
-    //*** save new raw tare value ***
-    tare_ = tareVal;
+t_NAU7802Config config;
 
-    //*** calculate scale factor ***
-    double weight = static_cast<double>(actualWeight);
-    scale_ = (double)( weight / ((double)weightVal - (double)tareVal) );
+    //*** each visit to a channel settles, then makes one decimated sample ***
+    config.sampleRate    = sampleRate;
+    config.outputRate    = OUTPUT_RATE;
+    config.weightSamples = SAMPLES_PER_WEIGHT_DUAL;
+    config.stability     = StabilityDetector::defaultConfig();
+    config.dualChannel   = true;
+    config.switchSettle  = SWITCH_SETTLE;
+
+    return config;
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-void NAU7802::getCalibrationData( int &rawTareValue, double &scaleValue )
+int NAU7802::samplesPerSecond( quint8 sampleRate )
 {
-    rawTareValue = tare_;
-    scaleValue = scale_;
+    switch ( sampleRate )
+    {
+        case NAU7802_SPS_320: return 320;
+        case NAU7802_SPS_80:  return 80;
+        case NAU7802_SPS_40:  return 40;
+        case NAU7802_SPS_20:  return 20;
+        default:              return 10;
+    }
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-void NAU7802::setTare( int tareVal )
+void NAU7802::start()
 {
-    tare_ = tareVal;
+    //*** from here on only the acquisition thread touches the device ***
+    reader_->start( QThread::HighPriority );
 }
 
 
 //*****************************************************************************
 //*****************************************************************************
-int NAU7802::collectRawData( int numSamples, t_DataSet &data )
+int NAU7802::bringUpStep()
 {
-QQueue<int> samples;    // place to hold copy of collected data
+bool result = true;
 
-    //*** clear output data ***
-    data.clear();
+    switch ( bringUpState_.load() )
+    {
+        case NAU7802_BRING_UP_OPEN:
 
-    //*** get current queue size ***
-    int qSize = collectedData_.size();
+            //*** measure the cost of bring-up ***
+            bringUpStart_ = clock_->msecs();
+            bringUpTransactions_ = regTransactions_;
 
-    // must have samples ***
-    if ( qSize == 0 ) return 0;
+            //*** open i2c device ***
+            if ( !bus_->open() ) return bringUpFailed( "Error accessing NAU7802 device over I2C" );
 
-    //*** copy data to minimize chance of it changing in the middle of processing ***
-    samples = collectedData_;
+            qDebug() << "Connected to NAU7802 I2C device";
 
-    //*** use as many samples as we can get, up to requested amount ***
-    numSamples = qMin( qSize, numSamples );
+            //*** reset all registers - RR is held for a moment ***
+            setBit( NAU7802_PU_CTRL_RR, NAU7802_PU_CTRL );
+            memset( shadowValid_, 0, sizeof(shadowValid_) );
 
-    //*** grab requested samples from end of queue and add to list ***
-    int lastIdx = qSize - 1;
-    int firstIdx = lastIdx  - numSamples + 1;
-    for ( int idx = firstIdx; idx <= lastIdx; idx++ )
-    {
-        data.append( samples[idx] );
-    }
+            bringUpState_ = NAU7802_BRING_UP_RESET;
+            return RESET_MSEC;
 
-    return data.size();
-}
+        case NAU7802_BRING_UP_RESET:
 
+            //*** leave reset, power on analog and digital sections ***
+            result &= clearBit( NAU7802_PU_CTRL_RR, NAU7802_PU_CTRL );
+            result &= setBit( NAU7802_PU_CTRL_PUD, NAU7802_PU_CTRL );
+            result &= setBit( NAU7802_PU_CTRL_PUA, NAU7802_PU_CTRL );
+            if ( !result ) return bringUpFailed( "Error resetting NAU7802" );
 
-//*****************************************************************************
-//*****************************************************************************
-int NAU7802::collectProcessedData(int numSamples, t_DataSet &data)
-{
-    //*** get raw samples ***
-    int actualNumSamples = collectRawData( numSamples, data );
+            bringUpDeadline_ = clock_->msecs() + POWER_UP_TIMEOUT_MSEC;
+            bringUpState_ = NAU7802_BRING_UP_POWER;
+            return POWER_UP_POLL_MSEC;
 
-    //*** must have samples to do processing ***
-    if ( actualNumSamples < 2 ) return 0;
+        case NAU7802_BRING_UP_POWER:
 
-#if 0
-    //*** determine median value ***
-    qSort( data );
+            //*** wait for the power up ready bit ***
+            if ( !getBit( NAU7802_PU_CTRL_PUR, NAU7802_PU_CTRL ) )
+            {
+                if ( clock_->msecs() > bringUpDeadline_ ) return bringUpFailed( "NAU7802 did not power up" );
+                return POWER_UP_POLL_MSEC;
+            }
 
-    int median = 0;
-    int variant = 0;
-    int mid = numSamples / 2;
-    if ( (numSamples%2 == 0) )
-    {
-        //*** even # samples ***
-        median = ( data[mid] + data[mid-1] ) / 2;
-    }
-    else
-    {
-        //*** odd # samples ***
-        median = data[mid];
-    }
+            result &= setLDO(NAU7802_LDO_3V3); //Set LDO to 3.3V
 
-    //*** determine variant threshold ***
-    variant = median / 10;
+            result &= setGain(NAU7802_GAIN_64); //Set gain to 64
 
-    //*** remove outliers ***
-    for ( int i=0; i<numSamples; i++ )
-    {
-        int diff = abs( data[i] - median );
-        if ( diff > abs(variant) )
-        {
-            //*** replace outlier with median value ***
-            data[i] = median;
-        }
+            result &= setSampleRate(config_.sampleRate); //Set samples per second (20 unless in high rate mode)
+
+            result &= setRegister(NAU7802_ADC, 0x30); //Turn off CLK_CHP. From 9.1 power on sequencing.
+
+            //*** the decoupling cap sits across the channel 2 inputs - only when channel 2 is unused ***
+            if ( !config_.dualChannel )
+            {
+                result &= setBit(NAU7802_PGA_PWR_PGA_CAP_EN, NAU7802_PGA_PWR); //Enable 330pF decoupling cap on chan 2. From 9.14 application circuit note.
+            }
+
+            //*** data ready mode - CRDY pin goes high when a conversion completes ***
+            if ( drdyLine_ ) result &= setIntPolarityHigh();
+
+            if ( !result ) return bringUpFailed( "Error configuring NAU7802" );
+
+            //*** re-cal analog front end when we change gain, sample rate, or channel ***
+            beginCalibrateAFE();
+
+            bringUpDeadline_ = clock_->msecs() + CAL_TIMEOUT_MSEC;
+            bringUpState_ = NAU7802_BRING_UP_CALIBRATE;
+            return CAL_POLL_MSEC;
+
+        case NAU7802_BRING_UP_CALIBRATE:
+
+            //*** wait for AFE calibration ***
+            switch ( calAFEStatus() )
+            {
+                case NAU7802_CAL_IN_PROGRESS:
+                    if ( clock_->msecs() > bringUpDeadline_ ) return bringUpFailed( "AFE calibration timed out" );
+                    return CAL_POLL_MSEC;
+
+                case NAU7802_CAL_FAILURE:
+                    return bringUpFailed( "AFE calibration failed" );
+
+                default:
+                    break;
+            }
+
+            //*** dual mode - channel 2 keeps its own offset/gain calibration, so do it now ***
+            //*** and switching later costs no AFE time ***
+            if ( config_.dualChannel && channel_ == NAU7802_CHANNEL_1 )
+            {
+                if ( !setChannel( NAU7802_CHANNEL_2 ) ) return bringUpFailed( "Error selecting channel 2" );
+                channel_ = NAU7802_CHANNEL_2;
+
+                beginCalibrateAFE();
+
+                bringUpDeadline_ = clock_->msecs() + CAL_TIMEOUT_MSEC;
+                return CAL_POLL_MSEC;
+            }
+
+            //*** back to channel 1 to start converting ***
+            if ( config_.dualChannel )
+            {
+                if ( !setChannel( NAU7802_CHANNEL_1 ) ) return bringUpFailed( "Error selecting channel 1" );
+                channel_ = NAU7802_CHANNEL_1;
+                settleLeft_ = config_.switchSettle;
+            }
+
+            //*** conversions are running - fall back to polling if the line won't open ***
+            if ( drdyLine_ && !drdyLine_->open( GpioLine::RISING_EDGE ) )
+            {
+                qDebug() << "Data ready line unavailable, polling instead";
+                delete drdyLine_;
+                drdyLine_ = nullptr;
+            }
+
+            setupMsec_ = clock_->msecs() - bringUpStart_;
+            setupTransactions_ = regTransactions_ - bringUpTransactions_;
+
+            qDebug() << "NAU7802 ready in" << setupMsec_ << "msec,"
+                     << setupTransactions_ << "register transactions";
+
+            bringUpState_ = NAU7802_BRING_UP_READY;
+            emit ready();
+            return -1;
+
+        default:
+            return -1;
     }
-#endif
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int NAU7802::bringUpFailed( const QString &reason )
+{
+    qDebug() << "NAU7802 bring-up failed:" << reason;
+
+    bringUpState_ = NAU7802_BRING_UP_FAILED;
+    emit failed( reason );
 
-    return data.size();
+    return -1;
 }
 
 
@@ -279,7 +351,7 @@ bool NAU7802::setIntPolarityLow()
 //Mask & set a given bit within a register
 bool NAU7802::setBit(quint8 bitNumber, quint8 registerAddress)
 {
-  quint8 value = getRegister(registerAddress);
+  quint8 value = getCachedRegister(registerAddress);
   value |= (1 << bitNumber); //Set this bit
   return (setRegister(registerAddress, value));
 }
@@ -290,7 +362,7 @@ bool NAU7802::setBit(quint8 bitNumber, quint8 registerAddress)
 //Mask & clear a given bit within a register
 bool NAU7802::clearBit(quint8 bitNumber, quint8 registerAddress)
 {
-  quint8 value = getRegister(registerAddress);
+  quint8 value = getCachedRegister(registerAddress);
   value &= ~(1 << bitNumber); //Set this bit
   return (setRegister(registerAddress, value));
 }
@@ -299,9 +371,14 @@ bool NAU7802::clearBit(quint8 bitNumber, quint8 registerAddress)
 //*****************************************************************************
 //*****************************************************************************
 //Return a given bit within a register
+//Volatile bits are read from the chip, configuration bits from the shadow copy
 bool NAU7802::getBit(quint8 bitNumber, quint8 registerAddress)
 {
-  quint8 value = getRegister(registerAddress);
+  quint8 value;
+  if (volatileBits(registerAddress) & (1 << bitNumber))
+    value = getRegister(registerAddress);
+  else
+    value = getCachedRegister(registerAddress);
   value &= (1 << bitNumber); //Clear all but this bit
   return (value);
 }
@@ -309,10 +386,73 @@ bool NAU7802::getBit(quint8 bitNumber, quint8 registerAddress)
 
 //*****************************************************************************
 //*****************************************************************************
-//Get contents of a register
+//Get contents of a register from the chip
 quint8 NAU7802::getRegister(quint8 registerAddress)
 {
-    return static_cast<quint8>(wiringPiI2CReadReg8( nau7802_, registerAddress));
+    regTransactions_++;
+
+    quint8 value = static_cast<quint8>( bus_->readReg8( registerAddress ) );
+
+    //*** refresh the shadow copy while we have it ***
+    if ( registerAddress <= NAU7802_DEVICE_REV && volatileBits(registerAddress) != 0xFF )
+    {
+        shadow_[registerAddress] = value & ~volatileBits(registerAddress);
+        shadowValid_[registerAddress] = true;
+    }
+
+    return value;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+//Get contents of a register for read-modify-write
+//Only the configuration bits are valid - volatile bits are returned as 0
+quint8 NAU7802::getCachedRegister(quint8 registerAddress)
+{
+  //*** go to the chip if we have nothing to offer ***
+  if (!useShadow_ || registerAddress > NAU7802_DEVICE_REV || !shadowValid_[registerAddress])
+    return (getRegister(registerAddress) & ~volatileBits(registerAddress));
+
+  return (shadow_[registerAddress]);
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+//Bits of a register that the chip changes on its own (status, results, calibration)
+//0xFF means the whole register is volatile and never cached
+quint8 NAU7802::volatileBits(quint8 registerAddress)
+{
+  switch (registerAddress)
+  {
+    case NAU7802_PU_CTRL:
+      return ((1 << NAU7802_PU_CTRL_CR) | (1 << NAU7802_PU_CTRL_PUR));
+
+    case NAU7802_CTRL2:
+      return ((1 << NAU7802_CTRL2_CALS) | (1 << NAU7802_CTRL2_CAL_ERROR));
+
+    case NAU7802_CTRL1:
+    case NAU7802_I2C_CONTROL:
+    case NAU7802_PGA:
+    case NAU7802_PGA_PWR:
+    case NAU7802_DEVICE_REV:
+      return (0x00);
+
+    default:
+      return (0xFF); //Calibration results, ADC results and OTP
+  }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void NAU7802::setRegisterCache( bool enable )
+{
+    useShadow_ = enable;
+
+    //*** start over next time it is used ***
+    memset( shadowValid_, 0, sizeof(shadowValid_) );
 }
 
 
@@ -322,7 +462,18 @@ quint8 NAU7802::getRegister(quint8 registerAddress)
 //Return true if successful
 bool NAU7802::setRegister(quint8 registerAddress, quint8 value)
 {
-    return (wiringPiI2CWriteReg8( nau7802_, registerAddress, value ) == 0);
+    regTransactions_++;
+
+    bool ok = bus_->writeReg8( registerAddress, value );
+
+    //*** write through to the shadow copy ***
+    if ( registerAddress <= NAU7802_DEVICE_REV && volatileBits(registerAddress) != 0xFF )
+    {
+        shadow_[registerAddress] = value & ~volatileBits(registerAddress);
+        shadowValid_[registerAddress] = ok;
+    }
+
+    return ok;
 }
 
 //*****************************************************************************
@@ -343,7 +494,7 @@ bool NAU7802::setSampleRate(quint8 rate)
   if (rate > 0b111)
     rate = 0b111; //Error check
 
-  quint8 value = getRegister(NAU7802_CTRL2);
+  quint8 value = getCachedRegister(NAU7802_CTRL2);
   value &= 0b10001111; //Clear CRS bits
   value |= rate << 4;  //Mask in new CRS bits
 
@@ -377,7 +528,7 @@ bool NAU7802::powerUp()
   {
     if (getBit(NAU7802_PU_CTRL_PUR, NAU7802_PU_CTRL) == true)
       break; //Good to go
-    delay(1);
+    clock_->sleepMsec(1);
     if (counter++ > 100)
       return (false); //Error
   }
@@ -401,7 +552,8 @@ bool NAU7802::powerDown()
 bool NAU7802::reset()
 {
   setBit(NAU7802_PU_CTRL_RR, NAU7802_PU_CTRL); //Set RR
-  delay(1);
+  memset(shadowValid_, 0, sizeof(shadowValid_)); //Registers are back to their defaults
+  clock_->sleepMsec(1);
   return (clearBit(NAU7802_PU_CTRL_RR, NAU7802_PU_CTRL)); //Clear RR to leave reset state
 }
 
@@ -416,7 +568,7 @@ bool NAU7802::setLDO(quint8 ldoValue)
     ldoValue = 0b111; //Error check
 
   //Set the value of the LDO
-  quint8 value = getRegister(NAU7802_CTRL1);
+  quint8 value = getCachedRegister(NAU7802_CTRL1);
   value &= 0b11000111;    //Clear LDO bits
   value |= ldoValue << 3; //Mask in new LDO bits
   setRegister(NAU7802_CTRL1, value);
@@ -434,7 +586,7 @@ bool NAU7802::setGain(quint8 gainValue)
   if (gainValue > 0b111)
     gainValue = 0b111; //Error check
 
-  quint8 value = getRegister(NAU7802_CTRL1);
+  quint8 value = getCachedRegister(NAU7802_CTRL1);
   value &= 0b11111000; //Clear gain bits
   value |= gainValue;  //Mask in new bits
 
@@ -458,17 +610,62 @@ quint8 NAU7802::getRevisionCode()
 //Assumes CR Cycle Ready bit (ADC conversion complete) has been checked to be 1
 qint32 NAU7802::getReading()
 {
-quint8 msb,midsb,lsb;
+quint8 bytes[3];
+t_RegRead read = { NAU7802_ADCO_B2, bytes, 3 };
 
-    //*** get the three byte values ***
-    msb   = getRegister( NAU7802_ADCO_B2 );
-    midsb = getRegister( NAU7802_ADCO_B1 );
-    lsb   = getRegister( NAU7802_ADCO_B0 );
+    //*** get the three byte values - atomic on combined transfer backends ***
+    if ( !bus_->readBlocks( &read, 1 ) ) return 0;
 
+    return assembleReading( bytes );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+//Reads the CR bit and the 24-bit result
+//With a combined transfer backend this is one bus transaction per sample
+//Returns true if a new reading was read
+bool NAU7802::readConversion( bool checkReady, qint32 &value )
+{
+quint8 ctrl = 0;
+quint8 bytes[3];
+t_RegRead reads[2] = { { NAU7802_PU_CTRL, &ctrl, 1 }, { NAU7802_ADCO_B2, bytes, 3 } };
+
+    //*** data ready line already told us - just the result ***
+    if ( !checkReady )
+    {
+        if ( !bus_->readBlocks( &reads[1], 1 ) ) return false;
+    }
+
+    //*** CR bit and result in one transaction ***
+    else if ( bus_->combinedTransfers() )
+    {
+        if ( !bus_->readBlocks( reads, 2 ) ) return false;
+        if ( ( ctrl & ( 1 << NAU7802_PU_CTRL_CR ) ) == 0 ) return false;
+    }
+
+    //*** separate transactions - don't read the result unless it is ready ***
+    else
+    {
+        if ( !available() ) return false;
+        if ( !bus_->readBlocks( &reads[1], 1 ) ) return false;
+    }
+
+    value = assembleReading( bytes );
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+//Sign extend the 3 ADCO bytes (MSB first) into a 32 bit value
+qint32 NAU7802::assembleReading( const quint8 *bytes )
+{
     //*** assemble them ***
-    quint32 valueRaw = (static_cast<quint32>(msb) << 16) |
-                       (static_cast<quint32>(midsb)  << 8) |
-                        static_cast<quint32>(lsb);
+    quint32 valueRaw = (static_cast<quint32>(bytes[0]) << 16) |
+                       (static_cast<quint32>(bytes[1]) << 8) |
+                        static_cast<quint32>(bytes[2]);
 
     // the raw value coming from the ADC is a 24-bit number, so the sign bit now
     // resides on bit 23 (0 is LSB) of the quint32 container. By shifting the
@@ -486,23 +683,57 @@ quint8 msb,midsb,lsb;
 
 //*****************************************************************************
 //*****************************************************************************
-void NAU7802::takeReading()
+void NAU7802::takeReading( bool checkReady )
 {
-qint32 sample = 0;
+qint32 value;
+int ch = channel_;
+
+    //*** get the 24 bit sample if there is one available ***
+    if ( !readConversion( checkReady, value ) ) return;
+
+    //*** still settling after a channel switch ***
+    if ( settleLeft_ > 0 )
+    {
+        settleLeft_--;
+        discarded_[ch]++;
+        return;
+    }
+
+    qint64 timestamp = clock_->nsecs();
 
-    //*** ensure there is a sample available ***
-    if ( available() )
+    //*** publish it - outliers replaced, then decimated ***
+    if ( addConversion( ch, value, timestamp ) )
     {
-        //*** get the 24 bit sample ***
-        sample = getReading();
+        //*** dual mode - one decimated sample per visit, then the other channel ***
+        if ( config_.dualChannel )
+        {
+            switchChannel();
 
-        //*** save data ***
-        collectedData_.enqueue( sample );
+            //*** both channels fresh once the second one is done ***
+            if ( ch != NAU7802_CHANNEL_2 ) return;
+        }
 
-        //*** limit queue size - get rid of oldest data ***
-        while ( collectedData_.size() > QUEUE_SIZE ) collectedData_.dequeue();
+        sampleAdded( timestamp );
     }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void NAU7802::switchChannel()
+{
+int next = ( channel_ == NAU7802_CHANNEL_1 ) ? NAU7802_CHANNEL_2 : NAU7802_CHANNEL_1;
+qint64 start = clock_->nsecs();
+
+    //*** both channels were calibrated at bring-up - only CHS changes ***
+    setChannel( static_cast<quint8>( next ) );
+
+    switchNsec_[next] += clock_->nsecs() - start;
+    switches_[next]++;
 
+    //*** conversion in progress straddles the switch ***
+    channel_ = next;
+    settleLeft_ = config_.switchSettle;
 }
 
 
@@ -533,12 +764,15 @@ void NAU7802::beginCalibrateAFE()
 //Check calibration status.
 NAU7802_Cal_Status NAU7802::calAFEStatus()
 {
-  if (getBit(NAU7802_CTRL2_CALS, NAU7802_CTRL2))
+  //Both status bits come from one read of CTRL2
+  quint8 value = getRegister(NAU7802_CTRL2);
+
+  if (value & (1 << NAU7802_CTRL2_CALS))
   {
     return NAU7802_CAL_IN_PROGRESS;
   }
 
-  if (getBit(NAU7802_CTRL2_CAL_ERROR, NAU7802_CTRL2))
+  if (value & (1 << NAU7802_CTRL2_CAL_ERROR))
   {
     return NAU7802_CAL_FAILURE;
   }
@@ -555,16 +789,16 @@ NAU7802_Cal_Status NAU7802::calAFEStatus()
 //Returns true if calibration completes succsfully, otherwise returns false.
 bool NAU7802::waitForCalibrateAFE(quint32 timeout_ms)
 {
-  quint32 begin = millis();
+  qint64 begin = clock_->msecs();
   NAU7802_Cal_Status cal_ready;
 
   while ((cal_ready = calAFEStatus()) == NAU7802_CAL_IN_PROGRESS)
   {
-    if ((timeout_ms > 0) && ((millis() - begin) > timeout_ms))
+    if ((timeout_ms > 0) && ((clock_->msecs() - begin) > timeout_ms))
     {
       break;
     }
-    delay(1);
+    clock_->sleepMsec(1);
   }
 
   if (cal_ready == NAU7802_CAL_SUCCESS)
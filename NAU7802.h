@@ -1,12 +1,16 @@
 #ifndef NAU7802_H
 #define NAU7802_H
 
-#include <QList>
-#include <QQueue>
-#include <QTimer>
-#include <QObject>
+#include <atomic>
+#include "ScaleDriver.h"
 
-typedef QList<int> t_DataSet;
+class NAU7802Reader;
+class I2CBus;
+class GpioLine;
+class ScaleClock;
+
+//*** fixed 7 bit i2c address of the chip ***
+const int NAU7802_I2C_ADDR = 0x2A;
 
 //Register Map
 typedef enum
@@ -135,6 +139,8 @@ typedef enum
   NAU7802_CHANNEL_2 = 1,
 } NAU7802_Channels;
 
+const int NAU7802_NUM_CHANNELS = SCALE_MAX_CHANNELS;
+
 //Calibration state
 typedef enum
 {
@@ -143,54 +149,96 @@ typedef enum
   NAU7802_CAL_FAILURE = 2,
 } NAU7802_Cal_Status;
 
+//Bring-up state
+typedef enum
+{
+  NAU7802_BRING_UP_OPEN = 0,      //Open the bus and start a register reset
+  NAU7802_BRING_UP_RESET,         //Leave reset and power up
+  NAU7802_BRING_UP_POWER,         //Waiting for PUR
+  NAU7802_BRING_UP_CALIBRATE,     //Configured, waiting for AFE calibration
+  NAU7802_BRING_UP_READY,         //Converting
+  NAU7802_BRING_UP_FAILED,
+} NAU7802_Bring_Up_State;
+
+
+//Acquisition settings
+typedef struct
+{
+  quint8 sampleRate;    //NAU7802_SPS_xx conversion rate of the chip
+  int outputRate;       //Samples per second after decimation (boxcar average)
+  int weightSamples;    //Decimated samples averaged into each weight
+  t_StabilityConfig stability;  //When a load is considered settled
+  bool dualChannel;     //Alternate between both channels, weight is the sum of the two
+  int switchSettle;     //Conversions thrown away after each channel switch
+} t_NAU7802Config;
+
 
 //************************************************************************
 //************************************************************************
-class NAU7802 : public QObject
+class NAU7802 : public ScaleDriver
 {
     Q_OBJECT
 
 public:
 
     //*** constructor ***
-    NAU7802( int rawTare, double scale );
+    //*** if a data ready line (CRDY pin) is given, conversions are read as they complete ***
+    //*** otherwise the conversion ready bit is polled. Takes ownership of line and bus ***
+    //*** all timing uses the given clock (real time if none) ***
+    NAU7802( int rawTare, double scale, GpioLine *drdyLine = nullptr, I2CBus *bus = nullptr,
+             ScaleClock *clock = nullptr, const t_NAU7802Config &config = defaultConfig() );
 
-    //*** destructor ***
-    ~NAU7802();
+    //*** 20 SPS, no decimation ***
+    static t_NAU7802Config defaultConfig();
 
-    //*** set up the scale ***
-    bool setup();
+    //*** 80 or 320 SPS decimated down to the same output rate ***
+    static t_NAU7802Config highRateConfig( quint8 sampleRate );
 
-    //*** request the current scale weight ***
-    float getWeight();
+    //*** both channels, alternating once per decimated sample ***
+    static t_NAU7802Config dualChannelConfig( quint8 sampleRate );
 
-    //*** collect n samples  ***
-    int collectRawData( int numSamples, t_DataSet &data );
+    //*** conversions per second for a NAU7802_SPS_xx value ***
+    static int samplesPerSecond( quint8 sampleRate );
+
+    //*** destructor ***
+    ~NAU7802();
 
-    //*** collect n samples - reject outliers ***
-    int collectProcessedData( int numSamples, t_DataSet &data );
+    //*** chip name ***
+    QString name() const override { return QString( "NAU7802" ); }
 
-    //*** get the raw average of n samples - reject outliers ***
-    int getRawAvg( int numSamples );
+    //*** start bring-up and sampling in the acquisition thread ***
+    //*** connect to ready()/failed() first ***
+    void start() override;
 
-    //*** set the data used for calibration ***
-    void setCalibrationData( int tareVal, int weightVal, float actualWeight );
+    //*** bring-up finished and samples are being taken ***
+    bool isReady() const override { return bringUpState_.load() == NAU7802_BRING_UP_READY; }
 
-    //*** get the data derived from the calibration ***
-    void getCalibrationData( int &rawTareValue, double &scaleValue );
+    //*** run one bring-up step - called from the acquisition thread ***
+    //*** returns msec until the next step is due, -1 once ready or failed ***
+    int bringUpStep();
 
-    //*** start using a new tare value ***
-    void setTare( int tareVal );
+    //*** data ready line - nullptr when polling (only final once ready) ***
+    GpioLine *dataReadyLine() const { return drdyLine_; }
 
+    //*** enable/disable the register shadow cache (for comparing setup cost) ***
+    void setRegisterCache( bool enable );
 
-public slots:
+    //*** cost of the last bring-up ***
+    int setupTransactions() const { return setupTransactions_; }
+    qint64 setupMsec() const { return setupMsec_; }
 
-    void takeReading();
+    //*** read a sample - called from the acquisition thread ***
+    //*** checkReady = false when the data ready line already reported it ***
+    void takeReading( bool checkReady = true );
 
 private:
 
     bool available();                                        //Returns true if Cycle Ready bit is set (conversion is complete)
     qint32 getReading();                                     //Returns 24-bit reading. Assumes CR Cycle Ready bit (ADC conversion complete) has been checked by .available()
+    bool readConversion(bool checkReady, qint32 &value);     //Read CR bit and 24-bit reading in as few bus transactions as possible. Returns true if a new reading was read
+    static qint32 assembleReading(const quint8 *bytes);      //Sign extend the 3 ADCO bytes into a 32 bit value
+    void switchChannel();                                    //Move to the other channel and start settling
+    int bringUpFailed(const QString &reason);                //Report a bring-up failure. Returns -1 to end bring-up
     bool setGain(quint8 gainValue);                          //Set the gain. x1, 2, 4, 8, 16, 32, 64, 128 are available
     bool setLDO(quint8 ldoValue);                            //Set the onboard Low-Drop-Out voltage regulator to a given value. 2.4, 2.7, 3.0, 3.3, 3.6, 3.9, 4.2, 4.5V are avaialable
     bool setSampleRate(quint8 rate);                         //Set the readings per second. 10, 20, 40, 80, and 320 samples per second is available
@@ -204,7 +252,9 @@ private:
     bool setBit(quint8 bitNumber, quint8 registerAddress);   //Mask & set a given bit within a register
     bool clearBit(quint8 bitNumber, quint8 registerAddress); //Mask & clear a given bit within a register
     bool getBit(quint8 bitNumber, quint8 registerAddress);   //Return a given bit within a register
-    quint8 getRegister(quint8 registerAddress);              //Get contents of a register
+    quint8 getRegister(quint8 registerAddress);              //Get contents of a register from the chip
+    quint8 getCachedRegister(quint8 registerAddress);        //Get contents of a register, non-volatile bits from the shadow copy
+    static quint8 volatileBits(quint8 registerAddress);      //Bits of a register the chip can change on its own
     bool setRegister(quint8 registerAddress, quint8 value);  //Send a given value to be written to given address. Return true if successful
     bool calibrateAFE();                                     //Synchronous calibration of the analog front end of the NAU7802. Returns true if CAL_ERR bit is 0 (no error)
     void beginCalibrateAFE();                                //Begin asynchronous calibration of the analog front end of the NAU7802. Poll for completion with calAFEStatus() or wait with waitForCalibrateAFE().
@@ -216,21 +266,37 @@ private:
     //*** returns the number of samples actually retrieved ***
     int getSamples( int numSamples, t_DataSet &data );
 
-    //*** fd for i2c device ***
-    int nau7802_;
+    //*** i2c device - owned by the acquisition thread after setup ***
+    I2CBus *bus_;
+
+    //*** CRDY data ready line, nullptr when polling ***
+    GpioLine *drdyLine_;
+
+    //*** acquisition settings ***
+    t_NAU7802Config config_;
+
+    //*** channel being converted and conversions left to throw away - acquisition thread only ***
+    int channel_;
+    int settleLeft_;
 
-    //*** samples queue ***
-    QQueue<int> collectedData_;
+    //*** shadow copy of the configuration registers (volatile bits masked off) ***
+    quint8 shadow_[ NAU7802_DEVICE_REV + 1 ];
+    bool shadowValid_[ NAU7802_DEVICE_REV + 1 ];
+    bool useShadow_;
 
-    //*** raw tare value (zero weight) ***
-    int tare_;
+    //*** register transactions issued - for measuring bus utilization ***
+    int regTransactions_;
+    int setupTransactions_;
+    qint64 setupMsec_;
 
-    //*** scale factor to produce desired weight units ***
-    //*** produced as part of calibration
-    double scale_;
+    //*** bring-up progress - stepped by the acquisition thread ***
+    std::atomic<int> bringUpState_;
+    qint64 bringUpStart_;
+    qint64 bringUpDeadline_;
+    int bringUpTransactions_;
 
-    //*** sample collection timer ***
-    QTimer *sampleTimer_;
+    //*** sample acquisition thread ***
+    NAU7802Reader *reader_;
 
 };
 
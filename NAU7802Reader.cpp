@@ -0,0 +1,88 @@
+#include "NAU7802Reader.h"
+#include "NAU7802.h"
+#include "GpioLine.h"
+#include "ScaleClock.h"
+#include <QDebug>
+
+//*** longest expected time between conversions - check the CR bit if exceeded ***
+const int DRDY_TIMEOUT_MSEC = 250;
+
+
+//*****************************************************************************
+//*****************************************************************************
+NAU7802Reader::NAU7802Reader( NAU7802 *scale, ScaleClock *clock, int pollUsec, QObject *parent )
+    : QThread( parent )
+{
+    scale_    = scale;
+    drdyLine_ = nullptr;
+    clock_    = clock;
+    pollUsec_ = pollUsec;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void NAU7802Reader::stop()
+{
+    //*** ask the loop to exit and wait for it ***
+    requestInterruption();
+    wait();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void NAU7802Reader::run()
+{
+    //*** bring the chip up a step at a time - a stop request is seen between steps ***
+    while ( !isInterruptionRequested() )
+    {
+        int waitMsec = scale_->bringUpStep();
+        if ( waitMsec < 0 ) break;
+
+        clock_->sleepMsec( waitMsec );
+    }
+
+    //*** nothing to read if bring-up failed ***
+    if ( !scale_->isReady() ) return;
+
+    //*** data ready line, if it could be opened ***
+    drdyLine_ = scale_->dataReadyLine();
+
+    //*** keep reading until told to stop ***
+    while ( !isInterruptionRequested() )
+    {
+        //*** data ready mode ***
+        if ( drdyLine_ )
+        {
+            int rc = drdyLine_->waitForEdge( DRDY_TIMEOUT_MSEC );
+
+            if ( rc > 0 )
+            {
+                //*** conversion is known to be complete ***
+                scale_->takeReading( false );
+            }
+            else if ( rc == 0 )
+            {
+                //*** no edge - make sure a missed edge doesn't stall us ***
+                scale_->takeReading( true );
+            }
+            else
+            {
+                //*** line failed - fall back to polling ***
+                qDebug() << "Data ready line error, falling back to polling";
+                drdyLine_ = nullptr;
+            }
+        }
+
+        //*** polling mode ***
+        else
+        {
+            //*** grab a sample if one is ready ***
+            scale_->takeReading();
+
+            //*** wait for next conversion ***
+            clock_->sleepNsec( static_cast<qint64>( pollUsec_ ) * 1000 );
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef NAU7802READER_H
+#define NAU7802READER_H
+
+#include <QThread>
+
+class NAU7802;
+class GpioLine;
+class ScaleClock;
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The NAU7802Reader class - acquisition thread for the NAU7802.
+ *
+ *  Once started, this thread is the only code that touches the I2C device.
+ *  It first steps the chip through bring-up, sleeping between steps, so
+ *  nothing waits on the GUI thread. It then sleeps on the CRDY data ready line (or polls for completed conversions
+ *  when there is no line) and pushes each sample into the scale's sample
+ *  ring, independent of anything happening on the GUI thread.
+ */
+//*****************************************************************************
+class NAU7802Reader : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor ***
+    NAU7802Reader( NAU7802 *scale, ScaleClock *clock, int pollUsec, QObject *parent = nullptr );
+
+    //*** stop the thread and wait for it to finish ***
+    void stop();
+
+protected:
+
+    //*** thread main loop ***
+    void run() override;
+
+private:
+
+    //*** scale being read ***
+    NAU7802 *scale_;
+
+    //*** data ready line - nullptr to poll (taken from the scale after bring-up) ***
+    GpioLine *drdyLine_;
+
+    //*** time source for bring-up and polling ***
+    ScaleClock *clock_;
+
+    //*** time between polls of the conversion ready bit ***
+    int pollUsec_;
+};
+
+#endif // NAU7802READER_H
@@ -0,0 +1,422 @@
+#include "Protocol.h"
+#include <QIODevice>
+#include <QDebug>
+#include <string.h>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** parsed bytes are dropped from the front of the buffer once there are this many ***
+const int COMPACT_BYTES = 4096;
+
+
+//*****************************************************************************
+//*****************************************************************************
+static int padded( int size )
+{
+    return ( size + FRAME_ALIGN - 1 ) & ~( FRAME_ALIGN - 1 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ProtocolReader::ProtocolReader()
+{
+    reset();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ProtocolReader::reset()
+{
+    buffer_.clear();
+    pos_         = 0;
+    inFrame_     = false;
+    frameEnd_    = 0;
+    recordsLeft_ = 0;
+    mode_        = PROTOCOL_UNKNOWN;
+    failed_      = false;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ProtocolReader::read( QIODevice *dev )
+{
+qint64 avail = dev->bytesAvailable();
+
+    if ( failed_ || avail <= 0 ) return;
+
+    //*** drop what has been parsed - all parsed, or enough to be worth the move ***
+    if ( pos_ == buffer_.size() || pos_ >= COMPACT_BYTES )
+    {
+        buffer_.remove( 0, pos_ );
+        frameEnd_ -= pos_;
+        pos_ = 0;
+    }
+
+    //*** straight from the socket onto the end of the buffer ***
+    int old = buffer_.size();
+    buffer_.resize( old + static_cast<int>( avail ) );
+    qint64 got = dev->read( buffer_.data() + old, avail );
+    buffer_.resize( old + static_cast<int>( qMax( static_cast<qint64>( 0 ), got ) ) );
+
+    //*** the first bytes of the connection say which framing it uses ***
+    if ( mode_ == PROTOCOL_UNKNOWN && buffer_.size() >= static_cast<int>( sizeof(quint32) ) )
+    {
+        quint32 magic;
+        memcpy( &magic, buffer_.constData(), sizeof(magic) );
+        mode_ = ( magic == FRAME_MAGIC ) ? PROTOCOL_FRAMED : PROTOCOL_LEGACY;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ProtocolReader::fail( const QString &reason )
+{
+    qDebug() << "Protocol error:" << reason;
+    failed_ = true;
+    return false;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ProtocolReader::nextFrame( t_FrameInfo &frame )
+{
+t_FrameHeader header;
+t_RosterSync sync;
+int recordSize;
+
+    if ( failed_ ) return false;
+
+    //*** skip whatever is left of the last frame ***
+    if ( inFrame_ )
+    {
+        pos_ = frameEnd_;
+        inFrame_ = false;
+    }
+
+    //*** fixed size structs - each one is a frame of one check-in ***
+    if ( mode_ == PROTOCOL_LEGACY )
+    {
+        if ( buffer_.size() - pos_ < CHECKIN_SIZE ) return false;
+
+        inFrame_     = true;
+        frameEnd_    = pos_ + CHECKIN_SIZE;
+        recordsLeft_ = 1;
+
+        frame.type    = FRAME_CHECKINS;
+        frame.count   = 1;
+        frame.seq     = 0;
+        frame.baseSeq = 0;
+        return true;
+    }
+
+    if ( mode_ != PROTOCOL_FRAMED ) return false;
+
+    while ( true )
+    {
+        //*** next frame, once it's all here ***
+        if ( buffer_.size() - pos_ < static_cast<int>( sizeof(header) ) ) return false;
+
+        memcpy( &header, buffer_.constData() + pos_, sizeof(header) );
+        if ( header.magic != FRAME_MAGIC ) return fail( QString( "bad frame magic" ) );
+        if ( header.version != PROTOCOL_VERSION ) return fail( QString( "protocol version %1" ).arg( header.version ) );
+        if ( header.length > MAX_FRAME_LENGTH || header.length % FRAME_ALIGN != 0 )
+        {
+            return fail( QString( "bad frame length %1" ).arg( header.length ) );
+        }
+
+        if ( buffer_.size() - pos_ < static_cast<int>( sizeof(header) + header.length ) ) return false;
+
+        int start = pos_ + sizeof(header);
+        frameEnd_ = start + header.length;
+
+        //*** not one the scale takes - step over it ***
+        if ( header.type != FRAME_CHECKINS && header.type != FRAME_SNAPSHOT && header.type != FRAME_DELTA &&
+             header.type != FRAME_SUBSCRIBE && header.type != FRAME_REPORT_ACK )
+        {
+            pos_ = frameEnd_;
+            continue;
+        }
+
+        frame.type    = header.type;
+        frame.seq     = 0;
+        frame.baseSeq = 0;
+
+        //*** roster frames say where they fit in the sequence ***
+        if ( header.type == FRAME_SNAPSHOT || header.type == FRAME_DELTA )
+        {
+            if ( header.length < sizeof(sync) ) return fail( QString( "roster frame too short" ) );
+
+            memcpy( &sync, buffer_.constData() + start, sizeof(sync) );
+            frame.seq     = sync.seq;
+            frame.baseSeq = sync.baseSeq;
+            start += sizeof(sync);
+        }
+
+        //*** a count the payload can't hold is cut to what it can ***
+        if ( header.type == FRAME_SUBSCRIBE ) recordSize = sizeof(t_Subscribe);
+        else if ( header.type == FRAME_REPORT_ACK ) recordSize = sizeof(t_ReportAck);
+        else recordSize = sizeof(t_CheckInRecord);
+        frame.count = static_cast<int>( qMin( header.count, static_cast<quint32>( ( frameEnd_ - start ) / recordSize ) ) );
+
+        inFrame_     = true;
+        recordsLeft_ = frame.count;
+        pos_         = start;
+        return true;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ProtocolReader::nextCheckIn( t_CheckInView &ci )
+{
+t_CheckInRecord rec;
+
+    if ( failed_ || !inFrame_ || recordsLeft_ == 0 ) return false;
+
+    //*** fixed size struct - copied out, the name may not be terminated ***
+    if ( mode_ == PROTOCOL_LEGACY )
+    {
+        memcpy( &legacy_, buffer_.constData() + pos_, CHECKIN_SIZE );
+        pos_ = frameEnd_;
+        recordsLeft_ = 0;
+
+        ci.key      = legacy_.key;
+        ci.numItems = legacy_.numItems;
+        ci.day      = legacy_.day;
+        ci.name     = legacy_.name;
+        ci.nameLen  = static_cast<int>( qstrnlen( legacy_.name, FP_NAME_MAX + 1 ) );
+        return true;
+    }
+
+    //*** the count was cut on the fixed part alone - names can use up the rest ***
+    if ( frameEnd_ - pos_ < static_cast<int>( sizeof(rec) ) )
+    {
+        recordsLeft_ = 0;
+        return false;
+    }
+
+    //*** fixed part is 24 bytes - the name stays where it is ***
+    memcpy( &rec, buffer_.constData() + pos_, sizeof(rec) );
+    int size = padded( sizeof(rec) + rec.nameLen );
+    if ( frameEnd_ - pos_ < size ) return fail( QString( "check-in name runs past the frame" ) );
+
+    ci.key      = rec.key;
+    ci.numItems = rec.numItems;
+    ci.day      = rec.day;
+    ci.name     = buffer_.constData() + pos_ + sizeof(rec);
+    ci.nameLen  = rec.nameLen;
+
+    pos_ += size;
+    recordsLeft_--;
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ProtocolReader::nextRecord( void *record, int size )
+{
+    if ( failed_ || !inFrame_ || recordsLeft_ == 0 || mode_ != PROTOCOL_FRAMED ) return false;
+
+    if ( frameEnd_ - pos_ < size ) return fail( QString( "frame too short for its records" ) );
+
+    memcpy( record, buffer_.constData() + pos_, size );
+    pos_ += size;
+    recordsLeft_--;
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ProtocolReader::nextSubscribe( t_Subscribe &sub )
+{
+    return nextRecord( &sub, sizeof(sub) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ProtocolReader::nextReportAck( t_ReportAck &ack )
+{
+    return nextRecord( &ack, sizeof(ack) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+QString ProtocolReader::toCheckIn( const t_CheckInView &view, t_CheckIn &ci )
+{
+QString name = QString::fromUtf8( view.name, view.nameLen );
+QByteArray utf8 = name.toUtf8();
+
+    //*** cut to fit on a character boundary ***
+    while ( utf8.size() > FP_NAME_MAX )
+    {
+        name.chop( 1 );
+        utf8 = name.toUtf8();
+    }
+
+    memset( &ci, 0, CHECKIN_SIZE );
+    ci.key = view.key;
+    memcpy( ci.name, utf8.constData(), utf8.size() );
+    ci.numItems = view.numItems;
+    ci.day = view.day;
+
+    return name;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+FrameWriter::FrameWriter( int type )
+{
+t_FrameHeader header;
+
+    memset( &header, 0, sizeof(header) );
+    header.magic   = FRAME_MAGIC;
+    header.version = PROTOCOL_VERSION;
+    header.type    = static_cast<quint16>( type );
+
+    frame_.append( reinterpret_cast<const char*>( &header ), sizeof(header) );
+    count_ = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addRecord( const void *record, int size, const char *extra, int extraLen )
+{
+static const char zeros[ FRAME_ALIGN ] = { 0 };
+
+    frame_.append( static_cast<const char*>( record ), size );
+    if ( extraLen > 0 ) frame_.append( extra, extraLen );
+
+    //*** keep the next record aligned ***
+    int pad = padded( size + extraLen ) - ( size + extraLen );
+    if ( pad > 0 ) frame_.append( zeros, pad );
+
+    count_++;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addWeight( int key, float weight, qint64 day, int station, quint32 reportId )
+{
+t_WeightRecord rec;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.key      = key;
+    rec.weight   = weight;
+    rec.day      = day;
+    rec.station  = station;
+    rec.reportId = reportId;
+
+    addRecord( &rec, sizeof(rec) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addWeight( const t_WeightRecord &report )
+{
+    addRecord( &report, sizeof(report) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addCheckIn( int key, int numItems, qint64 day, const QString &name )
+{
+t_CheckInRecord rec;
+QByteArray utf8 = name.toUtf8();
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.key      = key;
+    rec.numItems = numItems;
+    rec.day      = day;
+    rec.nameLen  = static_cast<quint16>( qMin( utf8.size(), 0xffff ) );
+
+    addRecord( &rec, sizeof(rec), utf8.constData(), rec.nameLen );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addAck( quint64 seq, quint32 flags )
+{
+t_RosterAck rec;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.seq   = seq;
+    rec.flags = flags;
+
+    addRecord( &rec, sizeof(rec) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addSubscribe( quint32 topics, int liveHz )
+{
+t_Subscribe rec;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.topics = topics;
+    rec.liveHz = static_cast<quint16>( liveHz );
+
+    addRecord( &rec, sizeof(rec) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addLive( int station, quint8 flags, qint32 value )
+{
+t_LiveRecord rec;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.station = static_cast<quint16>( station );
+    rec.flags   = flags;
+    rec.value   = value;
+
+    addRecord( &rec, sizeof(rec) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void FrameWriter::addReportAck( quint32 reportId )
+{
+t_ReportAck rec;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.reportId = reportId;
+
+    addRecord( &rec, sizeof(rec) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+const QByteArray &FrameWriter::frame()
+{
+t_FrameHeader header;
+
+    //*** fill in the length and count ***
+    memcpy( &header, frame_.constData(), sizeof(header) );
+    header.length = static_cast<quint32>( frame_.size() - sizeof(header) );
+    header.count  = static_cast<quint32>( count_ );
+    memcpy( frame_.data(), &header, sizeof(header) );
+
+    return frame_;
+}
@@ -0,0 +1,387 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+#include <stddef.h>
+
+class QIODevice;
+
+//*****************************************************************************
+//*****************************************************************************
+//
+//  Check-in server <-> scale protocol
+//
+//  Framed (version 2) - both directions
+//
+//    t_FrameHeader     magic, version, type, payload length, record count
+//    payload           'count' records, each padded to an 8 byte boundary
+//
+//    FRAME_CHECKINS    server -> scale, t_CheckInRecord + UTF-8 name (not nul terminated)
+//    FRAME_WEIGHTS     scale -> server, t_WeightRecord
+//    FRAME_SNAPSHOT    server -> scale, t_RosterSync then check-ins - the whole roster
+//    FRAME_DELTA       server -> scale, t_RosterSync then check-ins - changes since baseSeq
+//    FRAME_ROSTER_ACK  scale -> server, t_RosterAck - roster sequence the scale has
+//    FRAME_SUBSCRIBE   client -> scale, t_Subscribe - what to send this connection
+//    FRAME_REPORT_ACK  server -> scale, t_ReportAck - reports stored, up to an id
+//    FRAME_LIVE        scale -> client, t_LiveRecord - weights that changed since the last one
+//
+//  Roster sync - the scale acks the sequence it holds after each batch of
+//  roster frames. A reconnecting server sends the changes since the last
+//  sequence acked as a delta. A delta that doesn't start from the scale's
+//  sequence (the scale restarted, or a delta was lost) is dropped and acked
+//  with ROSTER_ACK_RESYNC, and the server answers with a snapshot.
+//
+//  Several clients can be connected at once - fpSvr plus monitors. Each gets
+//  weight reports unless it subscribes to something else. A client that only
+//  listens should send its FRAME_SUBSCRIBE first, as a connection that hasn't
+//  sent a frame is treated as legacy.
+//
+//  Weight reports are journaled on the scale until fpSvr acks them, and sent
+//  again (in batches) on reconnect or when no ack comes. Report ids only
+//  grow, so a report received twice can be recognized by its id.
+//
+//  Live weights are sent at the rate a client subscribed at, and only for
+//  stations whose weight (hundredths) or flags changed since the last frame
+//  that client got. Values are changes from that frame, except the first
+//  for each station which is flagged LIVE_KEYFRAME. A client that isn't
+//  keeping up misses frames rather than having them queued - the next one
+//  it gets covers everything since the last it got.
+//
+//  Legacy (fixed size) - picked when a connection doesn't start with FRAME_MAGIC
+//
+//    server -> scale   t_CheckIn structs back to back
+//    scale -> server   t_WeightReport, or t_StationWeightReport with several stations
+//
+//  All fields are little endian (native on the Pi). Frames of an unknown type
+//  are skipped, so new types can be added without breaking older scales.
+//
+//*****************************************************************************
+
+//*****************
+//*** LEGACY ***
+//*****************
+
+const int FP_NAME_MAX = 127;
+
+typedef struct
+{
+    int key;
+    char name[FP_NAME_MAX+1];
+    int  numItems;
+    qint64 day;
+} t_CheckIn;
+
+typedef struct
+{
+    quint32 magic;
+    quint32 size;
+    quint32 type;
+    int     key;
+    float   weight;
+    qint64  day;
+} t_WeightReport;
+
+const int MAGIC_VAL = 0x3e3e3e3e;
+
+const int CHECKIN_SIZE = sizeof( t_CheckIn );
+
+const int WEIGHT_REPORT_SIZE = sizeof( t_WeightReport );
+const int WEIGHT_SIZE_FIELD = WEIGHT_REPORT_SIZE - ( 2 * sizeof(quint32) );
+const int WEIGHT_REPORT_TYPE = 0x0001;
+
+//*** weight report from one of several stations ***
+typedef struct
+{
+    quint32 magic;
+    quint32 size;
+    quint32 type;
+    int     key;
+    float   weight;
+    qint64  day;
+    int     station;
+} t_StationWeightReport;
+
+const int STATION_REPORT_SIZE = sizeof( t_StationWeightReport );
+const int STATION_SIZE_FIELD = STATION_REPORT_SIZE - ( 2 * sizeof(quint32) );
+const int STATION_REPORT_TYPE = 0x0002;
+
+//*** the server was built with the same compiler (padding included) ***
+static_assert( sizeof( t_CheckIn ) == 144, "legacy check-in layout changed" );
+static_assert( sizeof( t_WeightReport ) == 32, "legacy weight report layout changed" );
+static_assert( sizeof( t_StationWeightReport ) == 40, "legacy station report layout changed" );
+
+
+//*****************
+//*** FRAMED ***
+//*****************
+
+const quint32 FRAME_MAGIC      = 0x32465046;    // "FPF2"
+const quint16 PROTOCOL_VERSION = 2;
+
+//*** payloads and records are padded to this ***
+const int FRAME_ALIGN = 8;
+
+//*** anything longer is a broken stream ***
+const quint32 MAX_FRAME_LENGTH = 1024 * 1024;
+
+//*** frame types ***
+typedef enum
+{
+    FRAME_CHECKINS   = 1,
+    FRAME_WEIGHTS    = 2,
+    FRAME_SNAPSHOT   = 3,
+    FRAME_DELTA      = 4,
+    FRAME_ROSTER_ACK = 5,
+    FRAME_SUBSCRIBE  = 6,
+    FRAME_REPORT_ACK = 7,
+    FRAME_LIVE       = 8,
+} Frame_Type;
+
+//*** t_Subscribe topics ***
+typedef enum
+{
+    SUBSCRIBE_REPORTS = 0x0001,     // weight report when a person is done
+    SUBSCRIBE_LIVE    = 0x0002,     // weights as they change, at liveHz
+} Subscribe_Topics;
+
+//*** live weight rates - default if none asked for, fastest sent ***
+const int LIVE_DEFAULT_HZ = 5;
+const int LIVE_MAX_HZ     = 20;
+
+//*** t_LiveRecord flags ***
+const quint8 LIVE_STABLE    = 0x01;     // load has settled
+const quint8 LIVE_KEYFRAME  = 0x02;     // value is the weight, not a change
+const quint8 LIVE_NO_WEIGHT = 0x04;     // station has no weight yet
+
+//*** what a connection gets until it subscribes ***
+const quint32 DEFAULT_SUBSCRIPTIONS = SUBSCRIBE_REPORTS;
+
+//*** t_RosterAck flags ***
+const quint32 ROSTER_ACK_RESYNC = 0x0001;    // a delta didn't apply - send a snapshot
+
+//*** framing of a connection ***
+typedef enum
+{
+    PROTOCOL_UNKNOWN = 0,   // nothing received yet
+    PROTOCOL_LEGACY  = 1,   // fixed size structs
+    PROTOCOL_FRAMED  = 2,   // t_FrameHeader frames
+} Protocol_Mode;
+
+typedef struct
+{
+    quint32 magic;          // FRAME_MAGIC
+    quint16 version;        // PROTOCOL_VERSION
+    quint16 type;           // FRAME_xx
+    quint32 length;         // payload bytes after the header, a multiple of FRAME_ALIGN
+    quint32 count;          // records in the payload
+} t_FrameHeader;
+
+//*** one check-in - the name follows ***
+typedef struct
+{
+    qint32  key;
+    qint32  numItems;       // 0 removes the person
+    qint64  day;
+    quint16 nameLen;        // bytes of UTF-8 name after this struct
+    quint16 reserved;
+    quint32 reserved2;
+} t_CheckInRecord;
+
+//*** one weight - one per station used ***
+typedef struct
+{
+    qint32  key;
+    float   weight;
+    qint64  day;
+    qint32  station;        // station id, 0 with a single scale
+    quint32 reportId;       // journal id, acked with FRAME_REPORT_ACK
+} t_WeightRecord;
+
+//*** start of a roster frame payload, before the check-ins ***
+typedef struct
+{
+    quint64 seq;            // roster sequence once this frame is applied
+    quint64 baseSeq;        // delta - sequence it applies on top of (0 in a snapshot)
+} t_RosterSync;
+
+//*** roster sequence held by the scale ***
+typedef struct
+{
+    quint64 seq;
+    quint32 flags;          // ROSTER_ACK_xx
+    quint32 reserved;
+} t_RosterAck;
+
+//*** topics a connection wants - replaces what it had ***
+typedef struct
+{
+    quint32 topics;         // SUBSCRIBE_xx
+    quint16 liveHz;         // SUBSCRIBE_LIVE rate, 0 for LIVE_DEFAULT_HZ
+    quint16 reserved;
+} t_Subscribe;
+
+//*** one station's live weight ***
+typedef struct
+{
+    quint16 station;        // station id, 0 with a single scale
+    quint8  flags;          // LIVE_xx
+    quint8  reserved;
+    qint32  value;          // hundredths - change since the last record, the weight with LIVE_KEYFRAME
+} t_LiveRecord;
+
+//*** every report up to and including reportId is stored ***
+typedef struct
+{
+    quint32 reportId;
+    quint32 reserved;
+} t_ReportAck;
+
+static_assert( sizeof( t_FrameHeader ) == 16, "frame header layout changed" );
+static_assert( offsetof( t_FrameHeader, length ) == 8, "frame header layout changed" );
+static_assert( sizeof( t_CheckInRecord ) == 24, "check-in record layout changed" );
+static_assert( offsetof( t_CheckInRecord, day ) == 8 && offsetof( t_CheckInRecord, nameLen ) == 16,
+               "check-in record layout changed" );
+static_assert( sizeof( t_WeightRecord ) == 24, "weight record layout changed" );
+static_assert( offsetof( t_WeightRecord, day ) == 8 && offsetof( t_WeightRecord, station ) == 16,
+               "weight record layout changed" );
+static_assert( sizeof( t_RosterSync ) == 16 && sizeof( t_RosterAck ) == 16, "roster record layout changed" );
+static_assert( sizeof( t_Subscribe ) == 8 && sizeof( t_ReportAck ) == 8, "subscribe/ack record layout changed" );
+static_assert( sizeof( t_LiveRecord ) == 8 && offsetof( t_LiveRecord, value ) == 4, "live record layout changed" );
+static_assert( sizeof( t_FrameHeader ) % FRAME_ALIGN == 0 && sizeof( t_CheckInRecord ) % FRAME_ALIGN == 0 &&
+               sizeof( t_WeightRecord ) % FRAME_ALIGN == 0 && sizeof( t_RosterSync ) % FRAME_ALIGN == 0 &&
+               sizeof( t_RosterAck ) % FRAME_ALIGN == 0 && sizeof( t_Subscribe ) % FRAME_ALIGN == 0 &&
+               sizeof( t_ReportAck ) % FRAME_ALIGN == 0 && sizeof( t_LiveRecord ) % FRAME_ALIGN == 0,
+               "records must keep the payload aligned" );
+
+//*** a check-in as parsed - name points into the reader's buffer ***
+typedef struct
+{
+    qint32 key;
+    qint32 numItems;
+    qint64 day;
+    const char *name;       // UTF-8, not nul terminated
+    int nameLen;
+} t_CheckInView;
+
+//*** a received frame - a legacy check-in reads as a FRAME_CHECKINS frame of one ***
+typedef struct
+{
+    int type;               // FRAME_xx
+    int count;              // records - no more than the payload holds
+    quint64 seq;            // roster frames only
+    quint64 baseSeq;
+} t_FrameInfo;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ProtocolReader class - frames from a client, either framing.
+ *
+ *  Bytes are read straight from the socket into one buffer that is reused
+ *  for the whole connection. Check-ins are handed out as views into that
+ *  buffer - nothing is copied per record. A view is good until the next
+ *  call to read().
+ *
+ *  The framing is picked from the first four bytes of the connection.
+ *  Frames a scale doesn't take (unknown types, weight reports) are skipped.
+ */
+//*****************************************************************************
+class ProtocolReader
+{
+public:
+
+    //*** constructor ***
+    ProtocolReader();
+
+    //*** start over for a new connection ***
+    void reset();
+
+    //*** take whatever has arrived on the device ***
+    void read( QIODevice *dev );
+
+    //*** next complete frame - false if there isn't one yet (or the stream is broken) ***
+    //*** records of the previous frame not taken are skipped ***
+    bool nextFrame( t_FrameInfo &frame );
+
+    //*** next check-in of the current frame - false at the end of it ***
+    bool nextCheckIn( t_CheckInView &ci );
+
+    //*** next subscription / report ack of the current frame - false at the end of it ***
+    bool nextSubscribe( t_Subscribe &sub );
+    bool nextReportAck( t_ReportAck &ack );
+
+    //*** fill a legacy struct from a view - returns the name, cut to FP_NAME_MAX bytes ***
+    static QString toCheckIn( const t_CheckInView &view, t_CheckIn &ci );
+
+    //*** framing of this connection ***
+    int mode() const { return mode_; }
+
+    //*** a frame that can't be right was received - drop the connection ***
+    bool failed() const { return failed_; }
+
+private:
+
+    //*** mark the stream broken - returns false ***
+    bool fail( const QString &reason );
+
+    //*** next fixed size record of the current frame ***
+    bool nextRecord( void *record, int size );
+
+    //*** bytes received, and where parsing is up to ***
+    QByteArray buffer_;
+    int pos_;
+
+    //*** frame being parsed ***
+    bool inFrame_;
+    int frameEnd_;
+    quint32 recordsLeft_;
+
+    //*** legacy record being handed out ***
+    t_CheckIn legacy_;
+
+    int mode_;
+    bool failed_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The FrameWriter class - builds one frame of records.
+ */
+//*****************************************************************************
+class FrameWriter
+{
+public:
+
+    //*** start a frame of the given FRAME_xx type ***
+    explicit FrameWriter( int type );
+
+    //*** add records ***
+    void addWeight( int key, float weight, qint64 day, int station, quint32 reportId = 0 );
+    void addWeight( const t_WeightRecord &report );
+    void addCheckIn( int key, int numItems, qint64 day, const QString &name );
+    void addAck( quint64 seq, quint32 flags );
+    void addSubscribe( quint32 topics, int liveHz = 0 );
+    void addLive( int station, quint8 flags, qint32 value );
+    void addReportAck( quint32 reportId );
+
+    //*** records added so far ***
+    int count() const { return count_; }
+
+    //*** the finished frame, ready to write ***
+    const QByteArray &frame();
+
+private:
+
+    //*** add a record and pad it to FRAME_ALIGN ***
+    void addRecord( const void *record, int size, const char *extra = nullptr, int extraLen = 0 );
+
+    QByteArray frame_;
+    int count_;
+};
+
+#endif // PROTOCOL_H
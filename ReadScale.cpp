@@ -1,72 +1,1515 @@
+#include "NAU7802.h"
 #include "HX711.h"
-#include <wiringPi.h>
+#include "HX711Port.h"
+#include "SimNAU7802.h"
+#include "SimHX711.h"
+#include "ReplayDriver.h"
+#include "CaptureWriter.h"
+#include "ScaleRegistry.h"
+#include "ScaleClock.h"
+#include "I2CBus.h"
+#include "GpioLine.h"
+#include "MockI2CBus.h"
+#include "MockGpioLine.h"
+#include "ConnectionManager.h"
+#include "HampelFilter.h"
+#include <QCoreApplication>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QFile>
+#include <QDir>
+#include <QVector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <new>
+#include <random>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-int main(void)
-{
-int raw = 0;
-long total = 0;
-long numSamples = 30;
-    
-    wiringPiSetupGpio() ;
-
-    HX711_init( 21, 20, -267362, 0.00022527 );
-    
-    HX711_setCalibrationData( -267362, 61112, 29.922 );
-    
-
-    delay(100);
-    
-#if 0    
-    for ( int i=0; i<10; i++ )
-    {
-        int raw = HX711_getRawReading();
-        total += raw;
-        printf( "%d\n", raw );
-        delay(300);
-    }
-    printf( "Avg: %d\n", total / 10 );
-#endif
-    
-    while ( 1 )
-    {
-        float weight = HX711_getWeight();
-        
-        printf( "weight: %.1f\n", weight );
-        
-        delay( 300 );
-    }
-
-#if 0
-    printf( "Nothing on scale, press enter\n" );
-    scanf("");
-    
-    for ( int i=0; i<numSamples; i++ )
-    {
-        total += HX711_getRawReading();
-        delay( 150 );
-    }
-    int tareAvg = (int)(total / numSamples);
-    printf( "Tare: %d\nPut weight on scale\n", tareAvg );
-    delay(5);
-    
-    total = 0;
-    for ( int i=0; i<numSamples; i++ )
-    {
-        total += HX711_getRawReading();
-        delay( 150 );
-    }
-    int scaleAvg = (int)(total / numSamples);
-    float scale = 4.024 / (float)(scaleAvg - tareAvg);
-    printf( "scaleAvg: %d  Scale: %.6f\n", scaleAvg, scale );
-    
-//    for ( int i=0; i<1000; i++ )
-//    {
-//        raw = HX711_getRawReading();
-//        
-//        printf( "Reading %d: %d\n", i+1, raw );
-//        
-//        delay(150);
-//    }
-#endif
+//*****************************************************************************
+//*****************************************************************************
+//
+//  ReadScale - headless scale diagnostics
+//
+//  Runs one scale (real, simulated or a replayed capture) for a while, then
+//  reports what it achieved: conversion rate, dropped conversions, I2C
+//  transaction latency, noise (standard and Allan deviation) and the settle
+//  time of each load. Used to pick gain, SPS and filter settings for a
+//  station without the GUI.
+//
+//  Every conversion is captured while running and the report is worked out
+//  from the capture afterwards, so sampling isn't disturbed by the analysis.
+//
+//  --bench times the weight processing instead: the shared ScaleDriver
+//  pipeline both chips feed, the GUI's weight calls and formatting, over
+//  synthetic streams (or a capture) at several rates and window sizes,
+//  and the Hampel outlier filter against the old sort + median/10 path.
+//  Allocations are counted by replacing the global operator new.
+//
+//  --load-clients N load tests the scale's TCP server instead: N local
+//  clients (fpSvr, framed and legacy report clients, monitors) connect,
+//  the roster is sent, weight reports are fanned out and the clients
+//  disconnect, checking what each one got and the connection state.
+//
+//  --bus-check runs the NAU7802 driver against the mock register file,
+//  polling and with a data ready line, over combined and per register
+//  transfers, and checks the bus transactions each conversion costs.
+//
+//*****************************************************************************
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+const QString GPIO_CHIP = "/dev/gpiochip0";
+
+const int DEFAULT_SECONDS = 30;
+
+//*** I2C latency histogram - 1 usec buckets, anything longer lands in the last ***
+const int LATENCY_BUCKETS = 20000;
+
+//*** a gap this many conversion periods long means conversions were missed ***
+const double GAP_PERIODS = 1.5;
+
+//*** smallest number of clusters an Allan deviation is worked out from ***
+const int MIN_ALLAN_CLUSTERS = 3;
+
+//*** benchmark streams - 60 sec, load stepped on half way through ***
+const int    BENCH_SECONDS   = 60;
+const double BENCH_STEP_LOAD = 20.0;
+const int    BENCH_OFFSET    = 267362;
+const double BENCH_SCALE     = -1.0 / 4439.0;
+const double BENCH_NOISE     = 40.0;
+const int    BENCH_CALLS     = 100000;
+const int    BENCH_OUTPUT_RATE = 10;
+
+//*** settled once within this fraction of the step ***
+const double BENCH_SETTLED   = 0.01;
+
+//*** outlier filter A/B - windows used at 20/80/320 SPS, the pipeline's threshold, spikes added ***
+const int    BENCH_FILTER_WINDOWS[] = { 5, 11, 41 };
+const double BENCH_OUTLIER_K     = 3.0;
+const int    BENCH_OUTLIER_MIN   = 100;
+const int    BENCH_SPIKE_EVERY   = 50;
+const int    BENCH_SPIKE_COUNTS  = 2000;
+
+//*** load test - roster sent by the fpSvr client, reports fanned out, how long to wait for each step ***
+const int LOAD_ROSTER  = 500;
+const int LOAD_REPORTS = 200;
+const int LOAD_WAIT_MSEC = 10000;
+const int LOAD_STATIONS   = 2;
+const int LOAD_LIVE_TICKS = 40;
+
+//*** bus check - conversions read in each mode, longest to wait for a data ready edge ***
+const int BUS_CHECK_CONVERSIONS = 200;
+const int BUS_CHECK_EDGE_MSEC   = 100;
+
+//*** allocations made by this program - see operator new below ***
+static std::atomic<quint64> allocations( 0 );
+
+
+//*** run settings from the command line ***
+typedef struct
+{
+    t_StationConfig station;  // driver, wiring and calibration
+    int    sps;               // conversion rate, 0 for the driver default
+    int    outputRate;        // decimated rate, 0 for the driver default
+    int    weightSamples;     // decimated samples per weight, 0 for the driver default
+    int    seconds;           // how long to sample
+    double stepLoad;          // load put on the simulated scale half way through, 0 for none
+    QString capturePath;      // keep the capture here, empty to throw it away
+} t_RunConfig;
+
+//*** what happened while running ***
+typedef struct
+{
+    qint64 startNsec;
+    qint64 stepNsec;          // when the load was put on, -1 for no step
+    quint64 discarded;        // conversions thrown away while settling after a switch
+    quint64 captureDropped;   // conversions the capture writer fell behind on
+    quint64 simOverruns;      // conversions the simulated chip replaced before they were read
+    QList<float> stableWeights;
+    QList<int> settleMsecs;
+} t_RunResult;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The LatencyStats class - histogram of bus transaction times.
+ *
+ *  Written only by the acquisition thread, read once it has stopped.
+ */
+//*****************************************************************************
+class LatencyStats
+{
+public:
+
+    LatencyStats() : buckets_( LATENCY_BUCKETS, 0 ) { count_ = 0; maxNsec_ = 0; }
+
+    void add( qint64 nsec )
+    {
+        buckets_[ qBound( static_cast<qint64>( 0 ), nsec / 1000, static_cast<qint64>( LATENCY_BUCKETS - 1 ) ) ]++;
+        maxNsec_ = qMax( maxNsec_, nsec );
+        count_++;
+    }
+
+    //*** upper edge of the bucket holding the given fraction of transactions ***
+    double percentileUsec( double fraction ) const
+    {
+        quint64 target = static_cast<quint64>( std::ceil( fraction * count_ ) );
+        quint64 total = 0;
+
+        for ( int i=0; i<LATENCY_BUCKETS; i++ )
+        {
+            total += buckets_[i];
+            if ( total >= target ) return i + 1;
+        }
+        return LATENCY_BUCKETS;
+    }
+
+    quint64 count() const { return count_; }
+    double maxUsec() const { return maxNsec_ / 1000.0; }
+
+private:
+
+    QVector<quint32> buckets_;
+    quint64 count_;
+    qint64 maxNsec_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The TimedI2CBus class - times every transaction of another bus.
+ */
+//*****************************************************************************
+class TimedI2CBus : public I2CBus
+{
+public:
+
+    //*** takes ownership of the bus ***
+    TimedI2CBus( I2CBus *bus, LatencyStats *stats ) { bus_ = bus; stats_ = stats; }
+    ~TimedI2CBus() override { delete bus_; }
+
+    bool open() override { return bus_->open(); }
+    bool combinedTransfers() const override { return bus_->combinedTransfers(); }
+
+    int readReg8( quint8 reg ) override
+    {
+        qint64 start = ScaleClock::system()->nsecs();
+        int value = bus_->readReg8( reg );
+        stats_->add( ScaleClock::system()->nsecs() - start );
+        return value;
+    }
+
+    bool writeReg8( quint8 reg, quint8 value ) override
+    {
+        qint64 start = ScaleClock::system()->nsecs();
+        bool ok = bus_->writeReg8( reg, value );
+        stats_->add( ScaleClock::system()->nsecs() - start );
+        return ok;
+    }
+
+    bool readBlocks( t_RegRead *reads, int numReads ) override
+    {
+        qint64 start = ScaleClock::system()->nsecs();
+        bool ok = bus_->readBlocks( reads, numReads );
+        stats_->add( ScaleClock::system()->nsecs() - start );
+        return ok;
+    }
+
+private:
+
+    I2CBus *bus_;
+    LatencyStats *stats_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+static quint8 nauRateCode( int sps )
+{
+    switch ( sps )
+    {
+        case 10:  return NAU7802_SPS_10;
+        case 40:  return NAU7802_SPS_40;
+        case 80:  return NAU7802_SPS_80;
+        case 320: return NAU7802_SPS_320;
+        default:  return NAU7802_SPS_20;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+static int hx711GainCode( int gain )
+{
+    if ( gain == 64 ) return HX711_GAIN_A64;
+    if ( gain == 32 ) return HX711_GAIN_B32;
+    return HX711_GAIN_A128;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief createScale - builds the scale described by the run settings
+ * @param run - run settings
+ * @param latency - filled in with the I2C transaction times (NAU7802 only)
+ * @param simNau, simHx - set to the simulated chip, if one is used
+ * @return the scale
+ */
+//*****************************************************************************
+static ScaleDriver *createScale( const t_RunConfig &run, LatencyStats *latency,
+                                 SimNAU7802 *&simNau, SimHX711 *&simHx )
+{
+const t_StationConfig &config = run.station;
+GpioLine *drdyLine = nullptr;
+I2CBus *bus;
+HX711Port *port;
+
+    simNau = nullptr;
+    simHx  = nullptr;
+
+    //*** a recorded day, as fast as it will go ***
+    if ( !config.replayFile.isEmpty() )
+    {
+        return new ReplayDriver( config.replayFile, 0.0, config.tare[0], config.scale[0] );
+    }
+
+    if ( config.driver == SCALE_DRIVER_HX711 )
+    {
+        if ( config.sim )
+        {
+            simHx = new SimHX711( ScaleClock::system(), SimHX711::defaultSignal(), run.sps > 0 ? run.sps : 10 );
+            port = simHx;
+        }
+        else if ( config.hx711Port == HX711_PORT_GPIOMEM )
+        {
+            port = new GpioMemHX711Port( config.hx711Dt, config.hx711Sck,
+                                         new GpioChipLine( GPIO_CHIP, config.hx711Dt ) );
+        }
+        else
+        {
+            port = new GpioChipHX711Port( GPIO_CHIP, config.hx711Dt, config.hx711Sck );
+        }
+
+        return new HX711( port, config.tare[0], config.scale[0], config.hx711Gain );
+    }
+
+    //*** NAU7802 - real or simulated bus, timed either way ***
+    if ( config.sim )
+    {
+        simNau = new SimNAU7802( ScaleClock::system(), SimNAU7802::defaultSignal() );
+        drdyLine = simNau->createDrdyLine();
+        if ( config.dualChannel ) simNau->setChannel2( SimNAU7802::defaultSignal(), 0.5 );
+        bus = simNau;
+    }
+    else if ( config.i2cBus >= 0 )
+    {
+        bus = new I2CDevBus( config.i2cBus, config.i2cAddr );
+    }
+    else
+    {
+        bus = new WiringPiI2CBus( config.i2cAddr );
+    }
+
+    if ( config.drdyGpio >= 0 && !drdyLine ) drdyLine = new GpioChipLine( GPIO_CHIP, config.drdyGpio );
+
+    quint8 rate = nauRateCode( run.sps );
+    t_NAU7802Config scaleConfig = NAU7802::defaultConfig();
+    if ( config.dualChannel )
+    {
+        scaleConfig = NAU7802::dualChannelConfig( rate );
+    }
+    else if ( rate == NAU7802_SPS_80 || rate == NAU7802_SPS_320 )
+    {
+        scaleConfig = NAU7802::highRateConfig( rate );
+    }
+    scaleConfig.sampleRate = rate;
+
+    //*** filter settings being tried out ***
+    if ( run.outputRate > 0 ) scaleConfig.outputRate = run.outputRate;
+    if ( run.weightSamples > 0 ) scaleConfig.weightSamples = run.weightSamples;
+
+    NAU7802 *scale = new NAU7802( config.tare[0], config.scale[0], drdyLine,
+                                  new TimedI2CBus( bus, latency ), nullptr, scaleConfig );
+    scale->setCalibration( SCALE_CHANNEL_2, config.tare[1], config.scale[1] );
+
+    return scale;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief allanDeviation - Allan deviation of a sample series
+ * @param values - samples, evenly spaced
+ * @param m - samples averaged into each cluster
+ * @return the deviation, -1 if there aren't enough clusters
+ */
+//*****************************************************************************
+static double allanDeviation( const QVector<qint32> &values, int m )
+{
+int clusters = values.size() / m;
+double prev = 0.0;
+double sum = 0.0;
+
+    if ( clusters < MIN_ALLAN_CLUSTERS ) return -1.0;
+
+    for ( int k=0; k<clusters; k++ )
+    {
+        double total = 0.0;
+        for ( int i=0; i<m; i++ ) total += values[ k * m + i ];
+
+        double avg = total / m;
+        if ( k > 0 ) sum += ( avg - prev ) * ( avg - prev );
+        prev = avg;
+    }
+
+    return std::sqrt( sum / ( 2.0 * ( clusters - 1 ) ) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief report - works out and prints the results from the capture
+ * @param path - capture file
+ * @param run - run settings, for the calibration
+ * @param result - what happened while running
+ * @param latency - I2C transaction times
+ * @return true if the capture could be read
+ */
+//*****************************************************************************
+static bool report( const QString &path, const t_RunConfig &run, const t_RunResult &result,
+                    const LatencyStats &latency )
+{
+QFile file( path );
+t_CaptureHeader header;
+QVector<qint32> quiet;
+quint64 numRecords;
+quint64 missed = 0;
+double mean = 0.0;
+double m2 = 0.0;
+
+    if ( !file.open( QIODevice::ReadOnly ) ||
+         file.read( reinterpret_cast<char*>( &header ), sizeof(header) ) != sizeof(header) ||
+         header.magic != CAPTURE_MAGIC || header.recordSize != sizeof( t_CaptureRecord ) ||
+         header.headerSize < sizeof( t_CaptureHeader ) || header.headerSize > static_cast<quint64>( file.size() ) )
+    {
+        printf( "Can't read capture %s\n", qPrintable( path ) );
+        return false;
+    }
+
+    numRecords = ( static_cast<quint64>( file.size() ) - header.headerSize ) / header.recordSize;
+    const t_CaptureRecord *records = nullptr;
+    if ( numRecords > 0 )
+    {
+        records = reinterpret_cast<const t_CaptureRecord*>( file.map( header.headerSize, numRecords * header.recordSize ) );
+        if ( !records ) numRecords = 0;
+    }
+
+    //*** rate over the span of the conversions - leaves out bring-up, and works for replays ***
+    double seconds = ( numRecords > 1 ) ? ( records[numRecords - 1].timestamp - records[0].timestamp ) / 1.0e9 : 0.0;
+    seconds = qMax( 1.0e-3, seconds );
+    double periodNsec = 1.0e9 / qMax( 1u, header.sampleRate );
+    double scale = run.station.scale[0];
+
+    //*** gaps in the conversion stream, and the channel 1 samples before any step ***
+    quiet.reserve( static_cast<int>( numRecords ) );
+    for ( quint64 i=0; i<numRecords; i++ )
+    {
+        if ( i > 0 )
+        {
+            double gap = static_cast<double>( records[i].timestamp - records[i - 1].timestamp );
+            if ( gap > GAP_PERIODS * periodNsec ) missed += static_cast<quint64>( std::llround( gap / periodNsec ) ) - 1;
+        }
+
+        if ( records[i].channel != SCALE_CHANNEL_1 ) continue;
+        if ( result.stepNsec >= 0 && records[i].timestamp >= result.stepNsec ) continue;
+
+        //*** running mean and variance ***
+        quiet.append( records[i].value );
+        double delta = records[i].value - mean;
+        mean += delta / quiet.size();
+        m2 += delta * ( records[i].value - mean );
+    }
+
+    //*** switch settling shows up as gaps too ***
+    missed = ( missed > result.discarded ) ? missed - result.discarded : 0;
+
+    printf( "\n%s, %u channel(s), %u SPS -> %u SPS, %u samples per weight\n", header.chip, header.numChannels,
+            header.sampleRate, header.outputRate, header.weightSamples );
+
+    printf( "\nRate\n" );
+    printf( "  conversions      %llu in %.1f sec\n", static_cast<unsigned long long>( numRecords ), seconds );
+    printf( "  achieved         %.2f SPS (%.1f%% of %u)\n", numRecords / seconds,
+            100.0 * numRecords / seconds / qMax( 1u, header.sampleRate ), header.sampleRate );
+    printf( "  missed           %llu (gaps in the timestamps)\n", static_cast<unsigned long long>( missed ) );
+    printf( "  switch settling  %llu discarded\n", static_cast<unsigned long long>( result.discarded ) );
+    if ( result.captureDropped > 0 ) printf( "  capture dropped  %llu\n", static_cast<unsigned long long>( result.captureDropped ) );
+    if ( result.simOverruns > 0 ) printf( "  sim overruns     %llu\n", static_cast<unsigned long long>( result.simOverruns ) );
+
+    if ( latency.count() > 0 )
+    {
+        printf( "\nI2C transactions  %llu\n", static_cast<unsigned long long>( latency.count() ) );
+        printf( "  p50 %.0f usec  p90 %.0f usec  p99 %.0f usec  p99.9 %.0f usec  max %.0f usec\n",
+                latency.percentileUsec( 0.50 ), latency.percentileUsec( 0.90 ), latency.percentileUsec( 0.99 ),
+                latency.percentileUsec( 0.999 ), latency.maxUsec() );
+    }
+
+    //*** noise of the unloaded (or unchanged) scale ***
+    if ( quiet.size() > 1 )
+    {
+        double sd = std::sqrt( m2 / ( quiet.size() - 1 ) );
+        double chanRate = static_cast<double>( header.sampleRate ) / qMax( 1u, header.numChannels );
+
+        printf( "\nNoise, channel 1, %d conversions\n", quiet.size() );
+        printf( "  mean             %.1f counts\n", mean );
+        printf( "  std deviation    %.1f counts  %.4f units\n", sd, sd * std::fabs( scale ) );
+        printf( "  Allan deviation\n" );
+        for ( int m=1; ; m*=2 )
+        {
+            double adev = allanDeviation( quiet, m );
+            if ( adev < 0.0 ) break;
+            printf( "    tau %8.3f sec  %9.2f counts  %.5f units\n", m / chanRate, adev, adev * std::fabs( scale ) );
+        }
+    }
+
+    //*** each load settling ***
+    printf( "\nSettled loads     %d\n", result.stableWeights.size() );
+    for ( int i=0; i<result.stableWeights.size(); i++ )
+    {
+        printf( "  %8.2f units after %d msec\n", result.stableWeights[i], result.settleMsecs[i] );
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void *operator new( size_t size )
+{
+    allocations++;
+
+    void *p = malloc( size ? size : 1 );
+    if ( !p ) throw std::bad_alloc();
+    return p;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void operator delete( void *p ) noexcept
+{
+    free( p );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void operator delete( void *p, size_t size ) noexcept
+{
+Q_UNUSED( size )
+
+    free( p );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The BenchDriver class - a scale fed straight from a sample stream.
+ *
+ *  Runs the same ScaleDriver pipeline as the NAU7802 and HX711 drivers.
+ */
+//*****************************************************************************
+class BenchDriver : public ScaleDriver
+{
+public:
+
+    BenchDriver( int sps, int weightSamples ) : ScaleDriver( BENCH_OFFSET, BENCH_SCALE )
+    {
+        setupPipeline( sps, BENCH_OUTPUT_RATE, weightSamples, 1, StabilityDetector::defaultConfig() );
+    }
+
+    QString name() const override { return QString( "bench" ); }
+    void start() override {}
+    bool isReady() const override { return true; }
+
+    //*** one conversion through the pipeline - true if it made a decimated sample ***
+    bool feed( qint32 value, qint64 timestamp )
+    {
+        if ( !addConversion( SCALE_CHANNEL_1, value, timestamp ) ) return false;
+        sampleAdded( timestamp );
+        return true;
+    }
+};
+
+
+//*** a stream of conversions to benchmark with ***
+typedef struct
+{
+    QVector<qint32> values;
+    QVector<qint64> times;
+    int sps;
+    qint64 stepNsec;        // when the load goes on, -1 if not known
+} t_BenchStream;
+
+
+//*****************************************************************************
+//*****************************************************************************
+static void syntheticStream( int sps, t_BenchStream &stream )
+{
+std::mt19937 rng( 1 );
+std::normal_distribution<double> noise( 0.0, BENCH_NOISE );
+int num = sps * BENCH_SECONDS;
+qint64 period = 1000000000LL / sps;
+
+    stream.values.clear();
+    stream.times.clear();
+    stream.sps      = sps;
+    stream.stepNsec = ( num / 2 ) * period;
+
+    for ( int i=0; i<num; i++ )
+    {
+        double load = ( i >= num / 2 ) ? BENCH_STEP_LOAD : 0.0;
+        stream.values.append( static_cast<qint32>( BENCH_OFFSET + load / BENCH_SCALE + noise( rng ) ) );
+        stream.times.append( i * period );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+static bool capturedStream( const QString &path, t_BenchStream &stream )
+{
+QFile file( path );
+t_CaptureHeader header;
+
+    if ( !file.open( QIODevice::ReadOnly ) ||
+         file.read( reinterpret_cast<char*>( &header ), sizeof(header) ) != sizeof(header) ||
+         header.magic != CAPTURE_MAGIC || header.recordSize != sizeof( t_CaptureRecord ) ||
+         header.headerSize < sizeof( t_CaptureHeader ) || header.headerSize > static_cast<quint64>( file.size() ) )
+    {
+        printf( "Can't read capture %s\n", qPrintable( path ) );
+        return false;
+    }
+
+    quint64 num = ( static_cast<quint64>( file.size() ) - header.headerSize ) / header.recordSize;
+    const t_CaptureRecord *records = reinterpret_cast<const t_CaptureRecord*>(
+                                         num > 0 ? file.map( header.headerSize, num * header.recordSize ) : nullptr );
+    if ( !records ) return false;
+
+    //*** channel 1, as a single channel stream ***
+    stream.values.clear();
+    stream.times.clear();
+    stream.sps      = static_cast<int>( header.sampleRate / qMax( 1u, header.numChannels ) );
+    stream.stepNsec = -1;
+
+    for ( quint64 i=0; i<num; i++ )
+    {
+        if ( records[i].channel != SCALE_CHANNEL_1 ) continue;
+        stream.values.append( records[i].value );
+        stream.times.append( records[i].timestamp );
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief benchCalls - times a call made BENCH_CALLS times
+ * @param call - the call
+ * @param allocs - set to the allocations per call
+ * @return nsec per call
+ */
+//*****************************************************************************
+template <typename CALL>
+static double benchCalls( CALL call, double &allocs )
+{
+quint64 startAllocs = allocations.load();
+qint64 start = ScaleClock::system()->nsecs();
+
+    for ( int i=0; i<BENCH_CALLS; i++ ) call();
+
+    qint64 nsec = ScaleClock::system()->nsecs() - start;
+    allocs = static_cast<double>( allocations.load() - startAllocs ) / BENCH_CALLS;
+
+    return static_cast<double>( nsec ) / BENCH_CALLS;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief benchStream - benchmarks one stream at one window size
+ * @param stream - conversions to feed
+ * @param weightSamples - decimated samples per weight
+ */
+//*****************************************************************************
+static void benchStream( const t_BenchStream &stream, int weightSamples )
+{
+t_DataSet data;
+t_WindowStats stats;
+volatile float sink = 0.0f;
+double allocs;
+double ns;
+
+    //*** producer - every conversion through the pipeline ***
+    BenchDriver *scale = new BenchDriver( stream.sps, weightSamples );
+    quint64 startAllocs = allocations.load();
+    qint64 start = ScaleClock::system()->nsecs();
+
+    for ( int i=0; i<stream.values.size(); i++ ) scale->feed( stream.values[i], stream.times[i] );
+
+    ns = static_cast<double>( ScaleClock::system()->nsecs() - start ) / qMax( 1, stream.values.size() );
+    allocs = static_cast<double>( allocations.load() - startAllocs ) / qMax( 1, stream.values.size() );
+
+    printf( "\n%d SPS, %d samples per weight\n", stream.sps, scale->weightSamples() );
+    printf( "  addConversion         %9.1f ns  %6.2f allocs\n", ns, allocs );
+
+    //*** consumer calls on the full rings ***
+    ns = benchCalls( [&]() { sink = scale->getWeight(); }, allocs );
+    printf( "  getWeight             %9.1f ns  %6.2f allocs\n", ns, allocs );
+
+    ns = benchCalls( [&]() { scale->getWindowStats( weightSamples, stats ); }, allocs );
+    printf( "  getWindowStats        %9.1f ns  %6.2f allocs\n", ns, allocs );
+
+    ns = benchCalls( [&]() { scale->collectRawData( weightSamples, data ); }, allocs );
+    printf( "  collectRawData        %9.1f ns  %6.2f allocs\n", ns, allocs );
+
+    ns = benchCalls( [&]() { scale->collectProcessedData( weightSamples, data ); }, allocs );
+    printf( "  collectProcessedData  %9.1f ns  %6.2f allocs\n", ns, allocs );
+
+    ns = benchCalls( [&]() { sink = ScaleDriver::formatWeight( scale->getWeight() ).size(); }, allocs );
+    printf( "  weight + formatWeight %9.1f ns  %6.2f allocs\n", ns, allocs );
+
+    delete scale;
+
+    //*** latency and steady state error need a known step ***
+    if ( stream.stepNsec < 0 ) return;
+
+    //*** weight after each decimated sample, as the GUI would see it ***
+    scale = new BenchDriver( stream.sps, weightSamples );
+    qint64 settledNsec = -1;
+    int tail = 0;
+    double sum = 0.0;
+    double sumSq = 0.0;
+    qint64 tailStart = stream.stepNsec + ( stream.times.last() - stream.stepNsec ) / 2;
+
+    for ( int i=0; i<stream.values.size(); i++ )
+    {
+        if ( !scale->feed( stream.values[i], stream.times[i] ) ) continue;
+        if ( stream.times[i] < stream.stepNsec ) continue;
+
+        double error = scale->getWeight() - BENCH_STEP_LOAD;
+
+        //*** first time within 1% of the step ***
+        if ( settledNsec < 0 && std::fabs( error ) <= BENCH_SETTLED * BENCH_STEP_LOAD )
+        {
+            settledNsec = stream.times[i] - stream.stepNsec;
+        }
+
+        //*** steady state - second half of the loaded stretch ***
+        if ( stream.times[i] >= tailStart )
+        {
+            sum += error;
+            sumSq += error * error;
+            tail++;
+        }
+    }
+    delete scale;
+
+    if ( settledNsec >= 0 ) printf( "  latency to 1%%         %9.1f ms\n", settledNsec / 1.0e6 );
+    else printf( "  latency to 1%%         never\n" );
+
+    if ( tail > 1 )
+    {
+        double mean = sum / tail;
+        printf( "  steady state error    %9.4f mean  %.4f rms\n", mean, std::sqrt( sumSq / tail ) );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief benchOutlierFilters - A/B of the streaming Hampel filter against the
+ *              old per request path: copy the last N samples, sort them and
+ *              replace anything further than median/10 from the median.
+ *              Spikes are added to the stream to see what each one catches.
+ * @param stream - conversions to feed
+ */
+//*****************************************************************************
+static void benchOutlierFilters( const t_BenchStream &stream )
+{
+QVector<qint32> values = stream.values;
+t_DataSet history;
+t_DataSet data;
+volatile qint32 sink = 0;
+int spikes = 0;
+
+    //*** spikes well inside median/10 of a loaded cell ***
+    for ( int i=BENCH_SPIKE_EVERY / 2; i<values.size(); i+=BENCH_SPIKE_EVERY )
+    {
+        values[i] += BENCH_SPIKE_COUNTS;
+        spikes++;
+    }
+
+    printf( "\n%d SPS outlier filter, %d spikes of %d counts\n", stream.sps, spikes, BENCH_SPIKE_COUNTS );
+
+    for ( int window : BENCH_FILTER_WINDOWS )
+    {
+        //*** A - streaming Hampel filter, one call per conversion ***
+        HampelFilter hampel( window, BENCH_OUTLIER_K, BENCH_OUTLIER_MIN );
+        quint64 startAllocs = allocations.load();
+        qint64 start = ScaleClock::system()->nsecs();
+
+        for ( int i=0; i<values.size(); i++ ) sink = hampel.filter( values[i] );
+
+        double ns = static_cast<double>( ScaleClock::system()->nsecs() - start ) / qMax( 1, values.size() );
+        double allocs = static_cast<double>( allocations.load() - startAllocs ) / qMax( 1, values.size() );
+        printf( "  hampel      %3d window %9.1f ns  %6.2f allocs  %6d replaced\n",
+                window, ns, allocs, static_cast<int>( hampel.outliers() ) );
+
+        //*** B - last N into a list, sorted, median/10 threshold, once per conversion ***
+        int replaced = 0;
+        history.clear();
+        startAllocs = allocations.load();
+        start = ScaleClock::system()->nsecs();
+
+        for ( int i=0; i<values.size(); i++ )
+        {
+            history.append( values[i] );
+            if ( history.size() > window ) history.removeFirst();
+
+            data.clear();
+            for ( int j=0; j<history.size(); j++ ) data.append( history[j] );
+            std::sort( data.begin(), data.end() );
+
+            int n = data.size();
+            int mid = n / 2;
+            int median = ( n % 2 == 0 ) ? ( data[mid] + data[mid-1] ) / 2 : data[mid];
+            int variant = median / 10;
+
+            //*** the newest sample is the one the consumer wants ***
+            if ( abs( values[i] - median ) > abs( variant ) )
+            {
+                sink = median;
+                replaced++;
+            }
+            else
+            {
+                sink = values[i];
+            }
+        }
+
+        ns = static_cast<double>( ScaleClock::system()->nsecs() - start ) / qMax( 1, values.size() );
+        allocs = static_cast<double>( allocations.load() - startAllocs ) / qMax( 1, values.size() );
+        printf( "  sort median %3d window %9.1f ns  %6.2f allocs  %6d replaced\n", window, ns, allocs, replaced );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief runBenchmarks - benchmarks the weight processing
+ * @param capturePath - capture to use as the stream, empty for synthetic streams
+ */
+//*****************************************************************************
+static void runBenchmarks( const QString &capturePath )
+{
+t_BenchStream stream;
+const int rates[] = { 10, 80, 320 };
+const int windows[] = { 4, 16, 64 };
+
+    for ( int r=0; r<3; r++ )
+    {
+        //*** a capture runs once, at its own rate ***
+        if ( !capturePath.isEmpty() )
+        {
+            if ( r > 0 || !capturedStream( capturePath, stream ) ) return;
+        }
+        else
+        {
+            syntheticStream( rates[r], stream );
+        }
+
+        for ( int w=0; w<3; w++ ) benchStream( stream, windows[w] );
+        benchOutlierFilters( stream );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+
+//*** kinds of load test client ***
+typedef enum
+{
+    LOAD_FPSVR   = 0,   // sends the roster, gets reports (framed)
+    LOAD_FRAMED  = 1,   // subscribes to reports
+    LOAD_MONITOR = 2,   // subscribes to live weights only
+    LOAD_LEGACY  = 3,   // sends one check-in, gets fixed size reports
+} Load_Client_Kind;
+
+//*** one load test client ***
+typedef struct
+{
+    QTcpSocket *sock;
+    int kind;
+    QByteArray received;
+    int reports;
+    int liveFrames;
+    qint32 live[ LOAD_STATIONS ];   // hundredths, put back together from the deltas
+} t_LoadClient;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief waitFor - runs the event loop until a condition holds
+ * @param cond - condition
+ * @param msec - longest to wait
+ * @return true if it held in time
+ */
+//*****************************************************************************
+static bool waitFor( std::function<bool()> cond, int msec )
+{
+QElapsedTimer timer;
+QTimer tick;
+
+    //*** wake up now and then even if nothing happens ***
+    tick.start( 10 );
+    timer.start();
+
+    while ( !cond() )
+    {
+        if ( timer.elapsed() > msec ) return false;
+        QCoreApplication::processEvents( QEventLoop::WaitForMoreEvents );
+    }
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief countReports - counts the weight reports a load client has received
+ *              and follows the live weights it is sent
+ * @param client - client
+ */
+//*****************************************************************************
+static void countReports( t_LoadClient &client )
+{
+t_FrameHeader header;
+t_LiveRecord rec;
+
+    client.received.append( client.sock->readAll() );
+
+    //*** fixed size - one total per report ***
+    if ( client.kind == LOAD_LEGACY )
+    {
+        client.reports += client.received.size() / WEIGHT_REPORT_SIZE;
+        client.received.remove( 0, ( client.received.size() / WEIGHT_REPORT_SIZE ) * WEIGHT_REPORT_SIZE );
+        return;
+    }
+
+    //*** framed - one FRAME_WEIGHTS per report, roster acks skipped ***
+    while ( client.received.size() >= static_cast<int>( sizeof(header) ) )
+    {
+        memcpy( &header, client.received.constData(), sizeof(header) );
+        int size = sizeof(header) + header.length;
+        if ( client.received.size() < size ) return;
+
+        if ( header.type == FRAME_WEIGHTS ) client.reports++;
+
+        //*** live - keyframes set the weight, the rest move it ***
+        if ( header.type == FRAME_LIVE )
+        {
+            client.liveFrames++;
+            for ( quint32 n=0; n<header.count && ( n + 1 ) * sizeof(rec) <= header.length; n++ )
+            {
+                memcpy( &rec, client.received.constData() + sizeof(header) + n * sizeof(rec), sizeof(rec) );
+                if ( rec.station < 1 || rec.station > LOAD_STATIONS ) continue;
+
+                qint32 &value = client.live[ rec.station - 1 ];
+                value = ( rec.flags & LIVE_KEYFRAME ) ? rec.value : value + rec.value;
+            }
+        }
+        client.received.remove( 0, size );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief runLoadTest - connects many clients to a ConnectionManager and
+ *              checks roster delivery, report fan out, live weights and
+ *              connection state.
+ * @param numClients - clients to connect
+ * @return true if every check passed
+ */
+//*****************************************************************************
+static bool runLoadTest( int numClients )
+{
+ConnectionManager mgr;
+QList<t_LoadClient> clients;
+QVector<t_WeightRecord> reports;
+QVector<t_LiveWeight> live;
+QElapsedTimer timer;
+int checkIns = 0;
+int opened = 0;
+int connectedUp = 0;
+int connectedDown = 0;
+int liveHz = 0;
+bool ok = true;
+
+    if ( !mgr.listen( 0 ) ) return false;
+
+    QObject::connect( &mgr, &ConnectionManager::checkInFrame,
+                      [&checkIns]( int id, const t_FrameInfo &frame, ProtocolReader *reader )
+    {
+        Q_UNUSED( id )
+        Q_UNUSED( frame )
+        t_CheckInView view;
+        while ( reader->nextCheckIn( view ) ) checkIns++;
+    } );
+    QObject::connect( &mgr, &ConnectionManager::connectionOpened, [&opened]( int id ) { Q_UNUSED( id ) opened++; } );
+    QObject::connect( &mgr, &ConnectionManager::liveRateChanged, [&liveHz]( int hz ) { liveHz = hz; } );
+    QObject::connect( &mgr, &ConnectionManager::connectedChanged, [&connectedUp, &connectedDown]( bool up )
+    {
+        if ( up ) connectedUp++; else connectedDown++;
+    } );
+
+    //*** connect everyone ***
+    printf( "Connecting %d clients to port %d...\n", numClients, mgr.port() );
+    timer.start();
+    for ( int i=0; i<numClients; i++ )
+    {
+        t_LoadClient c;
+        c.sock    = new QTcpSocket();
+        c.kind    = ( i == 0 ) ? LOAD_FPSVR : ( i % 3 == 1 ? LOAD_FRAMED : ( i % 3 == 2 ? LOAD_MONITOR : LOAD_LEGACY ) );
+        c.reports = 0;
+        c.liveFrames = 0;
+        memset( c.live, 0, sizeof(c.live) );
+        c.sock->connectToHost( QHostAddress( QHostAddress::LocalHost ), mgr.port() );
+        clients.append( c );
+    }
+    for ( int i=0; i<clients.size(); i++ )
+    {
+        QObject::connect( clients[i].sock, &QAbstractSocket::readyRead, [&clients, i]() { countReports( clients[i] ); } );
+    }
+
+    if ( !waitFor( [&]() { return opened == numClients; }, LOAD_WAIT_MSEC ) )
+    {
+        printf( "FAIL only %d of %d connections seen\n", opened, numClients );
+        ok = false;
+    }
+    printf( "connected      %d in %d msec\n", opened, static_cast<int>( timer.elapsed() ) );
+
+    //*** nobody has said they are fpSvr yet ***
+    if ( connectedUp != 0 || mgr.servers() != 0 )
+    {
+        printf( "FAIL connected before anyone sent anything - up %d times, %d servers\n", connectedUp, mgr.servers() );
+        ok = false;
+    }
+
+    //*** say who they are - fpSvr sends the roster in one frame ***
+    timer.restart();
+    for ( int i=0; i<clients.size(); i++ )
+    {
+        if ( clients[i].kind == LOAD_FPSVR )
+        {
+            FrameWriter frame( FRAME_CHECKINS );
+            for ( int n=0; n<LOAD_ROSTER; n++ ) frame.addCheckIn( n + 1, 10, 0, QString( "Person %1" ).arg( n + 1 ) );
+            clients[i].sock->write( frame.frame() );
+        }
+        else if ( clients[i].kind != LOAD_LEGACY )
+        {
+            FrameWriter frame( FRAME_SUBSCRIBE );
+            if ( clients[i].kind == LOAD_FRAMED ) frame.addSubscribe( SUBSCRIBE_REPORTS );
+            else frame.addSubscribe( SUBSCRIBE_LIVE, LIVE_MAX_HZ );
+            clients[i].sock->write( frame.frame() );
+        }
+
+        //*** legacy fpSvr - one fixed size check-in, so its framing is known ***
+        else
+        {
+            t_CheckIn ci;
+            QByteArray name = QString( "Legacy %1" ).arg( i ).toUtf8();
+            memset( &ci, 0, CHECKIN_SIZE );
+            ci.key = LOAD_ROSTER + i;
+            ci.numItems = 10;
+            memcpy( ci.name, name.constData(), qMin( name.size(), FP_NAME_MAX ) );
+            clients[i].sock->write( reinterpret_cast<const char*>( &ci ), CHECKIN_SIZE );
+        }
+    }
+
+    //*** every subscription (and the roster) has been taken in - ids follow the order accepted ***
+    int framedClients = 0;
+    int monitors = 0;
+    int servers = 0;
+    for ( int i=0; i<clients.size(); i++ )
+    {
+        framedClients += ( clients[i].kind != LOAD_LEGACY ) ? 1 : 0;
+        monitors += ( clients[i].kind == LOAD_MONITOR ) ? 1 : 0;
+        servers += ( clients[i].kind != LOAD_MONITOR ) ? 1 : 0;
+    }
+    std::function<bool()> settled = [&]()
+    {
+        int framed = 0;
+        int legacy = 0;
+        int liveOnly = 0;
+        for ( int id=1; id<=numClients; id++ )
+        {
+            framed += ( mgr.mode( id ) == PROTOCOL_FRAMED ) ? 1 : 0;
+            legacy += ( mgr.mode( id ) == PROTOCOL_LEGACY ) ? 1 : 0;
+            liveOnly += ( mgr.subscriptions( id ) == SUBSCRIBE_LIVE ) ? 1 : 0;
+        }
+        return checkIns >= LOAD_ROSTER && framed == framedClients && legacy == numClients - framedClients &&
+               liveOnly == monitors;
+    };
+    if ( !waitFor( settled, LOAD_WAIT_MSEC ) )
+    {
+        printf( "FAIL roster %d of %d check-ins, or subscriptions not taken\n", checkIns, LOAD_ROSTER );
+        ok = false;
+    }
+    printf( "roster         %d check-ins in %d msec\n", checkIns, static_cast<int>( timer.elapsed() ) );
+
+    //*** connected once, by fpSvr and the report clients (legacy ones too) - monitors don't count ***
+    if ( connectedUp != 1 || mgr.servers() != servers )
+    {
+        printf( "FAIL connected up %d times, %d servers, expected %d\n", connectedUp, mgr.servers(), servers );
+        ok = false;
+    }
+
+    //*** fan out reports ***
+    int receivers = 0;
+    for ( int i=0; i<clients.size(); i++ ) receivers += ( clients[i].kind == LOAD_MONITOR ) ? 0 : 1;
+
+    qint64 sendNsec = 0;
+    int sent = 0;
+    reports.resize( 1 );
+    memset( reports.data(), 0, sizeof(t_WeightRecord) );
+    reports[0].weight = 12.5;
+    timer.restart();
+    for ( int r=0; r<LOAD_REPORTS; r++ )
+    {
+        QElapsedTimer call;
+        call.start();
+        reports[0].key = r + 1;
+        reports[0].reportId = r + 1;
+        sent += mgr.sendReports( reports, false );
+        sendNsec += call.nsecsElapsed();
+    }
+
+    std::function<bool()> delivered = [&]()
+    {
+        for ( int i=0; i<clients.size(); i++ )
+        {
+            if ( clients[i].kind != LOAD_MONITOR && clients[i].reports < LOAD_REPORTS ) return false;
+        }
+        return true;
+    };
+    bool allDelivered = waitFor( delivered, LOAD_WAIT_MSEC );
+    printf( "reports        %d to %d receivers - %.1f usec per fan out, all delivered in %d msec\n",
+            LOAD_REPORTS, receivers, sendNsec / 1000.0 / LOAD_REPORTS, static_cast<int>( timer.elapsed() ) );
+
+    //*** exactly what each one subscribed to ***
+    for ( int i=0; i<clients.size(); i++ )
+    {
+        int expected = ( clients[i].kind == LOAD_MONITOR ) ? 0 : LOAD_REPORTS;
+        if ( clients[i].reports != expected )
+        {
+            printf( "FAIL client %d (kind %d) got %d reports, expected %d\n", i + 1, clients[i].kind, clients[i].reports, expected );
+            ok = false;
+        }
+    }
+    if ( !allDelivered || sent != receivers * LOAD_REPORTS ) ok = false;
+
+    //*** live weights - a load going on and settling, sampled at the fastest rate ***
+    if ( liveHz != LIVE_MAX_HZ )
+    {
+        printf( "FAIL live rate %d, expected %d\n", liveHz, LIVE_MAX_HZ );
+        ok = false;
+    }
+    live.resize( LOAD_STATIONS );
+    for ( int s=0; s<LOAD_STATIONS; s++ )
+    {
+        live[s].station = s + 1;
+        live[s].weight  = 0.0f;
+        live[s].stable  = false;
+        live[s].valid   = true;
+    }
+
+    qint64 liveNsec = 0;
+    int liveCalls = 0;
+    timer.restart();
+    for ( int t=0; t<LOAD_LIVE_TICKS; t++ )
+    {
+        //*** station 1 ramps up, then both hold still ***
+        if ( t < LOAD_LIVE_TICKS / 2 ) live[0].weight += 0.37f;
+        live[0].stable = ( t >= LOAD_LIVE_TICKS / 2 );
+        live[1].stable = true;
+
+        QElapsedTimer call;
+        call.start();
+        mgr.sendLive( live );
+        liveNsec += call.nsecsElapsed();
+        liveCalls++;
+
+        waitFor( [&]() { return call.elapsed() >= 1000 / LIVE_MAX_HZ; }, 1000 );
+    }
+
+    //*** every monitor ends up with the final weights, and at no more than its rate ***
+    qint32 expected0 = qRound( live[0].weight * 100.0f );
+    std::function<bool()> followed = [&]()
+    {
+        for ( int i=0; i<clients.size(); i++ )
+        {
+            if ( clients[i].kind == LOAD_MONITOR && ( clients[i].live[0] != expected0 || clients[i].live[1] != 0 ) ) return false;
+        }
+        return true;
+    };
+    bool allFollowed = waitFor( followed, LOAD_WAIT_MSEC );
+    int liveFrames = 0;
+    for ( int i=0; i<clients.size(); i++ )
+    {
+        if ( clients[i].kind != LOAD_MONITOR ) continue;
+        liveFrames += clients[i].liveFrames;
+        if ( clients[i].liveFrames == 0 || clients[i].liveFrames > LOAD_LIVE_TICKS )
+        {
+            printf( "FAIL client %d got %d live frames for %d ticks\n", i + 1, clients[i].liveFrames, LOAD_LIVE_TICKS );
+            ok = false;
+        }
+    }
+    printf( "live           %d ticks to %d subscribers - %.1f usec per tick, %d frames in %d msec\n",
+            liveCalls, monitors, liveNsec / 1000.0 / qMax( 1, liveCalls ), liveFrames, static_cast<int>( timer.elapsed() ) );
+    if ( !allFollowed )
+    {
+        printf( "FAIL live weights not followed - expected %d hundredths\n", expected0 );
+        ok = false;
+    }
+
+    //*** half go away - still connected while a report client is left ***
+    int half = numClients / 2;
+    int serversLeft = 0;
+    for ( int i=0; i<half; i++ ) clients[i].sock->disconnectFromHost();
+    for ( int i=half; i<clients.size(); i++ )
+    {
+        serversLeft += ( clients[i].kind != LOAD_MONITOR ) ? 1 : 0;
+    }
+    if ( !waitFor( [&]() { return mgr.count() == numClients - half; }, LOAD_WAIT_MSEC ) ||
+         connectedDown != ( serversLeft > 0 ? 0 : 1 ) )
+    {
+        printf( "FAIL %d connections left after %d closed, connected dropped %d times\n", mgr.count(), half, connectedDown );
+        ok = false;
+    }
+
+    //*** the rest go - disconnected once ***
+    for ( int i=half; i<clients.size(); i++ ) clients[i].sock->disconnectFromHost();
+    if ( !waitFor( [&]() { return mgr.count() == 0; }, LOAD_WAIT_MSEC ) || connectedUp != 1 || connectedDown != 1 )
+    {
+        printf( "FAIL %d connections left, connected up %d / down %d times\n", mgr.count(), connectedUp, connectedDown );
+        ok = false;
+    }
+    printf( "disconnected   all - connected up %d / down %d times\n", connectedUp, connectedDown );
+
+    for ( int i=0; i<clients.size(); i++ ) delete clients[i].sock;
+
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+    return ok;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+
+//*** one way of reading the NAU7802, and what it should cost ***
+typedef struct
+{
+    const char *name;
+    bool drdy;              // data ready line rather than polling
+    bool combined;          // combined transfers (i2c-dev) rather than a register at a time (wiringPi)
+    int perConversion;      // transactions to read a conversion that is waiting
+    int perEmptyPoll;       // transactions to find there isn't one
+} t_BusCase;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief runBusCheck - reads conversions from the NAU7802 driver through the
+ *              mock bus and data ready line, the way the reader thread does,
+ *              and checks how many bus transactions each one takes.
+ * @return true if every check passed
+ */
+//*****************************************************************************
+static bool runBusCheck()
+{
+static const t_BusCase cases[] =
+{
+    { "poll, combined",     false, true,  1, 1 },
+    { "poll, per register", false, false, 4, 1 },
+    { "drdy, combined",     true,  true,  1, 0 },
+    { "drdy, per register", true,  false, 3, 0 },
+};
+t_ChannelStats stats;
+bool ok = true;
+
+    for ( const t_BusCase &c : cases )
+    {
+        MockGpioLine *line = c.drdy ? new MockGpioLine() : nullptr;
+        MockI2CBus *bus = new MockI2CBus( line );
+        bus->setCombinedTransfers( c.combined );
+
+        //*** the chip owns the bus and line from here ***
+        NAU7802 *chip = new NAU7802( 0, 1.0, line, bus );
+
+        int waitMsec;
+        while ( ( waitMsec = chip->bringUpStep() ) >= 0 ) ScaleClock::system()->sleepMsec( waitMsec );
+        if ( !chip->isReady() || ( chip->dataReadyLine() != nullptr ) != c.drdy )
+        {
+            printf( "FAIL %-20s bring-up\n", c.name );
+            ok = false;
+            delete chip;
+            continue;
+        }
+
+        //*** edges from configuring the chip don't count ***
+        while ( line && line->waitForEdge( 0 ) > 0 ) {}
+        bus->resetTransactions();
+
+        quint64 emptyTx = 0;
+        for ( int n=0; n<BUS_CHECK_CONVERSIONS; n++ )
+        {
+            //*** polling looks before the conversion is done ***
+            if ( !c.drdy )
+            {
+                quint64 before = bus->transactions();
+                chip->takeReading();
+                emptyTx += bus->transactions() - before;
+            }
+
+            bus->loadConversion( 1000 + n );
+
+            if ( !c.drdy ) chip->takeReading();
+            else if ( line->waitForEdge( BUS_CHECK_EDGE_MSEC ) > 0 ) chip->takeReading( false );
+        }
+
+        quint64 readTx = bus->transactions() - emptyTx;
+        chip->getChannelStats( NAU7802_CHANNEL_1, stats );
+
+        printf( "%-20s %.2f transactions per conversion, %.2f per empty poll, %d of %d read, setup %d\n",
+                c.name, static_cast<double>( readTx ) / BUS_CHECK_CONVERSIONS,
+                static_cast<double>( emptyTx ) / BUS_CHECK_CONVERSIONS,
+                static_cast<int>( stats.conversions ), BUS_CHECK_CONVERSIONS, chip->setupTransactions() );
+
+        if ( readTx != static_cast<quint64>( c.perConversion ) * BUS_CHECK_CONVERSIONS ||
+             emptyTx != static_cast<quint64>( c.perEmptyPoll ) * BUS_CHECK_CONVERSIONS ||
+             stats.conversions != static_cast<quint64>( BUS_CHECK_CONVERSIONS ) )
+        {
+            printf( "FAIL %-20s expected %d per conversion, %d per empty poll\n", c.name, c.perConversion, c.perEmptyPoll );
+            ok = false;
+        }
+
+        delete chip;
+    }
+
+    printf( "%s\n", ok ? "PASS" : "FAIL" );
+    return ok;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int main( int argc, char *argv[] )
+{
+QCoreApplication app( argc, argv );
+QCommandLineParser parser;
+t_RunConfig run;
+t_RunResult result;
+LatencyStats latency;
+SimNAU7802 *simNau;
+SimHX711 *simHx;
+
+    parser.setApplicationDescription( "Scale diagnostics - rate, latency, noise and settle time" );
+    parser.addHelpOption();
+    parser.addOption( QCommandLineOption( "driver", "nau7802 or hx711", "name", "nau7802" ) );
+    parser.addOption( QCommandLineOption( "sim", "Use a simulated chip" ) );
+    parser.addOption( QCommandLineOption( "replay", "Replay a capture instead of reading a chip", "file" ) );
+    parser.addOption( QCommandLineOption( "seconds", "How long to sample", "n", QString::number( DEFAULT_SECONDS ) ) );
+    parser.addOption( QCommandLineOption( "sps", "Conversion rate - NAU7802 10/20/40/80/320, HX711 10/80", "n", "0" ) );
+    parser.addOption( QCommandLineOption( "output-rate", "Decimated samples per second", "n", "0" ) );
+    parser.addOption( QCommandLineOption( "weight-samples", "Decimated samples averaged into a weight", "n", "0" ) );
+    parser.addOption( QCommandLineOption( "dual", "Load cell on each NAU7802 channel" ) );
+    parser.addOption( QCommandLineOption( "gain", "HX711 gain - 128, 64 or 32", "n", "128" ) );
+    parser.addOption( QCommandLineOption( "bus", "I2C bus, -1 for wiringPi", "n", "1" ) );
+    parser.addOption( QCommandLineOption( "drdy", "GPIO wired to the NAU7802 CRDY pin, -1 to poll", "gpio", "-1" ) );
+    parser.addOption( QCommandLineOption( "dt", "HX711 data GPIO", "gpio", "21" ) );
+    parser.addOption( QCommandLineOption( "sck", "HX711 clock GPIO", "gpio", "20" ) );
+    parser.addOption( QCommandLineOption( "gpiomem", "Clock the HX711 through /dev/gpiomem" ) );
+    parser.addOption( QCommandLineOption( "tare", "Raw tare value", "counts" ) );
+    parser.addOption( QCommandLineOption( "scale", "Scale factor, units per count", "factor" ) );
+    parser.addOption( QCommandLineOption( "step", "Put this load on the simulated scale half way through", "load", "0" ) );
+    parser.addOption( QCommandLineOption( "capture", "Keep the capture in this file", "file" ) );
+    parser.addOption( QCommandLineOption( "bench", "Benchmark the weight processing - synthetic streams, or --replay's capture" ) );
+    parser.addOption( QCommandLineOption( "load-clients", "Load test the scale's TCP server with n clients", "n" ) );
+    parser.addOption( QCommandLineOption( "bus-check", "Check the NAU7802's bus transactions per conversion on a mock bus" ) );
+    parser.process( app );
+
+    //*** no scale needed ***
+    if ( parser.isSet( "bench" ) )
+    {
+        runBenchmarks( parser.value( "replay" ) );
+        return 0;
+    }
+    if ( parser.isSet( "load-clients" ) )
+    {
+        return runLoadTest( qMax( 2, parser.value( "load-clients" ).toInt() ) ) ? 0 : 1;
+    }
+    if ( parser.isSet( "bus-check" ) )
+    {
+        return runBusCheck() ? 0 : 1;
+    }
+
+    //*** station built from the options ***
+    run.station = ScaleRegistry::defaultStation( 1 );
+    run.station.driver      = ( parser.value( "driver" ).toLower() == "hx711" ) ? SCALE_DRIVER_HX711 : SCALE_DRIVER_NAU7802;
+    run.station.sim         = parser.isSet( "sim" );
+    run.station.replayFile  = parser.value( "replay" );
+    run.station.dualChannel = parser.isSet( "dual" );
+    run.station.i2cBus      = parser.value( "bus" ).toInt();
+    run.station.drdyGpio    = parser.value( "drdy" ).toInt();
+    run.station.hx711Dt     = parser.value( "dt" ).toInt();
+    run.station.hx711Sck    = parser.value( "sck" ).toInt();
+    run.station.hx711Gain   = hx711GainCode( parser.value( "gain" ).toInt() );
+    run.station.hx711Port   = parser.isSet( "gpiomem" ) ? HX711_PORT_GPIOMEM : HX711_PORT_GPIOCHIP;
+    if ( parser.isSet( "tare" ) ) run.station.tare[0] = parser.value( "tare" ).toInt();
+    if ( parser.isSet( "scale" ) ) run.station.scale[0] = parser.value( "scale" ).toDouble();
+
+    run.sps           = parser.value( "sps" ).toInt();
+    run.outputRate    = parser.value( "output-rate" ).toInt();
+    run.weightSamples = parser.value( "weight-samples" ).toInt();
+    run.seconds       = qMax( 1, parser.value( "seconds" ).toInt() );
+    run.stepLoad      = parser.value( "step" ).toDouble();
+    run.capturePath   = parser.value( "capture" );
+
+    ScaleDriver *scale = createScale( run, &latency, simNau, simHx );
+
+    //*** capture everything - the report is worked out from it (a replay already is one) ***
+    QString path = run.capturePath;
+    CaptureWriter *capture = nullptr;
+    if ( !run.station.replayFile.isEmpty() )
+    {
+        path = run.station.replayFile;
+    }
+    else
+    {
+        if ( path.isEmpty() )
+        {
+            path = QDir( QDir::tempPath() ).filePath( QString( "readscale-%1.fpcap" ).arg( QCoreApplication::applicationPid() ) );
+        }
+
+        capture = new CaptureWriter();
+        if ( !capture->open( path, scale, ScaleClock::system()->nsecs() ) )
+        {
+            delete capture;
+            delete scale;
+            return 1;
+        }
+        scale->setCapture( capture );
+    }
+
+    //*** settle time of each load ***
+    QObject::connect( scale, &ScaleDriver::stableWeight, &app, [&result]( float weight, int settleMsec )
+    {
+        result.stableWeights.append( weight );
+        result.settleMsecs.append( settleMsec );
+        printf( "settled %.2f after %d msec\n", weight, settleMsec );
+    } );
+
+    QObject::connect( scale, &ScaleDriver::failed, &app, []( QString reason )
+    {
+        printf( "Scale failed: %s\n", qPrintable( reason ) );
+        QCoreApplication::exit( 1 );
+    } );
+
+    //*** a replay ends when the capture does ***
+    ReplayDriver *replay = qobject_cast<ReplayDriver*>( scale );
+    if ( replay ) QObject::connect( replay, &ReplayDriver::replayDone, &app, &QCoreApplication::quit );
+
+    result.startNsec = ScaleClock::system()->nsecs();
+    result.stepNsec  = -1;
+
+    //*** step load half way through, on the simulated chip ***
+    if ( run.stepLoad != 0.0 && ( simNau || simHx ) )
+    {
+        result.stepNsec = result.startNsec + static_cast<qint64>( run.seconds ) * 500000000;
+        if ( simNau ) simNau->addStep( result.stepNsec, run.stepLoad );
+        if ( simHx ) simHx->addStep( result.stepNsec, run.stepLoad );
+    }
+
+    printf( "Reading %s for %d sec...\n", qPrintable( scale->name() ), run.seconds );
+
+    scale->start();
+    if ( !replay ) QTimer::singleShot( run.seconds * 1000, &app, &QCoreApplication::quit );
+    int rc = app.exec();
+
+    //*** counters before the scale goes away ***
+    t_ChannelStats stats;
+    result.discarded = 0;
+    for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+    {
+        scale->getChannelStats( ch, stats );
+        result.discarded += stats.discarded;
+    }
+    result.simOverruns = simNau ? simNau->overruns() : ( simHx ? simHx->overruns() : 0 );
+
+    HX711 *hx711 = qobject_cast<HX711*>( scale );
+    bool isHx711 = ( hx711 != nullptr );
+    t_HX711Errors errors;
+    if ( isHx711 ) hx711->getErrors( errors );
+
+    //*** stop sampling, then finish the file ***
+    delete scale;
+    result.captureDropped = 0;
+    if ( capture )
+    {
+        capture->close();
+        result.captureDropped = capture->dropped();
+        delete capture;
+    }
+
+    if ( rc == 0 ) report( path, run, result, latency );
+
+    if ( isHx711 )
+    {
+        printf( "\nHX711 reads       %llu\n", static_cast<unsigned long long>( errors.reads ) );
+        printf( "  corrupt %llu  overlong %llu  timeouts %llu  error rate %.4f%%\n",
+                static_cast<unsigned long long>( errors.corrupt ), static_cast<unsigned long long>( errors.overlong ),
+                static_cast<unsigned long long>( errors.timeouts ), errors.errorRate * 100.0 );
+    }
+
+    //*** temporary capture ***
+    if ( run.station.replayFile.isEmpty() && run.capturePath.isEmpty() ) QFile::remove( path );
+
+    return rc;
 }
@@ -0,0 +1,71 @@
+#-------------------------------------------------
+#
+# ReadScale - headless scale diagnostics
+#
+# Build alongside FoodPantry in its own build directory
+# (qmake ReadScale.pro writes Makefile.ReadScale otherwise)
+#
+#-------------------------------------------------
+
+QT       += core network
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = ReadScale
+TEMPLATE = app
+MAKEFILE = Makefile.ReadScale
+
+
+SOURCES += ReadScale.cpp \
+        ScaleDriver.cpp \
+        HX711.cpp \
+        HX711Port.cpp \
+        HX711Reader.cpp \
+        SimHX711.cpp \
+        CaptureWriter.cpp \
+        ReplayDriver.cpp \
+        NAU7802.cpp \
+        NAU7802Reader.cpp \
+        I2CBus.cpp \
+        GpioLine.cpp \
+        MockI2CBus.cpp \
+        MockGpioLine.cpp \
+        ScaleClock.cpp \
+        SimNAU7802.cpp \
+        Decimator.cpp \
+        SlidingMedian.cpp \
+        HampelFilter.cpp \
+        StabilityDetector.cpp \
+        ScaleRegistry.cpp \
+        Protocol.cpp \
+        ConnectionManager.cpp
+
+HEADERS  += ScaleDriver.h \
+            HX711.h \
+            HX711Port.h \
+            HX711Reader.h \
+            SimHX711.h \
+            CaptureFormat.h \
+            CaptureWriter.h \
+            ReplayDriver.h \
+            NAU7802.h \
+            NAU7802Reader.h \
+            SampleRing.h \
+            SampleStore.h \
+            I2CBus.h \
+            GpioLine.h \
+            MockI2CBus.h \
+            MockGpioLine.h \
+            ScaleClock.h \
+            SimNAU7802.h \
+            Decimator.h \
+            SlidingMedian.h \
+            HampelFilter.h \
+            StabilityDetector.h \
+            ScaleRegistry.h \
+            Protocol.h \
+            ConnectionManager.h
+
+LIBS += -lwiringPi
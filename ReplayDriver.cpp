@@ -0,0 +1,178 @@
+#include "ReplayDriver.h"
+#include "ScaleClock.h"
+#include <QThread>
+#include <QDebug>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** longest single wait, so a stop request is seen promptly ***
+const qint64 MAX_WAIT_NSEC = 100000000;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ReplayThread class - runs ReplayDriver::replay() off the GUI thread.
+ */
+//*****************************************************************************
+class ReplayThread : public QThread
+{
+public:
+
+    ReplayThread( ReplayDriver *scale ) : QThread() { scale_ = scale; }
+
+protected:
+
+    void run() override { scale_->replay(); }
+
+private:
+
+    ReplayDriver *scale_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+ReplayDriver::ReplayDriver( const QString &path, double speed, int rawTare, double scale,
+                            const t_StabilityConfig &stability, ScaleClock *clock )
+    : ScaleDriver( rawTare, scale, clock )
+{
+    records_    = nullptr;
+    numRecords_ = 0;
+    speed_      = qMax( 0.0, speed );
+    ready_      = false;
+    replayed_   = 0;
+
+    //*** size the pipeline the way the capture was taken ***
+    error_ = openCapture( path, stability );
+
+    thread_ = new ReplayThread( this );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ReplayDriver::~ReplayDriver()
+{
+    //*** stop replaying before the mapping goes away ***
+    thread_->requestInterruption();
+    thread_->wait();
+    delete thread_;
+
+    qDebug() << "Replay" << file_.fileName() << ":" << replayed() << "of" << numRecords_ << "records";
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+QString ReplayDriver::openCapture( const QString &path, const t_StabilityConfig &stability )
+{
+t_CaptureHeader header;
+
+    file_.setFileName( path );
+    if ( !file_.open( QIODevice::ReadOnly ) )
+    {
+        return QString( "Can't open capture %1: %2" ).arg( path ).arg( file_.errorString() );
+    }
+
+    //*** check the header ***
+    if ( file_.read( reinterpret_cast<char*>( &header ), sizeof(header) ) != sizeof(header) ||
+         header.magic != CAPTURE_MAGIC )
+    {
+        return QString( "%1 is not a capture file" ).arg( path );
+    }
+    if ( header.version != CAPTURE_VERSION || header.headerSize < sizeof( t_CaptureHeader ) ||
+         header.recordSize != sizeof( t_CaptureRecord ) )
+    {
+        return QString( "%1 is capture version %2, expected %3" ).arg( path ).arg( header.version ).arg( CAPTURE_VERSION );
+    }
+    if ( header.headerSize > static_cast<quint64>( file_.size() ) )
+    {
+        return QString( "%1 is cut off in its header" ).arg( path );
+    }
+
+    //*** whole records only - a capture cut short ends at the last one ***
+    numRecords_ = ( static_cast<quint64>( file_.size() ) - header.headerSize ) / header.recordSize;
+
+    //*** map the records - pages are read in as they are replayed ***
+    if ( numRecords_ > 0 )
+    {
+        uchar *data = file_.map( header.headerSize, numRecords_ * header.recordSize );
+        if ( !data )
+        {
+            numRecords_ = 0;
+            return QString( "Can't map capture %1: %2" ).arg( path ).arg( file_.errorString() );
+        }
+        records_ = reinterpret_cast<const t_CaptureRecord*>( data );
+    }
+
+    chip_ = QString::fromLatin1( header.chip, qstrnlen( header.chip, CAPTURE_CHIP_LEN ) );
+
+    setupPipeline( static_cast<int>( header.sampleRate ), static_cast<int>( header.outputRate ),
+                   static_cast<int>( header.weightSamples ), static_cast<int>( header.numChannels ),
+                   stability );
+
+    qDebug() << "Replaying" << path << ":" << chip_ << numRecords_ << "records at"
+             << header.sampleRate << "SPS," << header.numChannels << "channel(s)";
+
+    return QString();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReplayDriver::start()
+{
+    if ( !error_.isEmpty() )
+    {
+        qDebug() << error_;
+        emit failed( error_ );
+        return;
+    }
+
+    thread_->start();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReplayDriver::replay()
+{
+qint64 base = clock_->nsecs();
+qint64 first = 0;
+qint64 timestamp;
+qint64 wait;
+
+    ready_ = true;
+    emit ready();
+
+    if ( numRecords_ > 0 ) first = records_[0].timestamp;
+
+    for ( quint64 i=0; i<numRecords_; i++ )
+    {
+        if ( thread_->isInterruptionRequested() ) return;
+
+        const t_CaptureRecord &rec = records_[i];
+        if ( rec.channel >= static_cast<quint16>( numChannels_ ) ) continue;
+
+        //*** recorded spacing, scaled by the speed and moved onto our clock ***
+        timestamp = base + static_cast<qint64>( ( rec.timestamp - first ) / ( speed_ > 0.0 ? speed_ : 1.0 ) );
+
+        //*** pace it - in short waits so a stop isn't held up ***
+        if ( speed_ > 0.0 )
+        {
+            while ( ( wait = timestamp - clock_->nsecs() ) > 0 )
+            {
+                if ( thread_->isInterruptionRequested() ) return;
+                clock_->sleepNsec( qMin( wait, MAX_WAIT_NSEC ) );
+            }
+        }
+
+        if ( addConversion( rec.channel, rec.value, timestamp ) ) sampleAdded( timestamp );
+        replayed_++;
+    }
+
+    emit replayDone();
+}
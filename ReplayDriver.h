@@ -0,0 +1,89 @@
+#ifndef REPLAYDRIVER_H
+#define REPLAYDRIVER_H
+
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include "ScaleDriver.h"
+#include "CaptureFormat.h"
+
+class ReplayThread;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ReplayDriver class - plays a capture file back as a scale.
+ *
+ *  The file is memory mapped, so even a capture of a whole distribution day
+ *  opens instantly and only the pages being replayed are read in. The pipeline
+ *  is sized from the capture header and every record goes through the same
+ *  addConversion() path as a live chip, so the weights, stable weight events
+ *  and GUI behave exactly as they did on the day.
+ *
+ *  Records are replayed at their recorded spacing times the speed factor, or
+ *  back to back if the speed is 0. Timestamps are moved to the clock in use.
+ */
+//*****************************************************************************
+class ReplayDriver : public ScaleDriver
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor - speed 1.0 is as recorded, 2.0 twice as fast, 0 as fast as possible ***
+    ReplayDriver( const QString &path, double speed, int rawTare, double scale,
+                  const t_StabilityConfig &stability = StabilityDetector::defaultConfig(),
+                  ScaleClock *clock = nullptr );
+
+    //*** destructor ***
+    ~ReplayDriver();
+
+    //*** chip name ***
+    QString name() const override { return QString( "replay" ); }
+
+    //*** start replaying in the background - connect to ready()/failed() first ***
+    void start() override;
+
+    //*** capture is open and records are being replayed ***
+    bool isReady() const override { return ready_.load(); }
+
+    //*** records in the capture / replayed so far ***
+    quint64 numRecords() const { return numRecords_; }
+    quint64 replayed() const { return replayed_.load(); }
+
+    //*** chip the capture was taken from ***
+    QString capturedChip() const { return chip_; }
+
+    //*** replay every record - called by the replay thread ***
+    void replay();
+
+signals:
+
+    //*** last record replayed ***
+    void replayDone();
+
+private:
+
+    //*** map the file and check the header - returns an error, empty if ok ***
+    QString openCapture( const QString &path, const t_StabilityConfig &stability );
+
+    //*** capture file and its mapping ***
+    QFile file_;
+    const t_CaptureRecord *records_;
+    quint64 numRecords_;
+    QString chip_;
+    QString error_;
+
+    //*** playback speed factor, 0 for no waits ***
+    double speed_;
+
+    //*** replay thread ***
+    ReplayThread *thread_;
+
+    //*** state ***
+    std::atomic<bool> ready_;
+    std::atomic<quint64> replayed_;
+};
+
+#endif // REPLAYDRIVER_H
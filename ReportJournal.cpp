@@ -0,0 +1,330 @@
+#include "ReportJournal.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** longest a written record waits for fsync ***
+const int JOURNAL_SYNC_MSEC = 200;
+
+
+//*****************************************************************************
+//*****************************************************************************
+ReportJournal::ReportJournal( QObject *parent ) : QObject( parent )
+{
+    loadOffset_  = 0;
+    fileEnd_     = 0;
+    lastId_      = 0;
+    lastAck_     = 0;
+    sentThrough_ = 0;
+    sentMsec_    = 0;
+    added_       = 0;
+    ackedCount_  = 0;
+    resent_      = 0;
+
+    //*** records written close together share one fsync ***
+    syncTimer_.setSingleShot( true );
+    syncTimer_.setInterval( JOURNAL_SYNC_MSEC );
+    connect( &syncTimer_, &QTimer::timeout, this, &ReportJournal::sync );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ReportJournal::~ReportJournal()
+{
+    sync();
+    file_.close();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ReportJournal::open( const QString &path )
+{
+t_JournalRecord rec;
+qint64 good = 0;
+
+    file_.setFileName( path );
+    if ( !file_.open( QIODevice::ReadWrite ) )
+    {
+        qDebug() << "Can't open report journal" << path << ":" << file_.errorString();
+        return false;
+    }
+
+    //*** last id used and acked - stop at the first record that isn't whole ***
+    file_.seek( 0 );
+    while ( file_.read( reinterpret_cast<char*>( &rec ), sizeof(rec) ) == sizeof(rec) &&
+            rec.magic == JOURNAL_MAGIC && ( rec.type == JOURNAL_REPORT || rec.type == JOURNAL_ACK ) )
+    {
+        if ( rec.type == JOURNAL_REPORT ) lastId_ = qMax( lastId_, rec.report.reportId );
+        else lastAck_ = qMax( lastAck_, rec.report.reportId );
+        good += sizeof(rec);
+    }
+
+    //*** torn write from a power loss - drop it ***
+    if ( good < file_.size() )
+    {
+        qDebug() << "Report journal" << path << "- dropping" << file_.size() - good << "bytes of torn record";
+        file_.resize( good );
+    }
+
+    lastId_      = qMax( lastId_, lastAck_ );
+    sentThrough_ = lastAck_;
+    fileEnd_     = good;
+
+    //*** unacked reports are read in from the start ***
+    loadOffset_ = 0;
+    refill();
+
+    if ( depth() > 0 ) qDebug() << "Report journal" << path << "-" << depth() << "reports not acked";
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReportJournal::refill()
+{
+t_JournalRecord rec;
+
+    if ( loadOffset_ >= fileEnd_ || window_.size() >= JOURNAL_WINDOW ) return;
+
+    //*** pick up where the window ends ***
+    file_.seek( loadOffset_ );
+    while ( window_.size() < JOURNAL_WINDOW && loadOffset_ < fileEnd_ )
+    {
+        if ( file_.read( reinterpret_cast<char*>( &rec ), sizeof(rec) ) != sizeof(rec) ) break;
+        loadOffset_ += sizeof(rec);
+
+        //*** acks, and reports already acked, are passed over ***
+        if ( rec.type == JOURNAL_REPORT && rec.report.reportId > lastAck_ &&
+             ( window_.isEmpty() || rec.report.reportId > window_.last().report.reportId ) )
+        {
+            window_.enqueue( rec );
+        }
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ReportJournal::append( const t_JournalRecord &rec )
+{
+bool loaded = ( loadOffset_ == fileEnd_ );   // everything before this is in the window
+
+    file_.seek( fileEnd_ );
+    if ( file_.write( reinterpret_cast<const char*>( &rec ), sizeof(rec) ) != sizeof(rec) )
+    {
+        qDebug() << "Can't write report journal:" << file_.errorString();
+        return false;
+    }
+
+    //*** out of the process now - fsync follows shortly ***
+    file_.flush();
+    fileEnd_ += sizeof(rec);
+    if ( !syncTimer_.isActive() ) syncTimer_.start();
+
+    //*** a new report goes straight in the window if there's room and nothing waiting on disk ***
+    if ( loaded && ( rec.type != JOURNAL_REPORT || window_.size() < JOURNAL_WINDOW ) )
+    {
+        if ( rec.type == JOURNAL_REPORT ) window_.enqueue( rec );
+        loadOffset_ = fileEnd_;
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint32 ReportJournal::add( int key, float weight, qint64 day, int station )
+{
+t_JournalRecord rec;
+
+    if ( !file_.isOpen() ) return 0;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.magic = JOURNAL_MAGIC;
+    rec.type = JOURNAL_REPORT;
+    rec.queuedMsec = QDateTime::currentMSecsSinceEpoch();
+    rec.report.key = key;
+    rec.report.weight = weight;
+    rec.report.day = day;
+    rec.report.station = station;
+    rec.report.reportId = lastId_ + 1;
+
+    if ( !append( rec ) ) return 0;
+
+    lastId_ = rec.report.reportId;
+    added_++;
+
+    return lastId_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReportJournal::acked( quint32 reportId )
+{
+t_JournalRecord rec;
+
+    //*** only what has been added, and only forwards ***
+    reportId = qMin( reportId, lastId_ );
+    if ( reportId <= lastAck_ ) return;
+
+    ackedCount_ += reportId - lastAck_;
+    lastAck_ = reportId;
+    if ( sentThrough_ < lastAck_ ) sentThrough_ = lastAck_;
+
+    while ( !window_.isEmpty() && window_.head().report.reportId <= lastAck_ )
+    {
+        window_.dequeue();
+    }
+
+    //*** remembered, so they aren't sent again after a restart ***
+    memset( &rec, 0, sizeof(rec) );
+    rec.magic = JOURNAL_MAGIC;
+    rec.type = JOURNAL_ACK;
+    rec.queuedMsec = QDateTime::currentMSecsSinceEpoch();
+    rec.report.reportId = lastAck_;
+    append( rec );
+
+    refill();
+    compact();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReportJournal::compact()
+{
+t_JournalRecord rec;
+QString path = file_.fileName();
+QString tmpPath = path + ".tmp";
+QFile tmp( tmpPath );
+int dir;
+
+    if ( depth() > 0 || fileEnd_ < JOURNAL_COMPACT_BYTES ) return;
+
+    //*** start over with just the last ack, so ids keep going up ***
+    memset( &rec, 0, sizeof(rec) );
+    rec.magic = JOURNAL_MAGIC;
+    rec.type = JOURNAL_ACK;
+    rec.queuedMsec = QDateTime::currentMSecsSinceEpoch();
+    rec.report.reportId = lastAck_;
+
+    //*** written and on the disk beside the journal before it replaces it ***
+    //*** a power loss at any point leaves the old journal or the new one ***
+    if ( !tmp.open( QIODevice::WriteOnly | QIODevice::Truncate ) ||
+         tmp.write( reinterpret_cast<const char*>( &rec ), sizeof(rec) ) != sizeof(rec) ||
+         !tmp.flush() || fdatasync( tmp.handle() ) != 0 )
+    {
+        qDebug() << "Can't compact report journal" << tmpPath << ":" << tmp.errorString();
+        tmp.close();
+        QFile::remove( tmpPath );
+        return;
+    }
+    tmp.close();
+
+    if ( ::rename( QFile::encodeName( tmpPath ).constData(), QFile::encodeName( path ).constData() ) != 0 )
+    {
+        qDebug() << "Can't compact report journal" << path << ":" << strerror( errno );
+        QFile::remove( tmpPath );
+        return;
+    }
+
+    //*** and the rename itself ***
+    dir = ::open( QFile::encodeName( QFileInfo( path ).absolutePath() ).constData(), O_RDONLY );
+    if ( dir >= 0 )
+    {
+        fsync( dir );
+        ::close( dir );
+    }
+
+    //*** the old journal is gone - carry on in the new one ***
+    syncTimer_.stop();
+    file_.close();
+    if ( !file_.open( QIODevice::ReadWrite ) )
+    {
+        qDebug() << "Can't reopen report journal" << path << ":" << file_.errorString();
+    }
+    fileEnd_    = file_.isOpen() ? file_.size() : 0;
+    loadOffset_ = fileEnd_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ReportJournal::takeUnsent( QVector<t_WeightRecord> &batch, int max )
+{
+    batch.clear();
+
+    foreach( const t_JournalRecord &rec, window_ )
+    {
+        if ( batch.size() >= max ) break;
+        if ( rec.report.reportId > sentThrough_ ) batch.append( rec.report );
+    }
+
+    if ( !batch.isEmpty() )
+    {
+        sentThrough_ = batch.last().reportId;
+        sentMsec_ = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    return batch.size();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReportJournal::resend()
+{
+    if ( sentThrough_ > lastAck_ ) resent_++;
+    sentThrough_ = lastAck_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint64 ReportJournal::unackedSentMsec() const
+{
+    if ( sentThrough_ <= lastAck_ ) return -1;
+
+    return QDateTime::currentMSecsSinceEpoch() - sentMsec_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReportJournal::getStats( t_JournalStats &stats ) const
+{
+    stats.depth         = depth();
+    stats.oldestAgeMsec = window_.isEmpty() ? 0 : QDateTime::currentMSecsSinceEpoch() - window_.head().queuedMsec;
+    stats.added         = added_;
+    stats.acked         = ackedCount_;
+    stats.resent        = resent_;
+    stats.fileBytes     = fileEnd_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ReportJournal::sync()
+{
+    syncTimer_.stop();
+
+    if ( !file_.isOpen() ) return;
+
+    file_.flush();
+    fdatasync( file_.handle() );
+}
@@ -0,0 +1,136 @@
+#ifndef REPORTJOURNAL_H
+#define REPORTJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QQueue>
+#include <QVector>
+#include <QTimer>
+#include "Protocol.h"
+
+//*** unacked reports held in memory - the rest wait on disk ***
+const int JOURNAL_WINDOW = 1024;
+
+//*** the file is emptied once everything is acked and it's grown past this ***
+const qint64 JOURNAL_COMPACT_BYTES = 1024 * 1024;
+
+//*** one journal record - a report, or an ack for everything up to an id ***
+typedef struct
+{
+    quint32 magic;              // JOURNAL_MAGIC
+    quint32 type;               // JOURNAL_xx
+    qint64  queuedMsec;         // wall clock time the report was added
+    t_WeightRecord report;      // report, or just its reportId for an ack
+} t_JournalRecord;
+
+const quint32 JOURNAL_MAGIC = 0x4a524650;    // "PFRJ"
+
+typedef enum
+{
+    JOURNAL_REPORT = 1,
+    JOURNAL_ACK    = 2,
+} Journal_Type;
+
+static_assert( sizeof( t_JournalRecord ) == 40, "journal record layout changed" );
+
+//*** journal metrics ***
+typedef struct
+{
+    int depth;                  // reports not acked yet
+    qint64 oldestAgeMsec;       // age of the oldest of them, 0 if none
+    quint64 added;              // reports added since opened
+    quint64 acked;              // of those and earlier ones, acked
+    quint64 resent;             // times the unacked reports were sent again
+    qint64 fileBytes;           // size of the journal file
+} t_JournalStats;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ReportJournal class - weight reports kept until fpSvr has them.
+ *
+ *  Every report is appended to a journal file before it is sent and stays
+ *  there until it is acked, so a report made while fpSvr is down, or lost
+ *  with a dying socket, is sent again rather than lost. Records go to the
+ *  kernel as they are written; fsync is batched. A torn record at the end
+ *  (power lost mid write) is cut off when the journal is opened.
+ *
+ *  Only the oldest JOURNAL_WINDOW unacked reports are held in memory, the
+ *  rest are read back from the file as acks make room. Acks are cumulative.
+ */
+//*****************************************************************************
+class ReportJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor ***
+    explicit ReportJournal( QObject *parent = nullptr );
+
+    //*** destructor - syncs and closes the file ***
+    ~ReportJournal();
+
+    //*** open (or create) the journal - unacked reports in it are pending again ***
+    bool open( const QString &path );
+
+    //*** add a report - returns its id (0 if it couldn't be written) ***
+    quint32 add( int key, float weight, qint64 day, int station );
+
+    //*** every report up to and including reportId is stored ***
+    void acked( quint32 reportId );
+
+    //*** next reports not sent since the last resend(), oldest first - returns how many ***
+    int takeUnsent( QVector<t_WeightRecord> &batch, int max );
+
+    //*** send every unacked report again ***
+    void resend();
+
+    //*** msec since unacked reports were last handed out, -1 if there are none ***
+    qint64 unackedSentMsec() const;
+
+    //*** reports not acked yet - ids are handed out one after another ***
+    int depth() const { return static_cast<int>( lastId_ - lastAck_ ); }
+
+    //*** metrics ***
+    void getStats( t_JournalStats &stats ) const;
+
+    //*** write everything to the disk now ***
+    void sync();
+
+private:
+
+    //*** append a record - marks the file for the next sync ***
+    bool append( const t_JournalRecord &rec );
+
+    //*** read unacked reports from the file into the window ***
+    void refill();
+
+    //*** replace the file with just the last ack once nothing is pending ***
+    void compact();
+
+    //*** journal file, its end, and where the reports not in memory start ***
+    QFile file_;
+    qint64 fileEnd_;
+    qint64 loadOffset_;
+
+    //*** oldest unacked reports - at most JOURNAL_WINDOW ***
+    QQueue<t_JournalRecord> window_;
+
+    //*** ids - last added, last acked, last handed out to be sent ***
+    quint32 lastId_;
+    quint32 lastAck_;
+    quint32 sentThrough_;
+    qint64 sentMsec_;
+
+    //*** batched fsync ***
+    QTimer syncTimer_;
+
+    //*** counters ***
+    quint64 added_;
+    quint64 ackedCount_;
+    quint64 resent_;
+};
+
+#endif // REPORTJOURNAL_H
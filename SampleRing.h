@@ -0,0 +1,151 @@
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <QtGlobal>
+#include <atomic>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SampleRing class - fixed capacity, lock-free ring of samples.
+ *
+ *  There is exactly one producer (the acquisition thread) which calls push().
+ *  Readers never remove anything - they look at the most recent samples.
+ *  The producer overwrites the oldest entry when the ring is full, so a reader
+ *  re-checks the write count after copying and retries if the slots it read
+ *  were overwritten underneath it.
+ *
+ *  CAPACITY must be a power of 2.
+ */
+//*****************************************************************************
+template <typename T, int CAPACITY>
+class SampleRing
+{
+public:
+
+    //*** non-owning view of a run of items - the run may wrap, so it is ***
+    //*** held as two contiguous pieces. It points into the ring, so it is ***
+    //*** only good until the producer laps it - check with isValid() ***
+    class View
+    {
+    public:
+        View() : first(nullptr), firstLen(0), second(nullptr), secondLen(0), start(0) {}
+
+        int size() const { return firstLen + secondLen; }
+        const T &operator[]( int i ) const { return ( i < firstLen ) ? first[i] : second[i - firstLen]; }
+
+        const T *first;     // oldest piece
+        int firstLen;
+        const T *second;    // newest piece (wrapped around)
+        int secondLen;
+        quint64 start;      // index of the first item
+    };
+
+    SampleRing() : written_(0) {}
+
+    //*** add a new item - producer thread only ***
+    void push( const T &item )
+    {
+        quint64 idx = written_.load( std::memory_order_relaxed );
+        buf_[ idx & MASK ] = item;
+        written_.store( idx + 1, std::memory_order_release );
+    }
+
+    //*** total number of items ever pushed ***
+    quint64 written() const { return written_.load( std::memory_order_acquire ); }
+
+    //*** number of items currently held ***
+    int size() const
+    {
+        quint64 w = written();
+        return ( w < static_cast<quint64>(CAPACITY) ) ? static_cast<int>(w) : CAPACITY;
+    }
+
+    bool isEmpty() const { return written() == 0; }
+
+    static int capacity() { return CAPACITY; }
+
+    //*** copy the most recent 'num' items, oldest first, into 'out' ***
+    //*** returns the number of items actually copied ***
+    int latest( int num, T *out ) const
+    {
+        //*** never ask for more than we can safely hold while being written ***
+        num = qMin( num, CAPACITY / 2 );
+
+        while ( true )
+        {
+            quint64 end = written();
+            int count = static_cast<int>( qMin( static_cast<quint64>(num), end ) );
+            quint64 start = end - count;
+
+            for ( int i=0; i<count; i++ )
+            {
+                out[i] = buf_[ (start + i) & MASK ];
+            }
+
+            //*** make sure the producer did not lap us while copying - once it has ***
+            //*** written CAPACITY more it may be part way into our first slot ***
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( written_.load( std::memory_order_relaxed ) - start < static_cast<quint64>(CAPACITY) )
+            {
+                return count;
+            }
+        }
+    }
+
+    //*** copy the item with the given absolute index (0 = first ever pushed) ***
+    //*** returns false if it hasn't been written yet or was overwritten ***
+    bool at( quint64 index, T &out ) const
+    {
+        if ( index >= written() ) return false;
+
+        out = buf_[ index & MASK ];
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        return ( written_.load( std::memory_order_relaxed ) - index < static_cast<quint64>(CAPACITY) );
+    }
+
+    //*** view of the most recent 'num' items, oldest first - nothing is copied ***
+    View view( int num ) const
+    {
+    View v;
+
+        num = qMin( num, CAPACITY / 2 );
+
+        quint64 end = written();
+        int count = static_cast<int>( qMin( static_cast<quint64>(num), end ) );
+        v.start = end - count;
+
+        //*** split where the run wraps around the end of the buffer ***
+        int startPos = static_cast<int>( v.start & MASK );
+        v.first    = &buf_[ startPos ];
+        v.firstLen = qMin( count, CAPACITY - startPos );
+        v.second    = &buf_[ 0 ];
+        v.secondLen = count - v.firstLen;
+
+        return v;
+    }
+
+    //*** true if none of the items in the view have been overwritten ***
+    bool isValid( const View &v ) const
+    {
+        std::atomic_thread_fence( std::memory_order_acquire );
+        return ( written_.load( std::memory_order_relaxed ) - v.start < static_cast<quint64>(CAPACITY) );
+    }
+
+private:
+
+    static_assert( (CAPACITY & (CAPACITY - 1)) == 0, "SampleRing capacity must be a power of 2" );
+
+    static const quint64 MASK = CAPACITY - 1;
+
+    //*** storage ***
+    T buf_[ CAPACITY ];
+
+    //*** count of items written - also the next write position ***
+    std::atomic<quint64> written_;
+
+    Q_DISABLE_COPY( SampleRing )
+};
+
+#endif // SAMPLERING_H
@@ -0,0 +1,244 @@
+#ifndef SAMPLESTORE_H
+#define SAMPLESTORE_H
+
+#include "SampleRing.h"
+
+//*** one timestamped scale sample ***
+typedef struct
+{
+    qint32  value;      // raw 24 bit ADC value (sign extended)
+    qint64  timestamp;  // monotonic time of the sample (nsec)
+    quint64 seq;        // sequence number - 0 for the first sample ever pushed
+    quint64 cumSum;     // running sum of all values up to this one (wraps)
+    quint64 cumSq;      // running sum of squares up to this one (wraps)
+    qint32  winMin;     // min of the tracked window ending here
+    qint32  winMax;     // max of the tracked window ending here
+} t_Sample;
+
+//*** statistics over the last N samples ***
+typedef struct
+{
+    int    count;           // samples actually used
+    double mean;
+    double variance;        // sample variance ( n-1 )
+    qint32 min;
+    qint32 max;
+    qint64 firstTimestamp;
+    qint64 lastTimestamp;
+} t_WindowStats;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SampleStore class - sample ring with O(1) window statistics.
+ *
+ *  The producer keeps running sums and sums of squares in every slot, so the
+ *  mean and variance of the last N samples come from two slots. The sums are
+ *  kept in wrapping 64 bit unsigned arithmetic - the difference between two
+ *  slots is still exact, so nothing drifts no matter how long we run.
+ *  Min and max for the tracked window are maintained with monotonic queues
+ *  on the producer side and stored in each slot as well.
+ *
+ *  Nothing here allocates. Readers never lock and never copy more than the
+ *  slots they need.
+ */
+//*****************************************************************************
+template <int CAPACITY>
+class SampleStore
+{
+public:
+
+    typedef typename SampleRing<t_Sample,CAPACITY>::View View;
+
+    SampleStore()
+        : cumSum_(0), cumSq_(0), window_(1), minHead_(0), minTail_(0), maxHead_(0), maxTail_(0) {}
+
+    //*** window for the O(1) min/max - set before samples start ***
+    void setTrackedWindow( int num ) { window_ = qBound( 1, num, CAPACITY / 2 ); }
+    int trackedWindow() const { return window_; }
+
+    //*** add a sample - producer thread only ***
+    void push( qint32 value, qint64 timestamp )
+    {
+    t_Sample s;
+
+        quint64 idx = ring_.written();
+
+        //*** running sums ***
+        cumSum_ += static_cast<quint64>( static_cast<qint64>( value ) );
+        cumSq_  += static_cast<quint64>( static_cast<qint64>( value ) * value );
+
+        //*** min queue - values increasing from head ***
+        while ( minTail_ != minHead_ && minVal_[ (minTail_ - 1) & MASK ] >= value ) minTail_--;
+        minIdx_[ minTail_ & MASK ] = idx;
+        minVal_[ minTail_ & MASK ] = value;
+        minTail_++;
+        while ( minIdx_[ minHead_ & MASK ] + window_ <= idx ) minHead_++;
+
+        //*** max queue - values decreasing from head ***
+        while ( maxTail_ != maxHead_ && maxVal_[ (maxTail_ - 1) & MASK ] <= value ) maxTail_--;
+        maxIdx_[ maxTail_ & MASK ] = idx;
+        maxVal_[ maxTail_ & MASK ] = value;
+        maxTail_++;
+        while ( maxIdx_[ maxHead_ & MASK ] + window_ <= idx ) maxHead_++;
+
+        s.value     = value;
+        s.timestamp = timestamp;
+        s.seq       = idx;
+        s.cumSum    = cumSum_;
+        s.cumSq     = cumSq_;
+        s.winMin    = minVal_[ minHead_ & MASK ];
+        s.winMax    = maxVal_[ maxHead_ & MASK ];
+
+        ring_.push( s );
+    }
+
+    //*** statistics of the last 'num' samples - false if there are none ***
+    bool stats( int num, t_WindowStats &st ) const
+    {
+        num = qBound( 1, num, CAPACITY / 2 );
+
+        while ( true )
+        {
+            quint64 end = ring_.written();
+            if ( end == 0 ) return false;
+
+            quint64 count = qMin( static_cast<quint64>(num), end );
+
+            //*** retry if the producer lapped us ***
+            if ( rangeStats( end - count, count, count == qMin( static_cast<quint64>( window_ ), end ), st ) ) return true;
+        }
+    }
+
+    //*** statistics of 'num' samples starting at sequence number 'first' ***
+    //*** false if they haven't all arrived yet or have already been overwritten ***
+    bool stats( quint64 first, int num, t_WindowStats &st ) const
+    {
+        if ( num < 1 || num > CAPACITY / 2 || first + num > ring_.written() ) return false;
+
+        return rangeStats( first, static_cast<quint64>( num ), false, st );
+    }
+
+    //*** sequence number of the first sample taken after 'timestamp' ***
+    //*** written() if there is none yet, the oldest one held if all are newer ***
+    quint64 firstAfter( qint64 timestamp ) const
+    {
+    t_Sample s;
+
+        while ( true )
+        {
+            quint64 end = ring_.written();
+            quint64 lo  = ( end > static_cast<quint64>( CAPACITY / 2 ) ) ? end - CAPACITY / 2 : 0;
+            quint64 hi  = end;
+            bool lapped = false;
+
+            //*** timestamps only increase - binary search what is held ***
+            while ( lo < hi )
+            {
+                quint64 mid = lo + ( hi - lo ) / 2;
+                if ( !ring_.at( mid, s ) )
+                {
+                    lapped = true;
+                    break;
+                }
+
+                if ( s.timestamp > timestamp ) hi = mid;
+                else lo = mid + 1;
+            }
+
+            if ( !lapped ) return lo;
+        }
+    }
+
+    //*** copy the most recent samples, oldest first ***
+    int latest( int num, t_Sample *out ) const { return ring_.latest( num, out ); }
+
+    //*** non-owning view of the most recent samples ***
+    View view( int num ) const { return ring_.view( num ); }
+    bool isValid( const View &v ) const { return ring_.isValid( v ); }
+
+    //*** total samples ever pushed ***
+    quint64 written() const { return ring_.written(); }
+
+private:
+
+    static const quint64 MASK = CAPACITY - 1;
+
+    //*** statistics of 'count' samples from 'start' - false if the producer lapped us ***
+    //*** 'tracked' says they are exactly the tracked window ending at the newest sample ***
+    bool rangeStats( quint64 start, quint64 count, bool tracked, t_WindowStats &st ) const
+    {
+    t_Sample last, first, before;
+
+        //*** the slots we need ***
+        if ( !ring_.at( start + count - 1, last ) ) return false;
+        if ( !ring_.at( start, first ) ) return false;
+
+        quint64 sumBefore = 0;
+        quint64 sqBefore  = 0;
+        if ( start > 0 )
+        {
+            if ( !ring_.at( start - 1, before ) ) return false;
+            sumBefore = before.cumSum;
+            sqBefore  = before.cumSq;
+        }
+
+        //*** exact window sums (wrapping arithmetic) ***
+        quint64 sum = last.cumSum - sumBefore;
+        quint64 sq  = last.cumSq - sqBefore;
+
+        //*** center on the newest value so the numbers stay small ***
+        //*** d1 = sum(x - r), d2 = sum((x - r)^2) ***
+        quint64 r = static_cast<quint64>( static_cast<qint64>( last.value ) );
+        qint64 d1 = static_cast<qint64>( sum - count * r );
+        qint64 d2 = static_cast<qint64>( sq - 2 * r * sum + count * r * r );
+
+        double n = static_cast<double>( count );
+        st.count = static_cast<int>( count );
+        st.mean  = static_cast<double>( last.value ) + static_cast<double>( d1 ) / n;
+        st.variance = ( count > 1 ) ? qMax( 0.0, ( static_cast<double>( d2 ) - static_cast<double>( d1 ) * static_cast<double>( d1 ) / n ) / ( n - 1.0 ) )
+                                    : 0.0;
+        st.firstTimestamp = first.timestamp;
+        st.lastTimestamp  = last.timestamp;
+
+        //*** tracked window comes for free, anything else is a scan of the slots ***
+        if ( tracked )
+        {
+            st.min = last.winMin;
+            st.max = last.winMax;
+            return true;
+        }
+
+        st.min = first.value;
+        st.max = first.value;
+        for ( quint64 i=start+1; i<start+count; i++ )
+        {
+            t_Sample s;
+            if ( !ring_.at( i, s ) ) return false;
+            st.min = qMin( st.min, s.value );
+            st.max = qMax( st.max, s.value );
+        }
+
+        return true;
+    }
+
+    SampleRing<t_Sample,CAPACITY> ring_;
+
+    //*** producer side state ***
+    quint64 cumSum_;
+    quint64 cumSq_;
+    int window_;
+
+    //*** monotonic queues for window min/max ***
+    quint64 minIdx_[ CAPACITY ];
+    qint32  minVal_[ CAPACITY ];
+    quint64 minHead_, minTail_;
+    quint64 maxIdx_[ CAPACITY ];
+    qint32  maxVal_[ CAPACITY ];
+    quint64 maxHead_, maxTail_;
+
+    Q_DISABLE_COPY( SampleStore )
+};
+
+#endif // SAMPLESTORE_H
@@ -0,0 +1,83 @@
+#include "ScaleClock.h"
+#include <QThread>
+
+
+//*****************************************************************************
+//*****************************************************************************
+ScaleClock *ScaleClock::system()
+{
+static RealClock clock;
+
+    return &clock;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+RealClock::RealClock()
+{
+    timer_.start();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint64 RealClock::nsecs()
+{
+    return timer_.nsecsElapsed();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void RealClock::sleepNsec( qint64 nsec )
+{
+    if ( nsec > 0 ) QThread::usleep( static_cast<unsigned long>( nsec / 1000 ) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+SimClock::SimClock( double speed )
+    : now_( 0 )
+{
+    speed_ = speed;
+    timer_.start();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint64 SimClock::nsecs()
+{
+    //*** free running - only sleeps move time ***
+    if ( speed_ <= 0.0 ) return now_.load();
+
+    return static_cast<qint64>( static_cast<double>( timer_.nsecsElapsed() ) * speed_ );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimClock::sleepNsec( qint64 nsec )
+{
+    if ( nsec <= 0 ) return;
+
+    //*** free running ***
+    if ( speed_ <= 0.0 )
+    {
+        now_ += nsec;
+        return;
+    }
+
+    //*** scaled real time ***
+    QThread::usleep( static_cast<unsigned long>( static_cast<double>( nsec ) / speed_ / 1000.0 ) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimClock::advance( qint64 nsec )
+{
+    if ( speed_ <= 0.0 && nsec > 0 ) now_ += nsec;
+}
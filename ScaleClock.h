@@ -0,0 +1,97 @@
+#ifndef SCALECLOCK_H
+#define SCALECLOCK_H
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+#include <atomic>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ScaleClock class - monotonic time source for the scale drivers.
+ *
+ *  All driver timing (sample timestamps, power up and calibration waits,
+ *  polling) goes through a clock so that simulated hardware can be run
+ *  faster than real time.
+ */
+//*****************************************************************************
+class ScaleClock
+{
+public:
+
+    virtual ~ScaleClock() {}
+
+    //*** monotonic time in nsec ***
+    virtual qint64 nsecs() = 0;
+
+    //*** block the calling thread for the given time ***
+    virtual void sleepNsec( qint64 nsec ) = 0;
+
+    //*** convenience helpers ***
+    qint64 msecs() { return nsecs() / 1000000; }
+    void sleepMsec( int msec ) { sleepNsec( static_cast<qint64>(msec) * 1000000 ); }
+
+    //*** the real time clock shared by everyone ***
+    static ScaleClock *system();
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The RealClock class - wall clock (monotonic) time
+ */
+//*****************************************************************************
+class RealClock : public ScaleClock
+{
+public:
+
+    RealClock();
+
+    qint64 nsecs() override;
+    void sleepNsec( qint64 nsec ) override;
+
+private:
+
+    QElapsedTimer timer_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SimClock class - simulated time.
+ *
+ *  With a speed > 0, simulated time runs that many times faster than real
+ *  time and sleeps are shortened to match.
+ *  With a speed of 0, time only moves when someone sleeps - every sleep
+ *  returns immediately after advancing the clock. This runs a single
+ *  acquisition thread as fast as the CPU allows.
+ */
+//*****************************************************************************
+class SimClock : public ScaleClock
+{
+public:
+
+    //*** constructor ***
+    explicit SimClock( double speed = 0.0 );
+
+    qint64 nsecs() override;
+    void sleepNsec( qint64 nsec ) override;
+
+    //*** move time forward without sleeping (speed 0 only) ***
+    void advance( qint64 nsec );
+
+private:
+
+    //*** time multiplier - 0 = free running ***
+    double speed_;
+
+    //*** real time base when speed > 0 ***
+    QElapsedTimer timer_;
+
+    //*** simulated time when speed == 0 ***
+    std::atomic<qint64> now_;
+};
+
+#endif // SCALECLOCK_H
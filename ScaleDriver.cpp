@@ -0,0 +1,612 @@
+#include "ScaleDriver.h"
+#include "ScaleClock.h"
+#include "CaptureWriter.h"
+#include <QMutexLocker>
+#include <cmath>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+//*** most samples handed out by one request ***
+const int MAX_REQUEST        = 64;
+
+//*** outlier threshold - 3 sigma, but never under ~0.01 lb of noise ***
+const double OUTLIER_K       = 3.0;
+const int OUTLIER_MIN_COUNTS = 100;
+
+//*** a bit over half the 0.1 display step, so the display doesn't flicker between two values ***
+const double WEIGHT_HYSTERESIS = 0.06;
+
+
+//*****************************************************************************
+//*****************************************************************************
+ScaleDriver::ScaleDriver( int rawTare, double scale, ScaleClock *clock )
+    : QObject()
+{
+    clock_ = clock ? clock : ScaleClock::system();
+
+    //*** until setupPipeline() says otherwise ***
+    numChannels_   = 1;
+    sampleRate_    = 1;
+    outputRate_    = 1;
+    weightSamples_ = 1;
+    capture_       = nullptr;
+
+    numRequests_   = 0;
+    nextRequestId_ = 0;
+
+    //*** fresh samples go from the acquisition context to the GUI thread ***
+    qRegisterMetaType<t_FreshSamples>( "t_FreshSamples" );
+
+    snapVersion_   = 0;
+    snapWeight_    = 0.0f;
+    snapSeq_       = 0;
+    snapTimestamp_ = 0;
+    snapStable_    = false;
+
+    hysteresis_     = WEIGHT_HYSTERESIS;
+    reportedWeight_ = 0.0;
+    reported_       = false;
+
+    calVersion_ = 0;
+
+    for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+    {
+        calTare_[ch]  = rawTare;
+        calScale_[ch] = scale;
+
+        blockStart_[ch] = -1;
+
+        conversions_[ch] = 0;
+        discarded_[ch]   = 0;
+        switches_[ch]    = 0;
+        switchNsec_[ch]  = 0;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ScaleDriver::~ScaleDriver()
+{
+
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::setupPipeline( int sps, int outputRate, int weightSamples, int numChannels,
+                                 const t_StabilityConfig &stability )
+{
+    //*** raw conversions per decimated sample ***
+    int factor = qMax( 1, sps / qMax( 1, outputRate ) );
+
+    numChannels_   = qBound( 1, numChannels, SCALE_MAX_CHANNELS );
+    sampleRate_    = qMax( 1, sps );
+    outputRate_    = sampleRate_ / factor;
+    weightSamples_ = qBound( 1, weightSamples, MAX_REQUEST );
+
+    //*** settled load detection on the decimated stream ***
+    stabilityConfig_ = stability;
+    stabilityConfig_.windowSamples = qBound( 2, stabilityConfig_.windowSamples, MAX_REQUEST );
+    stability_.setConfig( stabilityConfig_ );
+
+    //*** same pipeline for each channel - the second stays empty unless in use ***
+    for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+    {
+        decimator_[ch].setFactor( factor );
+        blockStart_[ch] = -1;
+
+        //*** spike rejection ahead of the decimator ***
+        outlierFilter_[ch].setWindow( HampelFilter::windowForRate( sps / numChannels_ ) );
+        outlierFilter_[ch].setThreshold( OUTLIER_K, OUTLIER_MIN_COUNTS );
+
+        //*** min/max of the weight window are kept up to date as samples arrive ***
+        samples_[ch].setTrackedWindow( weightSamples_ );
+        rawSamples_[ch].setTrackedWindow( weightSamples_ * factor );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ScaleDriver::addConversion( int channel, qint32 value, qint64 timestamp )
+{
+qint32 output;
+CaptureWriter *capture = capture_.load();
+
+    conversions_[channel]++;
+
+    //*** keep a copy for offline tuning ***
+    if ( capture ) capture->record( channel, value, timestamp );
+
+    //*** publish it - ring drops the oldest data on its own ***
+    rawSamples_[channel].push( value, timestamp );
+
+    //*** decimated stream is stamped with the middle of its block ***
+    if ( blockStart_[channel] < 0 ) blockStart_[channel] = timestamp;
+
+    //*** replace spikes before they get averaged in ***
+    if ( !decimator_[channel].add( outlierFilter_[channel].filter( value ), output ) ) return false;
+
+    samples_[channel].push( output, blockStart_[channel] + ( timestamp - blockStart_[channel] ) / 2 );
+    blockStart_[channel] = -1;
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::restartChannel( int channel )
+{
+    //*** old readings say nothing about the new input ***
+    decimator_[channel].reset();
+    outlierFilter_[channel].reset();
+    blockStart_[channel] = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::sampleAdded( qint64 timestamp )
+{
+t_Calibration cal;
+double weight;
+bool haveWeight;
+
+    //*** one calibration for everything worked out from this sample ***
+    calibration( cal );
+
+    haveWeight = currentWeight( cal, weight );
+    checkStability( cal, timestamp );
+
+    //*** worked out once here - every reader gets this copy ***
+    if ( haveWeight ) publishWeight( weight, timestamp );
+
+    //*** tell the display only when the weight really moved ***
+    if ( haveWeight && ( !reported_ || std::fabs( weight - reportedWeight_ ) >= hysteresis_.load() ) )
+    {
+        reportedWeight_ = weight;
+        reported_       = true;
+        emit weightChanged( static_cast<float>( weight ) );
+    }
+
+    //*** someone waiting for new samples ***
+    if ( numRequests_.load() > 0 ) checkFreshRequests();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::publishWeight( double weight, qint64 timestamp )
+{
+quint64 version = snapVersion_.load( std::memory_order_relaxed );
+
+    //*** odd - readers retry until we are done ***
+    snapVersion_.store( version + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    snapWeight_.store( static_cast<float>( weight ), std::memory_order_relaxed );
+    snapSeq_.store( samples_[SCALE_CHANNEL_1].written() - 1, std::memory_order_relaxed );
+    snapTimestamp_.store( timestamp, std::memory_order_relaxed );
+    snapStable_.store( stability_.isStable(), std::memory_order_relaxed );
+
+    snapVersion_.store( version + 2, std::memory_order_release );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ScaleDriver::weightSnapshot( t_WeightSnapshot &snapshot ) const
+{
+quint64 before;
+quint64 after;
+
+    do
+    {
+        before = snapVersion_.load( std::memory_order_acquire );
+        if ( before == 0 ) return false;
+
+        snapshot.weight    = snapWeight_.load( std::memory_order_relaxed );
+        snapshot.seq       = snapSeq_.load( std::memory_order_relaxed );
+        snapshot.timestamp = snapTimestamp_.load( std::memory_order_relaxed );
+        snapshot.stable    = snapStable_.load( std::memory_order_relaxed );
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        after = snapVersion_.load( std::memory_order_relaxed );
+    }
+    while ( ( before & 1 ) || before != after );
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ScaleDriver::requestFreshSamples( int numSamples, qint64 sinceNsec )
+{
+QMutexLocker lock( &requestLock_ );
+t_FreshRequest request;
+
+    if ( sinceNsec < 0 ) sinceNsec = clock_->nsecs();
+
+    //*** decimated samples are stamped mid block - skip any block that started before ***
+    qint64 after = sinceNsec + 500000000LL / qMax( 1, outputRate_ );
+
+    request.id       = ++nextRequestId_;
+    request.num      = qBound( 1, numSamples, MAX_REQUEST );
+    request.reported = -1;
+    for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+    {
+        request.firstSeq[ch] = samples_[ch].firstAfter( after );
+    }
+
+    requests_.append( request );
+    numRequests_ = requests_.size();
+
+    return request.id;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::cancelFreshSamples( int id )
+{
+QMutexLocker lock( &requestLock_ );
+
+    for ( int i=0; i<requests_.size(); i++ )
+    {
+        if ( requests_[i].id == id )
+        {
+            requests_.removeAt( i );
+            break;
+        }
+    }
+
+    numRequests_ = requests_.size();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::checkFreshRequests()
+{
+QList<t_FreshSamples> done;
+QList<t_FreshRequest> progress;
+t_WindowStats stats;
+
+    //*** signals go out after the lock is released, so a slot can make another request ***
+    requestLock_.lock();
+
+    for ( int i=0; i<requests_.size(); i++ )
+    {
+        t_FreshRequest &request = requests_[i];
+
+        //*** the channel furthest behind decides ***
+        quint64 collected = request.num;
+        for ( int ch=0; ch<numChannels_; ch++ )
+        {
+            quint64 written = samples_[ch].written();
+            quint64 have = ( written > request.firstSeq[ch] ) ? written - request.firstSeq[ch] : 0;
+            collected = qMin( collected, have );
+        }
+
+        if ( static_cast<int>( collected ) > request.reported )
+        {
+            request.reported = static_cast<int>( collected );
+            progress.append( request );
+        }
+
+        if ( static_cast<int>( collected ) < request.num ) continue;
+
+        //*** all there - average exactly those samples ***
+        t_FreshSamples samples;
+        samples.id    = request.id;
+        samples.count = request.num;
+        for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+        {
+            samples.mean[ch]     = 0.0;
+            samples.firstSeq[ch] = request.firstSeq[ch];
+
+            if ( ch >= numChannels_ || !samples_[ch].stats( request.firstSeq[ch], request.num, stats ) ) continue;
+
+            samples.mean[ch] = stats.mean;
+            if ( ch == SCALE_CHANNEL_1 )
+            {
+                samples.firstTimestamp = stats.firstTimestamp;
+                samples.lastTimestamp  = stats.lastTimestamp;
+            }
+        }
+
+        done.append( samples );
+        requests_.removeAt( i-- );
+    }
+
+    numRequests_ = requests_.size();
+    requestLock_.unlock();
+
+    foreach( const t_FreshRequest &request, progress )
+    {
+        emit freshSamplesProgress( request.id, request.reported, request.num );
+    }
+    foreach( const t_FreshSamples &samples, done )
+    {
+        emit freshSamplesReady( samples );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::checkStability( const t_Calibration &cal, qint64 timestamp )
+{
+t_WindowStats all;
+t_WindowStats recent;
+int num = stabilityConfig_.windowSamples;
+double weight = 0.0;
+double variance = 0.0;
+double slope = 0.0;
+
+    //*** channels are independent - weights and slopes add, so do variances ***
+    for ( int ch=0; ch<numChannels_; ch++ )
+    {
+        //*** need a full window ***
+        if ( !samples_[ch].stats( num, all ) || all.count < num ) return;
+        if ( !samples_[ch].stats( num / 2, recent ) ) return;
+
+        //*** slope from the mean of the newer half vs the older half ***
+        double olderMean = ( all.mean * all.count - recent.mean * recent.count ) / ( all.count - recent.count );
+        double halfSpan  = static_cast<double>( all.lastTimestamp - all.firstTimestamp ) / 2.0e9;
+
+        //*** thresholds are in weight units ***
+        weight   += ( all.mean - static_cast<double>( cal.tare[ch] ) ) * cal.scale[ch];
+        variance += all.variance * cal.scale[ch] * cal.scale[ch];
+        if ( halfSpan > 0.0 ) slope += ( recent.mean - olderMean ) / halfSpan * cal.scale[ch];
+    }
+
+    if ( stability_.update( std::sqrt( variance ), slope, timestamp ) )
+    {
+        emit stableWeight( static_cast<float>( weight ), static_cast<int>( stability_.settleNsec() / 1000000 ) );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+float ScaleDriver::getWeight()
+{
+t_WeightSnapshot snapshot;
+
+    if ( !weightSnapshot( snapshot ) ) return -1.0;
+
+    return snapshot.weight;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ScaleDriver::currentWeight( const t_Calibration &cal, double &weight )
+{
+double channel;
+
+    weight = 0.0;
+
+    //*** platform weight is the sum of the load cells ***
+    for ( int ch=0; ch<numChannels_; ch++ )
+    {
+        if ( !channelWeight( cal, ch, weightSamples_, channel ) ) return false;
+        weight += channel;
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+QString ScaleDriver::formatWeight( float weight )
+{
+QString text;
+
+    text.sprintf( "%.1f", weight );
+
+    //*** no negative 0s ***
+    if ( text == "-0.0" ) text = "0.0";
+
+    return text;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ScaleDriver::channelWeight( const t_Calibration &cal, int channel, int num, double &weight )
+{
+t_WindowStats stats;
+
+    //*** window average comes straight from the running sums ***
+    if ( !samples_[channel].stats( num, stats ) ) return false;
+
+    //*** compute the average weight ***
+    weight = ( stats.mean - static_cast<double>( cal.tare[channel] ) ) * cal.scale[channel];
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ScaleDriver::getRawAvg( int numSamples, int channel )
+{
+t_WindowStats stats;
+
+    //*** no data ***
+    if ( !samples_[channel].stats( qMin( numSamples, MAX_REQUEST ), stats ) ) return 0;
+
+    //*** window average comes straight from the running sums ***
+    return static_cast<int>( stats.mean );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool ScaleDriver::getWindowStats( int numSamples, t_WindowStats &stats, int channel )
+{
+    return samples_[channel].stats( numSamples, stats );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::getChannelStats( int channel, t_ChannelStats &stats )
+{
+t_WindowStats window;
+
+    stats.conversions = conversions_[channel].load();
+    stats.discarded   = discarded_[channel].load();
+    stats.switches    = switches_[channel].load();
+    stats.switchUsec  = ( stats.switches > 0 ) ? switchNsec_[channel].load() / 1000.0 / stats.switches : 0.0;
+
+    //*** effective rate from the timestamps of the recent samples ***
+    stats.outputRate = 0.0;
+    if ( samples_[channel].stats( MAX_REQUEST, window ) && window.count > 1 &&
+         window.lastTimestamp > window.firstTimestamp )
+    {
+        stats.outputRate = ( window.count - 1 ) * 1.0e9 / ( window.lastTimestamp - window.firstTimestamp );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::setCalibrationData( int tareVal, int weightVal, float actualWeight, int channel )
+{
+QMutexLocker lock( &calLock_ );
+
+    //*** calculate scale factor ***
+    double weight = static_cast<double>(actualWeight);
+    double scale = (double)( weight / ((double)weightVal - (double)tareVal) );
+
+    //*** save it with the new raw tare value ***
+    writeCalibration( channel, tareVal, scale );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::setCalibration( int channel, int rawTareValue, double scaleValue )
+{
+QMutexLocker lock( &calLock_ );
+
+    writeCalibration( channel, rawTareValue, scaleValue );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::getCalibrationData( int &rawTareValue, double &scaleValue, int channel )
+{
+t_Calibration cal;
+
+    calibration( cal );
+
+    rawTareValue = cal.tare[channel];
+    scaleValue = cal.scale[channel];
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::setTare( int tareVal, int channel )
+{
+QMutexLocker lock( &calLock_ );
+
+    writeCalibration( channel, tareVal, calScale_[channel].load( std::memory_order_relaxed ) );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::writeCalibration( int channel, int tare, double scale )
+{
+quint64 version = calVersion_.load( std::memory_order_relaxed );
+
+    //*** odd - the producer retries until we are done ***
+    calVersion_.store( version + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    calTare_[channel].store( tare, std::memory_order_relaxed );
+    calScale_[channel].store( scale, std::memory_order_relaxed );
+
+    calVersion_.store( version + 2, std::memory_order_release );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleDriver::calibration( t_Calibration &cal ) const
+{
+quint64 before;
+quint64 after;
+
+    do
+    {
+        before = calVersion_.load( std::memory_order_acquire );
+
+        for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+        {
+            cal.tare[ch]  = calTare_[ch].load( std::memory_order_relaxed );
+            cal.scale[ch] = calScale_[ch].load( std::memory_order_relaxed );
+        }
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        after = calVersion_.load( std::memory_order_relaxed );
+    }
+    while ( ( before & 1 ) || before != after );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+template <int CAPACITY>
+static int copyValues( const SampleStore<CAPACITY> &store, int numSamples, t_DataSet &data )
+{
+    //*** grab requested samples from end of ring - retry if overwritten while copying ***
+    do
+    {
+        typename SampleStore<CAPACITY>::View view = store.view( qMin( numSamples, MAX_REQUEST ) );
+
+        //*** clear output data ***
+        data.clear();
+
+        //*** add to list ***
+        data.reserve( view.size() );
+        for ( int i=0; i<view.size(); i++ )
+        {
+            data.append( view[i].value );
+        }
+
+        if ( store.isValid( view ) ) break;
+    }
+    while ( true );
+
+    return data.size();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ScaleDriver::collectRawData( int numSamples, t_DataSet &data, int channel )
+{
+    //*** conversions exactly as read from the chip ***
+    return copyValues( rawSamples_[channel], numSamples, data );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ScaleDriver::collectProcessedData(int numSamples, t_DataSet &data, int channel)
+{
+    //*** outliers were replaced as the samples arrived - see addConversion() ***
+    return copyValues( samples_[channel], numSamples, data );
+}
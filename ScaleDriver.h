@@ -0,0 +1,305 @@
+#ifndef SCALEDRIVER_H
+#define SCALEDRIVER_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QMutex>
+#include <QMetaType>
+#include <atomic>
+#include "SampleStore.h"
+#include "Decimator.h"
+#include "HampelFilter.h"
+#include "StabilityDetector.h"
+
+class ScaleClock;
+class CaptureWriter;
+
+typedef QList<int> t_DataSet;
+
+//*** decimated sample store used for weights ***
+typedef SampleStore<256> WeightStore;
+
+//*** load cell channels a driver can sample ***
+typedef enum
+{
+    SCALE_CHANNEL_1 = 0,
+    SCALE_CHANNEL_2 = 1,
+} Scale_Channels;
+
+const int SCALE_MAX_CHANNELS = 2;
+
+//*** scale drivers MainWindow can pick from ***
+typedef enum
+{
+    SCALE_DRIVER_NAU7802 = 0,
+    SCALE_DRIVER_HX711   = 1,
+} Scale_Driver_Type;
+
+//Per channel acquisition counters
+typedef struct
+{
+    quint64 conversions;  //Conversions kept
+    quint64 discarded;    //Conversions thrown away while settling after a switch
+    quint64 switches;     //Switches to this channel
+    double switchUsec;    //Average time to issue a switch
+    double outputRate;    //Measured decimated samples per second
+} t_ChannelStats;
+
+//Samples collected for a requestFreshSamples() call
+typedef struct
+{
+    int id;                                   //Request id
+    int count;                                //Decimated samples averaged on each channel
+    double mean[ SCALE_MAX_CHANNELS ];        //Raw average of each channel in use
+    quint64 firstSeq[ SCALE_MAX_CHANNELS ];   //Sequence number of the first sample used on each channel
+    qint64 firstTimestamp;                    //Oldest sample used (nsec, channel 1)
+    qint64 lastTimestamp;                     //Newest sample used (nsec, channel 1)
+} t_FreshSamples;
+
+Q_DECLARE_METATYPE( t_FreshSamples )
+
+//Latest weight, worked out once per decimated sample
+typedef struct
+{
+    float weight;         //Weight of all channels added
+    quint64 seq;          //Sequence number of the newest channel 1 sample in it
+    qint64 timestamp;     //Time of the conversion that completed it (nsec)
+    bool stable;          //Load has settled
+} t_WeightSnapshot;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ScaleDriver class - what every load cell ADC driver looks like.
+ *
+ *  A driver brings its chip up, then feeds each conversion to addConversion()
+ *  from a single producer context (an acquisition thread or an ISR). The
+ *  pipeline behind it - raw ring, outlier rejection, decimation, weight ring
+ *  and stability detection - is shared by all drivers, as are the weight,
+ *  calibration and sample access methods the GUI thread uses. Those only
+ *  read the lock-free rings, so they never block the producer.
+ */
+//*****************************************************************************
+class ScaleDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor - all timing uses the given clock (real time if none) ***
+    ScaleDriver( int rawTare, double scale, ScaleClock *clock = nullptr );
+
+    //*** destructor ***
+    virtual ~ScaleDriver();
+
+    //*** chip name for logs and the display ***
+    virtual QString name() const = 0;
+
+    //*** start bring-up and sampling - connect to ready()/failed() first ***
+    virtual void start() = 0;
+
+    //*** bring-up finished and samples are being taken ***
+    virtual bool isReady() const = 0;
+
+    //*** request the current scale weight (all channels added) - -1 until there is one ***
+    //*** reads the latest snapshot, so tare/calibration changes show from the next sample ***
+    float getWeight();
+
+    //*** latest weight with its sample and stability - false until there is one ***
+    //*** lock-free, any thread, never waits on the producer ***
+    bool weightSnapshot( t_WeightSnapshot &snapshot ) const;
+
+    //*** smallest change in weight that is reported by weightChanged() ***
+    void setWeightHysteresis( double hysteresis ) { hysteresis_ = hysteresis; }
+
+    //*** weight as shown on the display - one decimal, no negative 0 ***
+    static QString formatWeight( float weight );
+
+    //*** sampling both channels ***
+    bool isDualChannel() const { return numChannels_ > 1; }
+    int numChannels() const { return numChannels_; }
+
+    //*** pipeline settings ***
+    int sampleRate() const { return sampleRate_; }
+    int outputRate() const { return outputRate_; }
+    int weightSamples() const { return weightSamples_; }
+
+    //*** record every conversion to a capture file, nullptr to stop - not owned ***
+    //*** stop the driver before deleting the writer ***
+    void setCapture( CaptureWriter *capture ) { capture_ = capture; }
+
+    //*** collect n samples  ***
+    int collectRawData( int numSamples, t_DataSet &data, int channel = SCALE_CHANNEL_1 );
+
+    //*** collect n samples - reject outliers ***
+    int collectProcessedData( int numSamples, t_DataSet &data, int channel = SCALE_CHANNEL_1 );
+
+    //*** get the raw average of n samples - reject outliers ***
+    int getRawAvg( int numSamples, int channel = SCALE_CHANNEL_1 );
+
+    //*** mean/variance/min/max of the last n samples - O(1), no allocation ***
+    bool getWindowStats( int numSamples, t_WindowStats &stats, int channel = SCALE_CHANNEL_1 );
+
+    //*** average the next num decimated samples taken entirely after sinceNsec (now if -1) ***
+    //*** freshSamplesProgress() follows them arriving, freshSamplesReady() has the result ***
+    //*** returns the request id - any thread ***
+    int requestFreshSamples( int numSamples, qint64 sinceNsec = -1 );
+
+    //*** forget a request that hasn't finished ***
+    void cancelFreshSamples( int id );
+
+    //*** sample store - view() gives non-owning access to the last n samples ***
+    const WeightStore &samples( int channel = SCALE_CHANNEL_1 ) const { return samples_[channel]; }
+
+    //*** switch overhead and effective sample rate of a channel ***
+    void getChannelStats( int channel, t_ChannelStats &stats );
+
+    //*** set the data used for calibration ***
+    void setCalibrationData( int tareVal, int weightVal, float actualWeight, int channel = SCALE_CHANNEL_1 );
+
+    //*** set the calibration of a channel directly ***
+    void setCalibration( int channel, int rawTareValue, double scaleValue );
+
+    //*** get the data derived from the calibration ***
+    void getCalibrationData( int &rawTareValue, double &scaleValue, int channel = SCALE_CHANNEL_1 );
+
+    //*** start using a new tare value ***
+    void setTare( int tareVal, int channel = SCALE_CHANNEL_1 );
+
+signals:
+
+    //*** bring-up finished - samples are on their way ***
+    void ready();
+
+    //*** bring-up failed - no samples will be taken ***
+    void failed( QString reason );
+
+    //*** the weight moved by more than the hysteresis - emitted from the acquisition context ***
+    void weightChanged( float weight );
+
+    //*** fresh samples for a request are arriving / all there - emitted from the acquisition context ***
+    void freshSamplesProgress( int id, int collected, int needed );
+    void freshSamplesReady( t_FreshSamples samples );
+
+    //*** a new load has settled - emitted from the acquisition context ***
+    //*** settleMsec is the time from the load starting to move until now ***
+    void stableWeight( float weight, int settleMsec );
+
+protected:
+
+    //*** size the pipeline - call from the constructor, before any conversions ***
+    //*** sps is the conversion rate shared by all channels ***
+    void setupPipeline( int sps, int outputRate, int weightSamples, int numChannels,
+                        const t_StabilityConfig &stability );
+
+    //*** push one conversion through the pipeline - producer only ***
+    //*** returns true when it completed a decimated sample ***
+    bool addConversion( int channel, qint32 value, qint64 timestamp );
+
+    //*** throw away the partial block and filter history of a channel - producer only ***
+    void restartChannel( int channel );
+
+    //*** a decimated sample was added to every channel in use - producer only ***
+    //*** reports weight changes and checks for a settled load ***
+    void sampleAdded( qint64 timestamp );
+
+    //*** calibration of every channel, as one consistent copy ***
+    typedef struct
+    {
+        int tare[ SCALE_MAX_CHANNELS ];
+        double scale[ SCALE_MAX_CHANNELS ];
+    } t_Calibration;
+
+    //*** consistent copy of the calibration - lock-free, any thread, never torn by a setTare() ***
+    void calibration( t_Calibration &cal ) const;
+
+    //*** weight of one channel averaged over the last num samples ***
+    bool channelWeight( const t_Calibration &cal, int channel, int num, double &weight );
+
+    //*** time source for timestamps and waits - not owned ***
+    ScaleClock *clock_;
+
+    //*** channels in use, conversion and output rates, decimated samples per weight ***
+    int numChannels_;
+    int sampleRate_;
+    int outputRate_;
+    int weightSamples_;
+
+    //*** per channel counters - written by the producer ***
+    std::atomic<quint64> conversions_[ SCALE_MAX_CHANNELS ];
+    std::atomic<quint64> discarded_[ SCALE_MAX_CHANNELS ];
+    std::atomic<quint64> switches_[ SCALE_MAX_CHANNELS ];
+    std::atomic<qint64> switchNsec_[ SCALE_MAX_CHANNELS ];
+
+private:
+
+    //*** feed the latest weight window to the stability detector - producer only ***
+    void checkStability( const t_Calibration &cal, qint64 timestamp );
+
+    //*** weight of all channels added - false if there aren't enough samples yet ***
+    bool currentWeight( const t_Calibration &cal, double &weight );
+
+    //*** publish a channel's calibration - calLock_ must be held ***
+    void writeCalibration( int channel, int tare, double scale );
+
+    //*** make a new weight snapshot visible - producer only ***
+    void publishWeight( double weight, qint64 timestamp );
+
+    //*** progress and results of fresh sample requests - producer only ***
+    void checkFreshRequests();
+
+    //*** raw conversions at the chip rate, before outlier rejection - written only by the producer ***
+    SampleStore<1024> rawSamples_[ SCALE_MAX_CHANNELS ];
+
+    //*** decimated samples used for weights - written only by the producer ***
+    WeightStore samples_[ SCALE_MAX_CHANNELS ];
+
+    //*** outlier rejection and boxcar filter between the two rings - producer only ***
+    HampelFilter outlierFilter_[ SCALE_MAX_CHANNELS ];
+    Decimator decimator_[ SCALE_MAX_CHANNELS ];
+    qint64 blockStart_[ SCALE_MAX_CHANNELS ];
+
+    //*** raw capture, if recording ***
+    std::atomic<CaptureWriter*> capture_;
+
+    //*** settled load detection - producer only ***
+    t_StabilityConfig stabilityConfig_;
+    StabilityDetector stability_;
+
+    //*** fresh sample requests - count readable without the lock ***
+    typedef struct
+    {
+        int id;
+        int num;
+        quint64 firstSeq[ SCALE_MAX_CHANNELS ];
+        int reported;
+    } t_FreshRequest;
+
+    QMutex requestLock_;
+    QList<t_FreshRequest> requests_;
+    std::atomic<int> numRequests_;
+    int nextRequestId_;
+
+    //*** latest weight - a seqlock: version is odd while the producer writes, 0 before the first ***
+    std::atomic<quint64> snapVersion_;
+    std::atomic<float> snapWeight_;
+    std::atomic<quint64> snapSeq_;
+    std::atomic<qint64> snapTimestamp_;
+    std::atomic<bool> snapStable_;
+
+    //*** last weight reported by weightChanged() - producer only ***
+    std::atomic<double> hysteresis_;
+    double reportedWeight_;
+    bool reported_;
+
+    //*** raw tare value (zero weight) and scale factor to weight units of each channel ***
+    //*** a seqlock like the weight snapshot - written under calLock_, read with calibration() ***
+    QMutex calLock_;
+    std::atomic<quint64> calVersion_;
+    std::atomic<int> calTare_[ SCALE_MAX_CHANNELS ];
+    std::atomic<double> calScale_[ SCALE_MAX_CHANNELS ];
+};
+
+#endif // SCALEDRIVER_H
@@ -0,0 +1,427 @@
+#include "ScaleRegistry.h"
+#include "NAU7802.h"
+#include "HX711.h"
+#include "HX711Port.h"
+#include "SimHX711.h"
+#include "I2CBus.h"
+#include "GpioLine.h"
+#include "SimNAU7802.h"
+#include "ScaleClock.h"
+#include "ReplayDriver.h"
+#include "CaptureWriter.h"
+#include <QSettings>
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
+
+//*** single scale keys - station 1 when there is no station array ***
+const QString TARE_STR   = "TARE";
+const QString SCALE_STR  = "SCALE";
+const QString TARE2_STR  = "TARE_2";
+const QString SCALE2_STR = "SCALE_2";
+const QString DRDY_STR   = "DRDY_GPIO";
+const QString I2C_STR    = "I2C_BUS";
+const QString ADDR_STR   = "I2C_ADDR";
+const QString SIM_STR    = "SIM_SCALE";
+const QString RATE_STR   = "HIGH_RATE_SPS";
+const QString DUAL_STR   = "DUAL_CHANNEL";
+const QString ID_STR     = "ID";
+const QString DRIVER_STR = "DRIVER";
+const QString DT_STR     = "HX711_DT";
+const QString SCK_STR    = "HX711_SCK";
+const QString GAIN_STR   = "HX711_GAIN";
+const QString PORT_STR   = "HX711_PORT";
+const QString REPLAY_STR = "REPLAY_FILE";
+const QString SPEED_STR  = "REPLAY_SPEED";
+
+//*** station array ***
+const QString STATIONS_STR = "STATIONS";
+
+const int    DEFAULT_TARE  = -214054;
+const double DEFAULT_SCALE = 0.0000913017;
+const int    DEFAULT_DRDY  = -1;     // no data ready line - poll the scale
+const int    DEFAULT_I2C   = 1;      // /dev/i2c-1, -1 to use wiringPi
+
+//*** HX711 wiring and calibration from the original board ***
+const int    DEFAULT_HX711_DT    = 21;
+const int    DEFAULT_HX711_SCK   = 20;
+const int    DEFAULT_HX711_TARE  = -267362;
+const double DEFAULT_HX711_SCALE = 0.00022527;
+
+const QString GPIO_CHIP = "/dev/gpiochip0";
+
+
+//*****************************************************************************
+//*****************************************************************************
+ScaleRegistry::ScaleRegistry( QObject *parent )
+    : QObject( parent )
+{
+    startMsec_ = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+ScaleRegistry::~ScaleRegistry()
+{
+    //*** how much the stations got through together ***
+    if ( startMsec_ >= 0 )
+    {
+        qint64 msecs = qMax( static_cast<qint64>( 1 ), ScaleClock::system()->msecs() - startMsec_ );
+        quint64 total = totalConversions();
+
+        qDebug() << scales_.size() << "stations:" << total << "conversions in" << msecs << "msec,"
+                 << total * 1000.0 / msecs << "conversions/sec";
+    }
+
+    //*** each one stops its own acquisition thread ***
+    qDeleteAll( scales_ );
+
+    //*** nothing is recording any more - write what's left ***
+    qDeleteAll( captures_ );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+t_StationConfig ScaleRegistry::defaultStation( int id )
+{
+t_StationConfig config;
+
+    config.id          = id;
+    config.i2cBus      = DEFAULT_I2C;
+    config.i2cAddr     = NAU7802_I2C_ADDR;
+    config.drdyGpio    = DEFAULT_DRDY;
+    config.sim         = false;
+    config.highRateSps = 0;
+    config.dualChannel = false;
+    config.driver      = SCALE_DRIVER_NAU7802;
+    config.hx711Dt     = DEFAULT_HX711_DT;
+    config.hx711Sck    = DEFAULT_HX711_SCK;
+    config.hx711Gain   = HX711_GAIN_A128;
+    config.hx711Port   = HX711_PORT_GPIOCHIP;
+    config.replaySpeed = 1.0;
+
+    for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+    {
+        config.tare[ch]  = DEFAULT_TARE;
+        config.scale[ch] = DEFAULT_SCALE;
+    }
+
+    return config;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+static void readStation( QSettings &s, t_StationConfig &config )
+{
+    config.id          = s.value( ID_STR, config.id ).toInt();
+    config.driver      = s.value( DRIVER_STR, config.driver ).toInt();
+
+    //*** HX711 calibration defaults differ from the NAU7802 ***
+    if ( config.driver == SCALE_DRIVER_HX711 )
+    {
+        config.tare[0]  = DEFAULT_HX711_TARE;
+        config.scale[0] = DEFAULT_HX711_SCALE;
+    }
+
+    config.tare[0]     = s.value( TARE_STR, config.tare[0] ).toInt();
+    config.scale[0]    = s.value( SCALE_STR, config.scale[0] ).toDouble();
+    config.tare[1]     = s.value( TARE2_STR, config.tare[1] ).toInt();
+    config.scale[1]    = s.value( SCALE2_STR, config.scale[1] ).toDouble();
+    config.drdyGpio    = s.value( DRDY_STR, config.drdyGpio ).toInt();
+    config.i2cBus      = s.value( I2C_STR, config.i2cBus ).toInt();
+    config.i2cAddr     = s.value( ADDR_STR, config.i2cAddr ).toInt();
+    config.sim         = s.value( SIM_STR, config.sim ).toBool();
+    config.highRateSps = s.value( RATE_STR, config.highRateSps ).toInt();
+    config.dualChannel = s.value( DUAL_STR, config.dualChannel ).toBool();
+    config.hx711Dt     = s.value( DT_STR, config.hx711Dt ).toInt();
+    config.hx711Sck    = s.value( SCK_STR, config.hx711Sck ).toInt();
+    config.hx711Gain   = s.value( GAIN_STR, config.hx711Gain ).toInt();
+    config.hx711Port   = s.value( PORT_STR, config.hx711Port ).toInt();
+    config.replayFile  = s.value( REPLAY_STR, config.replayFile ).toString();
+    config.replaySpeed = s.value( SPEED_STR, config.replaySpeed ).toDouble();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+static void writeStation( QSettings &s, const t_StationConfig &config )
+{
+    //*** every key readStation() reads, so a save loads back the same ***
+    s.setValue( ID_STR, config.id );
+    s.setValue( DRIVER_STR, config.driver );
+    s.setValue( TARE_STR, config.tare[0] );
+    s.setValue( SCALE_STR, config.scale[0] );
+    s.setValue( TARE2_STR, config.tare[1] );
+    s.setValue( SCALE2_STR, config.scale[1] );
+    s.setValue( DRDY_STR, config.drdyGpio );
+    s.setValue( I2C_STR, config.i2cBus );
+    s.setValue( ADDR_STR, config.i2cAddr );
+    s.setValue( SIM_STR, config.sim );
+    s.setValue( RATE_STR, config.highRateSps );
+    s.setValue( DUAL_STR, config.dualChannel );
+    s.setValue( DT_STR, config.hx711Dt );
+    s.setValue( SCK_STR, config.hx711Sck );
+    s.setValue( GAIN_STR, config.hx711Gain );
+    s.setValue( PORT_STR, config.hx711Port );
+    s.setValue( REPLAY_STR, config.replayFile );
+    s.setValue( SPEED_STR, config.replaySpeed );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+QList<t_StationConfig> ScaleRegistry::loadStations( QSettings &s )
+{
+QList<t_StationConfig> stations;
+
+    int num = s.beginReadArray( STATIONS_STR );
+    for ( int i=0; i<num; i++ )
+    {
+        s.setArrayIndex( i );
+
+        t_StationConfig config = defaultStation( i + 1 );
+        readStation( s, config );
+        stations.append( config );
+    }
+    s.endArray();
+
+    //*** no stations configured - just the one scale ***
+    if ( stations.isEmpty() )
+    {
+        t_StationConfig config = defaultStation( 1 );
+        readStation( s, config );
+        stations.append( config );
+    }
+
+    return stations;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleRegistry::saveStations( QSettings &s, const QList<t_StationConfig> &stations )
+{
+    //*** single scale - keep the original layout ***
+    if ( stations.size() == 1 )
+    {
+        writeStation( s, stations.first() );
+        return;
+    }
+
+    s.beginWriteArray( STATIONS_STR, stations.size() );
+    for ( int i=0; i<stations.size(); i++ )
+    {
+        s.setArrayIndex( i );
+        writeStation( s, stations[i] );
+    }
+    s.endArray();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+QList<t_StationConfig> ScaleRegistry::simStations( int num )
+{
+QList<t_StationConfig> stations;
+
+    for ( int i=0; i<num; i++ )
+    {
+        t_StationConfig config = defaultStation( i + 1 );
+        config.sim = true;
+        stations.append( config );
+    }
+
+    return stations;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ScaleRegistry::addStation( const t_StationConfig &config, const t_StabilityConfig &stability )
+{
+GpioLine *drdyLine = nullptr;
+I2CBus *bus = nullptr;
+HX711Port *port = nullptr;
+ScaleDriver *scale;
+
+    //*** a recorded day played back through the same pipeline ***
+    if ( !config.replayFile.isEmpty() )
+    {
+        scale = new ReplayDriver( config.replayFile, config.replaySpeed, config.tare[0], config.scale[0], stability );
+        scale->setCalibration( SCALE_CHANNEL_2, config.tare[1], config.scale[1] );
+        return addScale( config, scale );
+    }
+
+    //*** HX711 on its own pair of GPIOs ***
+    if ( config.driver == SCALE_DRIVER_HX711 )
+    {
+        if ( config.sim )
+        {
+            port = new SimHX711( ScaleClock::system(), SimHX711::defaultSignal(), 10,
+                                 static_cast<quint32>( config.id ) );
+        }
+
+        //*** register fast path, DT edges still from the kernel ***
+        else if ( config.hx711Port == HX711_PORT_GPIOMEM )
+        {
+            port = new GpioMemHX711Port( config.hx711Dt, config.hx711Sck,
+                                         new GpioChipLine( GPIO_CHIP, config.hx711Dt ) );
+        }
+        else
+        {
+            port = new GpioChipHX711Port( GPIO_CHIP, config.hx711Dt, config.hx711Sck );
+        }
+
+        scale = new HX711( port, config.tare[0], config.scale[0], config.hx711Gain, stability );
+        return addScale( config, scale );
+    }
+
+    //*** simulated scale for running without the board ***
+    if ( config.sim )
+    {
+        SimNAU7802 *sim = new SimNAU7802( ScaleClock::system(), SimNAU7802::defaultSignal(),
+                                          static_cast<quint32>( config.id ) );
+        bus = sim;
+        drdyLine = sim->createDrdyLine();
+
+        //*** load split evenly over two cells ***
+        if ( config.dualChannel ) sim->setChannel2( SimNAU7802::defaultSignal(), 0.5 );
+    }
+
+    //*** talk to i2c-dev directly unless told to use wiringPi ***
+    else if ( config.i2cBus >= 0 )
+    {
+        bus = new I2CDevBus( config.i2cBus, config.i2cAddr );
+    }
+    else
+    {
+        bus = new WiringPiI2CBus( config.i2cAddr );
+    }
+
+    //*** use the CRDY pin if it is wired up ***
+    if ( config.drdyGpio >= 0 && !drdyLine )
+    {
+        drdyLine = new GpioChipLine( GPIO_CHIP, config.drdyGpio );
+    }
+
+    //*** high rate mode - 80 or 320 SPS decimated down ***
+    t_NAU7802Config scaleConfig = NAU7802::defaultConfig();
+    if ( config.highRateSps == 80 )
+    {
+        scaleConfig = NAU7802::highRateConfig( NAU7802_SPS_80 );
+    }
+    else if ( config.highRateSps == 320 )
+    {
+        scaleConfig = NAU7802::highRateConfig( NAU7802_SPS_320 );
+    }
+
+    //*** two load cells - alternate channels, 80 SPS unless asked for 320 ***
+    if ( config.dualChannel )
+    {
+        scaleConfig = NAU7802::dualChannelConfig( config.highRateSps == 320 ? NAU7802_SPS_320 : NAU7802_SPS_80 );
+    }
+    scaleConfig.stability = stability;
+
+    //*** the station's scale ***
+    scale = new NAU7802( config.tare[0], config.scale[0], drdyLine, bus, nullptr, scaleConfig );
+    scale->setCalibration( SCALE_CHANNEL_2, config.tare[1], config.scale[1] );
+
+    return addScale( config, scale );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int ScaleRegistry::addScale( const t_StationConfig &config, ScaleDriver *scale )
+{
+int index = scales_.size();
+
+    configs_.append( config );
+    scales_.append( scale );
+
+    //*** forward its signals tagged with the index ***
+    connect( scale, &ScaleDriver::ready, this, [this, index]() { emit stationReady( index ); } );
+    connect( scale, &ScaleDriver::failed, this, [this, index]( QString reason ) { emit stationFailed( index, reason ); } );
+    connect( scale, &ScaleDriver::weightChanged, this,
+             [this, index]( float weight ) { emit weightChanged( index, weight ); } );
+    connect( scale, &ScaleDriver::freshSamplesProgress, this,
+             [this, index]( int id, int collected, int needed ) { emit freshSamplesProgress( index, id, collected, needed ); } );
+    connect( scale, &ScaleDriver::freshSamplesReady, this,
+             [this, index]( t_FreshSamples samples ) { emit freshSamplesReady( index, samples ); } );
+    connect( scale, &ScaleDriver::stableWeight, this,
+             [this, index]( float weight, int settleMsec ) { emit stableWeight( index, weight, settleMsec ); } );
+
+    return index;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleRegistry::start()
+{
+    startMsec_ = ScaleClock::system()->msecs();
+
+    //*** each station comes up on its own acquisition thread or ISR ***
+    for ( int i=0; i<scales_.size(); i++ )
+    {
+        if ( !captureDir_.isEmpty() ) startCapture( i );
+        scales_[i]->start();
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleRegistry::startCapture( int index )
+{
+    //*** one file per station per run ***
+    QString path = QDir( captureDir_ ).filePath( QString( "station%1-%2.fpcap" )
+                       .arg( configs_[index].id )
+                       .arg( QDateTime::currentDateTime().toString( "yyyyMMdd-hhmmss" ) ) );
+
+    CaptureWriter *capture = new CaptureWriter();
+    if ( !capture->open( path, scales_[index], ScaleClock::system()->nsecs() ) )
+    {
+        delete capture;
+        return;
+    }
+
+    captures_.append( capture );
+    scales_[index]->setCapture( capture );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void ScaleRegistry::updateCalibration( int index )
+{
+    t_StationConfig &config = configs_[index];
+
+    for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+    {
+        scales_[index]->getCalibrationData( config.tare[ch], config.scale[ch], ch );
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 ScaleRegistry::totalConversions()
+{
+quint64 total = 0;
+t_ChannelStats stats;
+
+    foreach( ScaleDriver *scale, scales_ )
+    {
+        for ( int ch=0; ch<SCALE_MAX_CHANNELS; ch++ )
+        {
+            scale->getChannelStats( ch, stats );
+            total += stats.conversions;
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,134 @@
+#ifndef SCALEREGISTRY_H
+#define SCALEREGISTRY_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include "ScaleDriver.h"
+
+class QSettings;
+class CaptureWriter;
+
+//*** one scale station - hardware and calibration profile ***
+typedef struct
+{
+    int    id;              // station number reported to the checkin server
+    int    driver;          // SCALE_DRIVER_xx
+    int    i2cBus;          // /dev/i2c-N, -1 to use wiringPi
+    int    i2cAddr;         // 7 bit address of the NAU7802
+    int    drdyGpio;        // GPIO wired to CRDY, -1 to poll
+    bool   sim;             // simulated scale
+    int    highRateSps;     // 0 (20 SPS), 80 or 320
+    bool   dualChannel;     // load cell on each channel
+    int    hx711Dt;         // HX711 data GPIO
+    int    hx711Sck;        // HX711 clock GPIO
+    int    hx711Gain;       // HX711_GAIN_xx
+    int    hx711Port;       // HX711_PORT_xx
+    QString replayFile;     // capture file to play back instead of a chip, empty for none
+    double replaySpeed;     // playback speed, 1.0 as recorded, 0 as fast as possible
+    int    tare[ SCALE_MAX_CHANNELS ];
+    double scale[ SCALE_MAX_CHANNELS ];
+} t_StationConfig;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The ScaleRegistry class - the scale stations driven by this process.
+ *
+ *  Each station is a NAU7802 or HX711 with its own bus or pins, acquisition
+ *  context and calibration profile. The registry builds them from their profiles and
+ *  forwards their signals tagged with the station's index.
+ *
+ *  Profiles live in the STATIONS settings array. Without one, the single
+ *  scale keys used before stations existed describe station 0.
+ *
+ *  Given a capture directory, every conversion of every station is recorded
+ *  to a capture file there, which a station can later replay in place of
+ *  its chip.
+ */
+//*****************************************************************************
+class ScaleRegistry : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    //*** constructor ***
+    explicit ScaleRegistry( QObject *parent = nullptr );
+
+    //*** destructor - stops and deletes every scale ***
+    ~ScaleRegistry();
+
+    //*** station profiles from / to the settings ***
+    static QList<t_StationConfig> loadStations( QSettings &s );
+    static void saveStations( QSettings &s, const QList<t_StationConfig> &stations );
+
+    //*** profile with default calibration ***
+    static t_StationConfig defaultStation( int id );
+
+    //*** N simulated stations - for load testing ***
+    static QList<t_StationConfig> simStations( int num );
+
+    //*** create a station's scale - returns its index ***
+    int addStation( const t_StationConfig &config, const t_StabilityConfig &stability );
+
+    //*** record each station's conversions to a file in dir - call before start() ***
+    void setCaptureDir( const QString &dir ) { captureDir_ = dir; }
+
+    //*** start bring-up of every station ***
+    void start();
+
+    //*** stations ***
+    int count() const { return scales_.size(); }
+    ScaleDriver *scale( int index ) const { return scales_[index]; }
+    int stationId( int index ) const { return configs_[index].id; }
+
+    //*** copy a scale's current calibration into its profile ***
+    void updateCalibration( int index );
+
+    //*** current profiles, for saving ***
+    const QList<t_StationConfig> &configs() const { return configs_; }
+
+    //*** conversions taken by all stations so far ***
+    quint64 totalConversions();
+
+signals:
+
+    //*** a station finished bring-up ***
+    void stationReady( int index );
+
+    //*** a station could not be brought up ***
+    void stationFailed( int index, QString reason );
+
+    //*** a station's weight moved ***
+    void weightChanged( int index, float weight );
+
+    //*** fresh samples requested from a station are arriving / all there ***
+    void freshSamplesProgress( int index, int id, int collected, int needed );
+    void freshSamplesReady( int index, t_FreshSamples samples );
+
+    //*** a new load settled on a station ***
+    void stableWeight( int index, float weight, int settleMsec );
+
+private:
+
+    //*** keep a new scale and forward its signals - returns its index ***
+    int addScale( const t_StationConfig &config, ScaleDriver *scale );
+
+    //*** start recording a station to the capture directory ***
+    void startCapture( int index );
+
+    //*** profiles and scales, same order ***
+    QList<t_StationConfig> configs_;
+    QList<ScaleDriver*> scales_;
+
+    //*** capture directory (empty for none) and the writers recording to it ***
+    QString captureDir_;
+    QList<CaptureWriter*> captures_;
+
+    //*** when the stations were started (-1 if not yet) - for throughput ***
+    qint64 startMsec_;
+};
+
+#endif // SCALEREGISTRY_H
@@ -0,0 +1,304 @@
+#include "SimHX711.h"
+#include "ScaleClock.h"
+#include "HX711.h"
+#include <QMutexLocker>
+#include <math.h>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+const qint64 NSEC_PER_SEC     = 1000000000;
+
+//*** a stalled pulse - comfortably past the 60 usec power down ***
+const qint64 STALL_NSEC       = 100000;
+
+//*** conversion periods lost to a power down (reset + settling) ***
+const int POWER_UP_PERIODS    = 4;
+
+//*** data bits per conversion ***
+const int NUM_BITS            = 24;
+
+//*** most conversions we bother to generate after an idle stretch ***
+const int MAX_CATCH_UP        = 16;
+
+
+//*****************************************************************************
+//*****************************************************************************
+SimHX711::SimHX711( ScaleClock *clock, const t_SimSignal &signal, int sps, quint32 seed )
+    : rng_( seed ), noise_( 0.0, 1.0 ), chance_( 0.0, 1.0 )
+{
+    clock_  = clock;
+    signal_ = signal;
+    period_ = NSEC_PER_SEC / qMax( 1, sps );
+    load_   = 0.0;
+
+    //*** powered up at gain 128, first conversion one period out ***
+    ready_    = false;
+    latched_  = 0;
+    pulses_   = 0;
+    gain_     = HX711_GAIN_A128;
+    nextConv_ = clock_->nsecs() + period_;
+
+    glitchRate_ = 0.0;
+    stallRate_  = 0.0;
+    glitch_     = false;
+
+    conversions_ = 0;
+    overruns_    = 0;
+    powerDowns_  = 0;
+    glitches_    = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+t_SimSignal SimHX711::defaultSignal()
+{
+t_SimSignal signal;
+
+    //*** the driver negates the reading - tare -267362, 0.00022527 per count ***
+    signal.offset        = 267362.0;
+    signal.countsPerUnit = -4439.0;
+    signal.noise         = 40.0;
+    signal.driftPerSec   = 0.0;
+
+    return signal;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimHX711::update( bool endRead )
+{
+qint64 now = clock_->nsecs();
+
+    //*** trailing pulses of a finished read pick the gain ***
+    if ( endRead && pulses_ > NUM_BITS )
+    {
+        gain_   = qBound( static_cast<int>( HX711_GAIN_A128 ), pulses_, static_cast<int>( HX711_GAIN_A64 ) );
+        pulses_ = 0;
+    }
+
+    //*** the output register isn't touched in the middle of a read ***
+    if ( pulses_ > 0 ) return;
+
+    //*** don't generate a huge backlog after sitting idle ***
+    if ( now - nextConv_ > MAX_CATCH_UP * period_ ) nextConv_ = now - MAX_CATCH_UP * period_;
+
+    while ( nextConv_ <= now )
+    {
+        //*** previous result never read ***
+        if ( ready_ ) overruns_++;
+
+        latched_ = signalAt( nextConv_ );
+        ready_   = true;
+        glitch_  = ( glitchRate_ > 0.0 && chance_( rng_ ) < glitchRate_ );
+
+        conversions_++;
+        nextConv_ += period_;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int SimHX711::waitForReady( int timeoutMsec )
+{
+qint64 now;
+qint64 next;
+qint64 timeout = static_cast<qint64>( timeoutMsec ) * 1000000;
+
+    {
+        QMutexLocker lock( &mutex_ );
+
+        //*** waiting again means the last read is over ***
+        update( true );
+        if ( ready_ ) return 1;
+
+        now  = clock_->nsecs();
+        next = nextConv_;
+    }
+
+    //*** nothing due in time ***
+    if ( ( next - now ) > timeout )
+    {
+        clock_->sleepNsec( timeout );
+        return 0;
+    }
+
+    //*** sleep until the conversion completes ***
+    clock_->sleepNsec( next - now );
+    return 1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int SimHX711::clockBit()
+{
+QMutexLocker lock( &mutex_ );
+
+    if ( pulses_ == 0 ) update( false );
+
+    //*** preempted with SCK high - the chip powers down and resets ***
+    if ( stallRate_ > 0.0 && chance_( rng_ ) < stallRate_ )
+    {
+        clock_->sleepNsec( STALL_NSEC );
+        powerDowns_++;
+
+        ready_    = false;
+        pulses_   = 0;
+        gain_     = HX711_GAIN_A128;
+        nextConv_ = clock_->nsecs() + POWER_UP_PERIODS * period_;
+        return 1;
+    }
+
+    //*** pulses with nothing to read are ignored ***
+    if ( pulses_ == 0 && !ready_ ) return 1;
+
+    pulses_++;
+
+    //*** trailing pulses - DT stays high until the next conversion (low if garbled) ***
+    if ( pulses_ > NUM_BITS ) return glitch_ ? 0 : 1;
+
+    //*** result consumed once the last bit is out ***
+    if ( pulses_ == NUM_BITS )
+    {
+        ready_ = false;
+        if ( glitch_ ) glitches_++;
+    }
+
+    //*** garbled reads are a bit late, as if an edge was missed ***
+    int shift = NUM_BITS - pulses_ + ( glitch_ ? 1 : 0 );
+
+    return ( latched_ >> shift ) & 1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int SimHX711::level()
+{
+QMutexLocker lock( &mutex_ );
+
+    if ( pulses_ == 0 ) update( false );
+
+    //*** between reads DT shows whether a result is waiting ***
+    if ( pulses_ == 0 ) return ready_ ? 0 : 1;
+
+    //*** in a read it shows the last bit shifted out ***
+    if ( pulses_ >= NUM_BITS ) return glitch_ ? 0 : 1;
+
+    return ( latched_ >> ( NUM_BITS - pulses_ ) ) & 1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimHX711::setLoad( double load )
+{
+QMutexLocker lock( &mutex_ );
+
+    update( false );
+    load_ = load;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimHX711::addStep( qint64 atNsec, double load )
+{
+QMutexLocker lock( &mutex_ );
+
+    t_SimStep step = { atNsec, load };
+
+    //*** keep time ordered ***
+    int i = 0;
+    while ( i < steps_.size() && steps_[i].atNsec <= atNsec ) i++;
+    steps_.insert( i, step );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimHX711::setFaults( double glitchRate, double stallRate )
+{
+QMutexLocker lock( &mutex_ );
+
+    glitchRate_ = qBound( 0.0, glitchRate, 1.0 );
+    stallRate_  = qBound( 0.0, stallRate, 1.0 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimHX711::conversions()
+{
+QMutexLocker lock( &mutex_ );
+
+    return conversions_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimHX711::overruns()
+{
+QMutexLocker lock( &mutex_ );
+
+    return overruns_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimHX711::powerDowns()
+{
+QMutexLocker lock( &mutex_ );
+
+    return powerDowns_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimHX711::glitches()
+{
+QMutexLocker lock( &mutex_ );
+
+    return glitches_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint32 SimHX711::signalAt( qint64 t )
+{
+double gainScale;
+
+    //*** apply any load steps that have happened by now ***
+    while ( !steps_.isEmpty() && steps_.first().atNsec <= t )
+    {
+        load_ = steps_.takeFirst().load;
+    }
+
+    //*** channel B is modelled as the same bridge at gain 32 ***
+    switch ( gain_ )
+    {
+        case HX711_GAIN_A64: gainScale = 0.5;  break;
+        case HX711_GAIN_B32: gainScale = 0.25; break;
+        default:             gainScale = 1.0;  break;
+    }
+
+    double secs = static_cast<double>( t ) / static_cast<double>( NSEC_PER_SEC );
+    double value = signal_.offset
+                 + signal_.driftPerSec * secs
+                 + signal_.countsPerUnit * load_
+                 + signal_.noise * noise_( rng_ );
+
+    //*** clip to the 24 bit range ***
+    value = qBound( -8388608.0, floor( value * gainScale + 0.5 ), 8388607.0 );
+
+    return static_cast<qint32>( value );
+}
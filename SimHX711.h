@@ -0,0 +1,116 @@
+#ifndef SIMHX711_H
+#define SIMHX711_H
+
+#include "HX711Port.h"
+#include "SimNAU7802.h"
+#include <QMutex>
+#include <QList>
+#include <random>
+
+class ScaleClock;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SimHX711 class - software model of the HX711 and its two pins.
+ *
+ *  - a conversion completes every 1/SPS seconds and pulls DT low
+ *  - each SCK pulse shifts out the next bit, MSB first; after the 24th DT
+ *    goes high again and the extra pulses (25/26/27) pick the gain of the
+ *    following conversions
+ *  - SCK held high past 60 usec powers the chip down; it comes back at
+ *    gain 128 and needs a few conversion periods before the next result
+ *
+ *  Faults can be injected to exercise the driver's error checks: a glitched
+ *  read is shifted by a bit and leaves DT low afterwards, a stalled pulse
+ *  sleeps past the power down time as if the reader had been preempted.
+ *  All timing comes from the supplied clock.
+ */
+//*****************************************************************************
+class SimHX711 : public HX711Port
+{
+public:
+
+    //*** constructor ***
+    SimHX711( ScaleClock *clock, const t_SimSignal &signal, int sps = 10, quint32 seed = 1 );
+
+    bool open() override { return true; }
+    int waitForReady( int timeoutMsec ) override;
+    int clockBit() override;
+    int level() override;
+    QString name() const override { return QString( "sim" ); }
+
+    //*** change the load now ***
+    void setLoad( double load );
+
+    //*** change the load at a given clock time ***
+    void addStep( qint64 atNsec, double load );
+
+    //*** fraction of reads to garble, fraction of pulses to stall ***
+    void setFaults( double glitchRate, double stallRate );
+
+    //*** statistics ***
+    quint64 conversions();      // conversions produced
+    quint64 overruns();         // conversions replaced before being read
+    quint64 powerDowns();       // pulses held high too long
+    quint64 glitches();         // reads garbled on purpose
+
+    //*** model clock ***
+    ScaleClock *clock() { return clock_; }
+
+    //*** default signal - the HX711 on the original board ***
+    static t_SimSignal defaultSignal();
+
+private:
+
+    //*** bring the model up to the current time - mutex held ***
+    //*** endRead = the pulses of the last read are all in ***
+    void update( bool endRead );
+
+    //*** signal value at time t for the current gain ***
+    qint32 signalAt( qint64 t );
+
+    QMutex mutex_;
+
+    ScaleClock *clock_;
+    t_SimSignal signal_;
+
+    //*** conversion period ***
+    qint64 period_;
+
+    //*** current load and pending steps (time ordered) ***
+    double load_;
+    QList<t_SimStep> steps_;
+
+    //*** conversion waiting to be read (DT low) and its value ***
+    bool ready_;
+    qint32 latched_;
+
+    //*** SCK pulses into the current read, 0 when not reading ***
+    int pulses_;
+
+    //*** pulses per read selecting the gain of the conversions being made ***
+    int gain_;
+
+    //*** time of the next conversion ***
+    qint64 nextConv_;
+
+    //*** fault injection ***
+    double glitchRate_;
+    double stallRate_;
+    bool glitch_;
+
+    //*** statistics ***
+    quint64 conversions_;
+    quint64 overruns_;
+    quint64 powerDowns_;
+    quint64 glitches_;
+
+    //*** noise and fault sources ***
+    std::mt19937 rng_;
+    std::normal_distribution<double> noise_;
+    std::uniform_real_distribution<double> chance_;
+};
+
+#endif // SIMHX711_H
@@ -0,0 +1,464 @@
+#include "SimNAU7802.h"
+#include "ScaleClock.h"
+#include "NAU7802.h"
+#include <QMutexLocker>
+#include <string.h>
+#include <math.h>
+
+//*****************
+//*** CONSTANTS ***
+//*****************
+
+const qint64 POWER_UP_NSEC  = 200000;        // PUR follows PUD after ~200us
+const qint64 CAL_AFE_NSEC   = 344000000;     // AFE calibration takes ~344ms
+const qint64 NSEC_PER_SEC   = 1000000000;
+
+//*** most conversions we bother to generate after an idle stretch ***
+const int MAX_CATCH_UP = 16;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SimDrdyLine class - CRDY line of the simulated chip. Waiting
+ *              for an edge sleeps on the model clock until the next
+ *              conversion completes.
+ */
+//*****************************************************************************
+class SimDrdyLine : public GpioLine
+{
+public:
+
+    explicit SimDrdyLine( SimNAU7802 *sim ) { sim_ = sim; }
+
+    bool open( Edge ) override { return true; }
+
+    int waitForEdge( int timeoutMsec ) override
+    {
+        qint64 now = sim_->clock()->nsecs();
+        qint64 next = sim_->nextConversionNsec();
+        qint64 timeout = static_cast<qint64>( timeoutMsec ) * 1000000;
+
+        //*** nothing due in time ***
+        if ( next < 0 || ( next - now ) > timeout )
+        {
+            sim_->clock()->sleepNsec( timeout );
+            return 0;
+        }
+
+        //*** sleep until the conversion completes ***
+        sim_->clock()->sleepNsec( next - now );
+        return 1;
+    }
+
+    int level() override
+    {
+        return ( sim_->readReg8( NAU7802_PU_CTRL ) >> NAU7802_PU_CTRL_CR ) & 1;
+    }
+
+private:
+
+    SimNAU7802 *sim_;
+};
+
+
+//*****************************************************************************
+//*****************************************************************************
+SimNAU7802::SimNAU7802( ScaleClock *clock, const t_SimSignal &signal, quint32 seed )
+    : rng_( seed ), noise_( 0.0, 1.0 )
+{
+    clock_  = clock;
+    signal_ = signal;
+    load_   = 0.0;
+
+    dual_    = false;
+    signal2_ = signal;
+    share2_  = 0.0;
+    mixNext_ = false;
+
+    conversions_  = 0;
+    overruns_     = 0;
+    transactions_ = 0;
+
+    resetRegisters();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+t_SimSignal SimNAU7802::defaultSignal()
+{
+t_SimSignal signal;
+
+    signal.offset        = -214054.0;
+    signal.countsPerUnit = 10952.6;
+    signal.noise         = 60.0;
+    signal.driftPerSec   = 0.0;
+
+    return signal;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool SimNAU7802::open()
+{
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int SimNAU7802::readReg8( quint8 reg )
+{
+QMutexLocker lock( &mutex_ );
+
+    transactions_++;
+    update();
+
+    return readLocked( reg );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool SimNAU7802::readBlocks( t_RegRead *reads, int numReads )
+{
+QMutexLocker lock( &mutex_ );
+
+    //*** one combined transaction ***
+    transactions_++;
+    update();
+
+    for ( int i=0; i<numReads; i++ )
+    {
+        for ( int j=0; j<reads[i].len; j++ )
+        {
+            reads[i].data[j] = readLocked( static_cast<quint8>( reads[i].reg + j ) );
+        }
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool SimNAU7802::writeReg8( quint8 reg, quint8 value )
+{
+QMutexLocker lock( &mutex_ );
+
+    transactions_++;
+    update();
+
+    qint64 now = clock_->nsecs();
+    quint8 old = regs_[ reg ];
+
+    if ( reg == NAU7802_PU_CTRL )
+    {
+        //*** register reset ***
+        if ( value & ( 1 << NAU7802_PU_CTRL_RR ) )
+        {
+            resetRegisters();
+            regs_[ NAU7802_PU_CTRL ] = value & ( 1 << NAU7802_PU_CTRL_RR );
+            return true;
+        }
+
+        //*** CR and PUR are read only ***
+        quint8 readOnly = ( 1 << NAU7802_PU_CTRL_CR ) | ( 1 << NAU7802_PU_CTRL_PUR );
+        value = ( value & ~readOnly ) | ( old & readOnly );
+
+        //*** digital power up starts the power up sequence ***
+        bool wasUp = ( old & ( 1 << NAU7802_PU_CTRL_PUD ) ) != 0;
+        bool isUp  = ( value & ( 1 << NAU7802_PU_CTRL_PUD ) ) != 0;
+        if ( isUp && !wasUp )
+        {
+            powerUpAt_ = now + POWER_UP_NSEC;
+        }
+        else if ( !isUp )
+        {
+            value &= ~( ( 1 << NAU7802_PU_CTRL_PUR ) | ( 1 << NAU7802_PU_CTRL_CR ) );
+            powerUpAt_ = -1;
+            nextConv_  = -1;
+        }
+
+        regs_[ reg ] = value;
+
+        //*** ADC starts converting once powered ***
+        if ( converting() && nextConv_ < 0 ) nextConv_ = now + periodNsec();
+    }
+    else if ( reg == NAU7802_CTRL2 )
+    {
+        //*** CAL_ERR is read only ***
+        value = ( value & ~( 1 << NAU7802_CTRL2_CAL_ERROR ) ) | ( old & ( 1 << NAU7802_CTRL2_CAL_ERROR ) );
+
+        //*** start AFE calibration - conversions stop until it is done ***
+        if ( value & ( 1 << NAU7802_CTRL2_CALS ) )
+        {
+            calDoneAt_ = now + CAL_AFE_NSEC;
+            value &= ~( 1 << NAU7802_CTRL2_CAL_ERROR );
+        }
+
+        regs_[ reg ] = value;
+
+        //*** rate or channel change restarts the conversion cycle ***
+        if ( ( old ^ value ) & 0xF0 )
+        {
+            nextConv_ = converting() ? now + periodNsec() : -1;
+        }
+
+        //*** input changed under the filter - next result is not clean ***
+        if ( ( old ^ value ) & ( 1 << NAU7802_CTRL2_CHS ) ) mixNext_ = dual_;
+    }
+    else if ( reg >= NAU7802_ADCO_B2 && reg <= NAU7802_ADCO_B0 )
+    {
+        //*** results are read only ***
+    }
+    else
+    {
+        regs_[ reg ] = value;
+    }
+
+    return true;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimNAU7802::setLoad( double load )
+{
+QMutexLocker lock( &mutex_ );
+
+    update();
+    load_ = load;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimNAU7802::setChannel2( const t_SimSignal &signal, double loadShare )
+{
+QMutexLocker lock( &mutex_ );
+
+    dual_    = true;
+    signal2_ = signal;
+    share2_  = qBound( 0.0, loadShare, 1.0 );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimNAU7802::addStep( qint64 atNsec, double load )
+{
+QMutexLocker lock( &mutex_ );
+
+    t_SimStep step = { atNsec, load };
+
+    //*** keep time ordered ***
+    int i = 0;
+    while ( i < steps_.size() && steps_[i].atNsec <= atNsec ) i++;
+    steps_.insert( i, step );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+GpioLine *SimNAU7802::createDrdyLine()
+{
+    return new SimDrdyLine( this );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint64 SimNAU7802::nextConversionNsec()
+{
+QMutexLocker lock( &mutex_ );
+
+    update();
+
+    //*** calibration in progress - conversions resume after it ***
+    if ( calDoneAt_ >= 0 ) return calDoneAt_ + periodNsec();
+
+    return nextConv_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimNAU7802::conversions()
+{
+QMutexLocker lock( &mutex_ );
+
+    return conversions_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimNAU7802::overruns()
+{
+QMutexLocker lock( &mutex_ );
+
+    return overruns_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint64 SimNAU7802::transactions()
+{
+QMutexLocker lock( &mutex_ );
+
+    return transactions_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimNAU7802::update()
+{
+    qint64 now = clock_->nsecs();
+
+    //*** power up sequencing ***
+    if ( powerUpAt_ >= 0 && now >= powerUpAt_ )
+    {
+        regs_[ NAU7802_PU_CTRL ] |= ( 1 << NAU7802_PU_CTRL_PUR );
+        powerUpAt_ = -1;
+
+        if ( converting() && nextConv_ < 0 ) nextConv_ = now + periodNsec();
+    }
+
+    //*** AFE calibration ***
+    if ( calDoneAt_ >= 0 && now >= calDoneAt_ )
+    {
+        regs_[ NAU7802_CTRL2 ] &= ~( 1 << NAU7802_CTRL2_CALS );
+        nextConv_ = converting() ? calDoneAt_ + periodNsec() : -1;
+        calDoneAt_ = -1;
+    }
+
+    //*** no conversions while calibrating or powered down ***
+    if ( calDoneAt_ >= 0 || nextConv_ < 0 || !converting() ) return;
+
+    //*** don't grind through a long idle stretch ***
+    qint64 period = periodNsec();
+    if ( now - nextConv_ > period * MAX_CATCH_UP )
+    {
+        qint64 skipped = ( now - nextConv_ ) / period - MAX_CATCH_UP;
+        overruns_    += static_cast<quint64>( skipped );
+        conversions_ += static_cast<quint64>( skipped );
+        nextConv_    += skipped * period;
+    }
+
+    //*** complete every conversion that is due ***
+    while ( nextConv_ <= now )
+    {
+        int channel = ( regs_[ NAU7802_CTRL2 ] >> NAU7802_CTRL2_CHS ) & 1;
+        qint32 value = signalAt( nextConv_, channel );
+
+        //*** first conversion after a channel switch ***
+        if ( mixNext_ )
+        {
+            value = ( value + signalAt( nextConv_, 1 - channel ) ) / 2;
+            mixNext_ = false;
+        }
+
+        //*** previous result never read ***
+        if ( regs_[ NAU7802_PU_CTRL ] & ( 1 << NAU7802_PU_CTRL_CR ) ) overruns_++;
+
+        regs_[ NAU7802_ADCO_B2 ] = static_cast<quint8>( value >> 16 );
+        regs_[ NAU7802_ADCO_B1 ] = static_cast<quint8>( value >> 8 );
+        regs_[ NAU7802_ADCO_B0 ] = static_cast<quint8>( value );
+        regs_[ NAU7802_PU_CTRL ] |= ( 1 << NAU7802_PU_CTRL_CR );
+
+        conversions_++;
+        nextConv_ += period;
+    }
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+quint8 SimNAU7802::readLocked( quint8 reg )
+{
+    quint8 value = regs_[ reg ];
+
+    //*** reading the result clears conversion ready ***
+    if ( reg == NAU7802_ADCO_B0 )
+    {
+        regs_[ NAU7802_PU_CTRL ] &= ~( 1 << NAU7802_PU_CTRL_CR );
+    }
+
+    return value;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SimNAU7802::resetRegisters()
+{
+    memset( regs_, 0, sizeof(regs_) );
+
+    regs_[ NAU7802_DEVICE_REV ] = 0x0F;
+
+    powerUpAt_ = -1;
+    calDoneAt_ = -1;
+    nextConv_  = -1;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool SimNAU7802::converting()
+{
+    quint8 mask = ( 1 << NAU7802_PU_CTRL_PUD ) | ( 1 << NAU7802_PU_CTRL_PUA ) | ( 1 << NAU7802_PU_CTRL_PUR );
+
+    return ( regs_[ NAU7802_PU_CTRL ] & mask ) == mask;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint64 SimNAU7802::periodNsec()
+{
+int sps = 10;
+
+    switch ( ( regs_[ NAU7802_CTRL2 ] >> 4 ) & 0x07 )
+    {
+        case NAU7802_SPS_20:  sps = 20;  break;
+        case NAU7802_SPS_40:  sps = 40;  break;
+        case NAU7802_SPS_80:  sps = 80;  break;
+        case NAU7802_SPS_320: sps = 320; break;
+        default:              sps = 10;  break;
+    }
+
+    return NSEC_PER_SEC / sps;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+qint32 SimNAU7802::signalAt( qint64 t, int channel )
+{
+    //*** apply any load steps that have happened by now ***
+    while ( !steps_.isEmpty() && steps_.first().atNsec <= t )
+    {
+        load_ = steps_.takeFirst().load;
+    }
+
+    //*** with two load cells each carries its share ***
+    const t_SimSignal &sig = ( dual_ && channel == 1 ) ? signal2_ : signal_;
+    double load = load_;
+    if ( dual_ ) load *= ( channel == 1 ) ? share2_ : 1.0 - share2_;
+
+    double secs = static_cast<double>( t ) / static_cast<double>( NSEC_PER_SEC );
+    double value = sig.offset
+                 + sig.driftPerSec * secs
+                 + sig.countsPerUnit * load
+                 + sig.noise * noise_( rng_ );
+
+    //*** clip to the 24 bit range ***
+    value = qBound( -8388608.0, floor( value + 0.5 ), 8388607.0 );
+
+    return static_cast<qint32>( value );
+}
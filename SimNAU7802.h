@@ -0,0 +1,138 @@
+#ifndef SIMNAU7802_H
+#define SIMNAU7802_H
+
+#include "I2CBus.h"
+#include "GpioLine.h"
+#include <QMutex>
+#include <QList>
+#include <random>
+
+class ScaleClock;
+
+//*** load cell signal model ***
+typedef struct
+{
+    double offset;          // raw counts with nothing on the scale
+    double countsPerUnit;   // raw counts per unit of weight
+    double noise;           // std deviation of the noise (raw counts)
+    double driftPerSec;     // slow offset drift (raw counts per second)
+} t_SimSignal;
+
+//*** a load change at a given time ***
+typedef struct
+{
+    qint64 atNsec;          // clock time of the change
+    double load;            // new load (weight units)
+} t_SimStep;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SimNAU7802 class - software model of the NAU7802 on an I2C bus.
+ *
+ *  Implements the register map from NAU7802.h:
+ *   - RR register reset, PUD/PUA power up with PUR set ~200us later
+ *   - CTRL2 CALS AFE calibration taking ~344ms, CAL_ERR always clear
+ *   - ADCO conversions at the SPS selected by CTRL2 CRS, CR set when a
+ *     conversion completes and cleared when ADCO_B0 is read
+ *   - optional second load cell on channel 2 (CTRL2 CHS). The first
+ *     conversion after a channel switch is a mix of both channels
+ *
+ *  All timing comes from the supplied clock, so with a SimClock the whole
+ *  scale pipeline can be run faster than real time.
+ */
+//*****************************************************************************
+class SimNAU7802 : public I2CBus
+{
+public:
+
+    //*** constructor ***
+    SimNAU7802( ScaleClock *clock, const t_SimSignal &signal, quint32 seed = 1 );
+
+    bool open() override;
+    int readReg8( quint8 reg ) override;
+    bool writeReg8( quint8 reg, quint8 value ) override;
+    bool readBlocks( t_RegRead *reads, int numReads ) override;
+    bool combinedTransfers() const override { return true; }
+
+    //*** change the load now ***
+    void setLoad( double load );
+
+    //*** change the load at a given clock time ***
+    void addStep( qint64 atNsec, double load );
+
+    //*** put a second load cell on channel 2, carrying loadShare of the load ***
+    void setChannel2( const t_SimSignal &signal, double loadShare );
+
+    //*** CRDY line driven by the model - caller owns it ***
+    GpioLine *createDrdyLine();
+
+    //*** time of next conversion, -1 if not converting ***
+    qint64 nextConversionNsec();
+
+    //*** statistics ***
+    quint64 conversions();      // conversions produced
+    quint64 overruns();         // conversions replaced before being read
+    quint64 transactions();     // bus transactions
+
+    //*** model clock ***
+    ScaleClock *clock() { return clock_; }
+
+    //*** default signal - roughly the scale on the pantry floor ***
+    static t_SimSignal defaultSignal();
+
+private:
+
+    //*** bring the model up to the current time - mutex held ***
+    void update();
+
+    //*** register read with side effects - mutex held ***
+    quint8 readLocked( quint8 reg );
+
+    //*** set power on defaults - mutex held ***
+    void resetRegisters();
+
+    //*** is the ADC running ***
+    bool converting();
+
+    //*** conversion period for the current CRS setting ***
+    qint64 periodNsec();
+
+    //*** signal value of a channel at time t ***
+    qint32 signalAt( qint64 t, int channel );
+
+    QMutex mutex_;
+
+    ScaleClock *clock_;
+    t_SimSignal signal_;
+
+    //*** channel 2 load cell ***
+    bool dual_;
+    t_SimSignal signal2_;
+    double share2_;
+    bool mixNext_;
+
+    //*** register file ***
+    quint8 regs_[ 256 ];
+
+    //*** current load and pending steps (time ordered) ***
+    double load_;
+    QList<t_SimStep> steps_;
+
+    //*** pending events (-1 = none) ***
+    qint64 powerUpAt_;
+    qint64 calDoneAt_;
+    qint64 nextConv_;
+
+    //*** statistics ***
+    quint64 conversions_;
+    quint64 overruns_;
+    quint64 transactions_;
+
+    //*** noise source ***
+    std::mt19937 rng_;
+    std::normal_distribution<double> noise_;
+};
+
+#endif // SIMNAU7802_H
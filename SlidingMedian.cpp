@@ -0,0 +1,216 @@
+#include "SlidingMedian.h"
+
+
+//*****************************************************************************
+//*****************************************************************************
+SlidingMedian::SlidingMedian( int window )
+{
+    setWindow( window );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::setWindow( int window )
+{
+    window_ = qMax( 1, window );
+
+    //*** all the storage we will ever need ***
+    values_.resize( window_ );
+    heapOf_.resize( window_ );
+    posOf_.resize( window_ );
+    heap_[LOW_HEAP].resize( window_ );
+    heap_[HIGH_HEAP].resize( window_ );
+
+    clear();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::clear()
+{
+    count_ = 0;
+    next_  = 0;
+    size_[LOW_HEAP]  = 0;
+    size_[HIGH_HEAP] = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::add( qint32 value )
+{
+    int slot = next_;
+
+    //*** window full - the oldest value leaves ***
+    if ( count_ == window_ )
+    {
+        removeSlot( slot );
+    }
+    else
+    {
+        count_++;
+    }
+
+    values_[slot] = value;
+
+    //*** lower half if it belongs there, otherwise upper half ***
+    if ( size_[LOW_HEAP] == 0 || value <= values_[ heap_[LOW_HEAP][0] ] )
+    {
+        push( LOW_HEAP, slot );
+    }
+    else
+    {
+        push( HIGH_HEAP, slot );
+    }
+
+    rebalance();
+
+    next_ = ( next_ + 1 ) % window_;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+double SlidingMedian::median() const
+{
+    if ( count_ == 0 ) return 0.0;
+
+    //*** odd count - low heap holds the extra one ***
+    double low = values_[ heap_[LOW_HEAP][0] ];
+    if ( size_[LOW_HEAP] > size_[HIGH_HEAP] ) return low;
+
+    //*** even count - average the middle two ***
+    double high = values_[ heap_[HIGH_HEAP][0] ];
+    return ( low + high ) / 2.0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool SlidingMedian::before( Heap heap, int slotA, int slotB ) const
+{
+    //*** low heap is a max-heap, high heap is a min-heap ***
+    if ( heap == LOW_HEAP ) return values_[slotA] > values_[slotB];
+
+    return values_[slotA] < values_[slotB];
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::place( Heap heap, int pos, int slot )
+{
+    heap_[heap][pos] = slot;
+    heapOf_[slot] = heap;
+    posOf_[slot] = pos;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::siftUp( Heap heap, int pos )
+{
+    int slot = heap_[heap][pos];
+
+    while ( pos > 0 )
+    {
+        int parent = ( pos - 1 ) / 2;
+        if ( !before( heap, slot, heap_[heap][parent] ) ) break;
+
+        place( heap, pos, heap_[heap][parent] );
+        pos = parent;
+    }
+
+    place( heap, pos, slot );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::siftDown( Heap heap, int pos )
+{
+    int slot = heap_[heap][pos];
+    int size = size_[heap];
+
+    while ( true )
+    {
+        int child = 2 * pos + 1;
+        if ( child >= size ) break;
+
+        //*** pick the child that should come first ***
+        if ( child + 1 < size && before( heap, heap_[heap][child+1], heap_[heap][child] ) ) child++;
+
+        if ( !before( heap, heap_[heap][child], slot ) ) break;
+
+        place( heap, pos, heap_[heap][child] );
+        pos = child;
+    }
+
+    place( heap, pos, slot );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::push( Heap heap, int slot )
+{
+    int pos = size_[heap]++;
+
+    place( heap, pos, slot );
+    siftUp( heap, pos );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+int SlidingMedian::pop( Heap heap )
+{
+    int top = heap_[heap][0];
+
+    //*** move the last entry to the top and let it find its place ***
+    if ( --size_[heap] > 0 )
+    {
+        place( heap, 0, heap_[heap][ size_[heap] ] );
+        siftDown( heap, 0 );
+    }
+
+    return top;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::removeSlot( int slot )
+{
+Heap heap = static_cast<Heap>( heapOf_[slot] );
+int pos = posOf_[slot];
+int moved;
+
+    //*** replace with the last entry of the same heap ***
+    if ( --size_[heap] == pos ) return;
+
+    moved = heap_[heap][ size_[heap] ];
+    place( heap, pos, moved );
+
+    //*** it may need to go either way ***
+    siftUp( heap, pos );
+    siftDown( heap, posOf_[moved] );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void SlidingMedian::rebalance()
+{
+    //*** low heap holds the same number or one more ***
+    if ( size_[LOW_HEAP] > size_[HIGH_HEAP] + 1 )
+    {
+        push( HIGH_HEAP, pop( LOW_HEAP ) );
+    }
+    else if ( size_[HIGH_HEAP] > size_[LOW_HEAP] )
+    {
+        push( LOW_HEAP, pop( HIGH_HEAP ) );
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SLIDINGMEDIAN_H
+#define SLIDINGMEDIAN_H
+
+#include <QVector>
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The SlidingMedian class - median of the last N values, updated in
+ *              O(log N) per value.
+ *
+ *  The window is split between a max-heap (lower half) and a min-heap (upper
+ *  half). Every window slot remembers which heap it is in and where, so the
+ *  value leaving the window is removed directly instead of being searched
+ *  for. All storage is allocated by setWindow() - add() never allocates.
+ */
+//*****************************************************************************
+class SlidingMedian
+{
+public:
+
+    //*** constructor ***
+    explicit SlidingMedian( int window = 1 );
+
+    //*** change the window size - clears the values ***
+    void setWindow( int window );
+    int window() const { return window_; }
+
+    //*** add a value - drops the oldest once the window is full ***
+    void add( qint32 value );
+
+    //*** median of the values in the window (0 if empty) ***
+    double median() const;
+
+    //*** number of values in the window ***
+    int count() const { return count_; }
+
+    //*** forget all values ***
+    void clear();
+
+private:
+
+    typedef enum { LOW_HEAP = 0, HIGH_HEAP = 1 } Heap;
+
+    //*** heap helpers - heaps hold window slot numbers ***
+    bool before( Heap heap, int slotA, int slotB ) const;
+    void place( Heap heap, int pos, int slot );
+    void siftUp( Heap heap, int pos );
+    void siftDown( Heap heap, int pos );
+    void push( Heap heap, int slot );
+    int pop( Heap heap );
+    void removeSlot( int slot );
+    void rebalance();
+
+    //*** window size and number of values held ***
+    int window_;
+    int count_;
+
+    //*** next slot to write (oldest slot once full) ***
+    int next_;
+
+    //*** value, heap and heap position for each window slot ***
+    QVector<qint32> values_;
+    QVector<int> heapOf_;
+    QVector<int> posOf_;
+
+    //*** the two heaps ***
+    QVector<int> heap_[2];
+    int size_[2];
+};
+
+#endif // SLIDINGMEDIAN_H
@@ -0,0 +1,87 @@
+#include "StabilityDetector.h"
+#include <cmath>
+
+
+//*****************************************************************************
+//*****************************************************************************
+StabilityDetector::StabilityDetector( const t_StabilityConfig &config )
+{
+    setConfig( config );
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+t_StabilityConfig StabilityDetector::defaultConfig()
+{
+t_StabilityConfig config;
+
+    config.windowSamples = 5;
+    config.maxStdDev     = 0.05;
+    config.maxSlope      = 0.1;
+    config.dwellMsec     = 300;
+
+    return config;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void StabilityDetector::setConfig( const t_StabilityConfig &config )
+{
+    config_ = config;
+    config_.windowSamples = qMax( 2, config_.windowSamples );
+
+    reset();
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+void StabilityDetector::reset()
+{
+    stable_      = false;
+    quietSince_  = -1;
+    movingSince_ = -1;
+    settleNsec_  = 0;
+}
+
+
+//*****************************************************************************
+//*****************************************************************************
+bool StabilityDetector::update( double stdDev, double slope, qint64 nowNsec )
+{
+    bool quiet = ( stdDev <= config_.maxStdDev ) && ( std::fabs( slope ) <= config_.maxSlope );
+
+    //*** time from here if the load was never seen to move ***
+    if ( !stable_ && movingSince_ < 0 ) movingSince_ = nowNsec;
+
+    //*** moving ***
+    if ( !quiet )
+    {
+        quietSince_ = -1;
+
+        //*** a new load is on its way ***
+        if ( stable_ )
+        {
+            stable_ = false;
+            movingSince_ = nowNsec;
+        }
+
+        return false;
+    }
+
+    //*** already reported ***
+    if ( stable_ ) return false;
+
+    //*** must stay quiet for the dwell time ***
+    if ( quietSince_ < 0 ) quietSince_ = nowNsec;
+    if ( nowNsec - quietSince_ < static_cast<qint64>( config_.dwellMsec ) * 1000000 ) return false;
+
+    //*** settled ***
+    stable_ = true;
+    settleNsec_ = nowNsec - movingSince_;
+    movingSince_ = -1;
+
+    return true;
+}
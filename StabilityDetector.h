@@ -0,0 +1,72 @@
+#ifndef STABILITYDETECTOR_H
+#define STABILITYDETECTOR_H
+
+#include <QtGlobal>
+
+//*** when is a load considered settled ***
+typedef struct
+{
+    int    windowSamples;   // output samples the spread and slope are measured over
+    double maxStdDev;       // largest standard deviation (weight units)
+    double maxSlope;        // largest drift (weight units per second)
+    int    dwellMsec;       // how long both must stay under their limits
+} t_StabilityConfig;
+
+
+//*****************************************************************************
+//*****************************************************************************
+/**
+ * @brief The StabilityDetector class - decides when a load has settled.
+ *
+ *  Fed the spread and slope of the recent weight window once per output
+ *  sample. The load is declared stable once both have stayed under their
+ *  limits for the dwell time, and unstable again as soon as either goes
+ *  over. The time from the load starting to move until it was declared
+ *  stable is kept for tuning.
+ */
+//*****************************************************************************
+class StabilityDetector
+{
+public:
+
+    //*** constructor ***
+    explicit StabilityDetector( const t_StabilityConfig &config = defaultConfig() );
+
+    //*** thresholds - clears the state ***
+    void setConfig( const t_StabilityConfig &config );
+    const t_StabilityConfig &config() const { return config_; }
+
+    //*** new measurement - returns true when the load has just become stable ***
+    bool update( double stdDev, double slope, qint64 nowNsec );
+
+    //*** load is currently stable ***
+    bool isStable() const { return stable_; }
+
+    //*** time taken to settle, for the last stable load ***
+    qint64 settleNsec() const { return settleNsec_; }
+
+    //*** start over - the next load is timed from the next update ***
+    void reset();
+
+    //*** quarter second window, 0.05 units of noise, 0.1 units/sec drift, 300 msec dwell ***
+    static t_StabilityConfig defaultConfig();
+
+private:
+
+    //*** thresholds ***
+    t_StabilityConfig config_;
+
+    //*** current state ***
+    bool stable_;
+
+    //*** when the measurements went under the limits (-1 if they are not) ***
+    qint64 quietSince_;
+
+    //*** when the load started moving (-1 while stable) ***
+    qint64 movingSince_;
+
+    //*** last time to stable ***
+    qint64 settleNsec_;
+};
+
+#endif // STABILITYDETECTOR_H